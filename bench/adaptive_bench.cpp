@@ -0,0 +1,76 @@
+#include "bench.h"
+
+#include "ptmath/vec3.h"
+#include "ptmath/ray.h"
+#include "graphics/image.h"
+#include "scene/object/object.h"
+#include "scene/object/linear_bvh.h"
+#include "scene/camera.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace ptmath;
+using namespace scene;
+
+namespace
+{
+    // The rendered pixels as displayed: clamped and gamma corrected.
+    std::vector<color> DisplayedPixels(bench::BenchCamera &cam, const CompiledScene &world, double &seconds)
+    {
+        std::vector<color> pixels = cam.RenderPixels(world, &seconds);
+        bench::ClampPixels(pixels, true);
+        return pixels;
+    }
+
+    // Error of the pixel that is worse than 99% of the others.
+    double Percentile99(const std::vector<color> &a, const std::vector<color> &b)
+    {
+        std::vector<double> errors;
+        for (size_t i = 0; i < a.size(); i++)
+            errors.push_back(std::sqrt((a[i] - b[i]).length_squared() / 3));
+        std::sort(errors.begin(), errors.end());
+        return errors[errors.size() * 99 / 100];
+    }
+}
+
+void bench::AdaptiveBenchmark()
+{
+    HittableGroup world;
+    bench::BenchCamera cam;
+    cam.image_width_ = 64;
+    cam.image_height_ = 36;
+    cam.max_depth_ = 5;
+    SkySpheres(world, cam);
+    CompiledScene scene(world);
+
+    bench::QuietLog quiet;
+    double seconds;
+    cam.samples_per_pixel_ = 4096;
+    cam.seed_ = 1;
+    std::vector<color> reference = DisplayedPixels(cam, scene, seconds);
+    cam.seed_ = 0;
+
+    std::cout << "  spheres under the sky, " << cam.image_width_ << "x" << cam.image_height_
+              << ", RMSE of the displayed image against " << cam.samples_per_pixel_ << " samples per pixel\n";
+
+    for (int spp : {16, 64, 256})
+    {
+        cam.samples_per_pixel_ = spp;
+        std::vector<color> pixels = DisplayedPixels(cam, scene, seconds);
+        std::cout << "  uniform, " << cam.MeanSamples() << " spp: RMSE " << bench::Rmse(pixels, reference)
+                  << ", 99th percentile " << Percentile99(pixels, reference) << ", " << seconds * 1e3 << " ms\n";
+    }
+
+    cam.samples_per_pixel_ = 16;
+    cam.max_samples_per_pixel_ = 1024;
+    for (double threshold : {0.02, 0.01, 0.005})
+    {
+        cam.adaptive_threshold_ = threshold;
+        std::vector<color> pixels = DisplayedPixels(cam, scene, seconds);
+        std::cout << "  adaptive, threshold " << threshold << ", " << cam.MeanSamples() << " spp on average: RMSE "
+                  << bench::Rmse(pixels, reference) << ", 99th percentile " << Percentile99(pixels, reference) << ", "
+                  << seconds * 1e3 << " ms\n";
+    }
+}
@@ -0,0 +1,60 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace scene;
+
+double bench::BenchCamera::RenderSeconds(const CompiledScene &world, image &output)
+{
+    Initialize(world);
+    return TimeSeconds([&]()
+                       { RenderRows(world, output, 0, image_height_); });
+}
+
+double bench::BenchCamera::RenderSeconds(const CompiledScene &world, image &output, util::TaskPool &pool,
+                                         bool steal)
+{
+    Initialize(world);
+    return TimeSeconds([&]()
+                       { RenderTiles(world, output, pool, steal); });
+}
+
+std::vector<color> bench::BenchCamera::RenderPixels(const CompiledScene &world, double *seconds)
+{
+    image output(image_width_, image_height_);
+    double render_seconds = RenderSeconds(world, output);
+    if (seconds)
+        *seconds = render_seconds;
+    return output.toColors();
+}
+
+double bench::BenchCamera::MeanSamples() const
+{
+    // Pixel sample counts are only kept by adaptive and progressive renders.
+    if (sample_counts_.empty())
+        return samples_per_pixel_;
+
+    double sum = 0;
+    for (int count : sample_counts_)
+        sum += count;
+    return sum / sample_counts_.size();
+}
+
+void bench::ClampPixels(std::vector<color> &pixels, bool gamma)
+{
+    for (color &c : pixels)
+    {
+        c = color(std::min<double>(c.x(), 1), std::min<double>(c.y(), 1), std::min<double>(c.z(), 1));
+        if (gamma)
+            c = sqrt(c);
+    }
+}
+
+double bench::Rmse(const std::vector<color> &a, const std::vector<color> &b)
+{
+    double sum = 0;
+    for (size_t i = 0; i < a.size(); i++)
+        sum += (a[i] - b[i]).length_squared() / 3;
+    return std::sqrt(sum / a.size());
+}
@@ -0,0 +1,114 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "graphics/image.h"
+#include "util/parallel.h"
+#include "scene/camera.h"
+
+namespace scene
+{
+    class HittableGroup;
+}
+
+namespace bench
+{
+
+    /**
+     * A camera whose render steps the benchmarks call directly: it renders the whole image on the
+     * calling thread or on a given pool, and never writes it out.
+    */
+    class BenchCamera : public scene::MultiThreadCamera
+    {
+    public:
+        using Camera::GetRayForPixel;
+        using Camera::Initialize;
+        using Camera::SamplePixel;
+
+        // Renders the image into output on the calling thread and returns how long it took.
+        double RenderSeconds(const scene::CompiledScene &world, image &output);
+
+        // The same on the threads of pool, with or without work stealing.
+        double RenderSeconds(const scene::CompiledScene &world, image &output, util::TaskPool &pool,
+                             bool steal = true);
+
+        // Renders the image on the calling thread and returns its pixels, and in seconds, if
+        // given, how long it took.
+        std::vector<color> RenderPixels(const scene::CompiledScene &world, double *seconds = nullptr);
+
+        // Samples per pixel of the last render, on average; only adaptive renders vary it.
+        double MeanSamples() const;
+    };
+
+    // Clamps pixels to white, as image files do, and with gamma also takes the square root that
+    // they store.
+    void ClampPixels(std::vector<color> &pixels, bool gamma = false);
+
+    // Root mean square difference of two images, over pixels and channels.
+    double Rmse(const std::vector<color> &a, const std::vector<color> &b);
+
+    // Silences std::clog while it lives: Camera::Initialize logs the camera position and the
+    // renders their progress.
+    class QuietLog
+    {
+    public:
+        QuietLog() { std::clog.setstate(std::ios::failbit); }
+        ~QuietLog() { std::clog.clear(); }
+
+        QuietLog(const QuietLog &) = delete;
+        QuietLog &operator=(const QuietLog &) = delete;
+    };
+
+    // Runs fn once and returns the wall-clock time it took, in seconds.
+    template <typename F>
+    double TimeSeconds(F &&fn)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        fn();
+        auto stop = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double>(stop - start).count();
+    }
+
+    inline void Report(const char *name, double seconds, double work, const char *unit)
+    {
+        std::cout << "  " << name << ": " << seconds * 1e3 << " ms, "
+                  << (work / seconds) / 1e6 << " M" << unit << "/s\n";
+    }
+
+    // The Cornell box of main.cpp, with its two boxes.
+    void CornellBox(scene::HittableGroup &world, scene::Camera &cam);
+
+    // A few spheres lit by the sky, where the noise comes from sampling the pixel area and the
+    // bounce directions rather than from finding a small light.
+    void SkySpheres(scene::HittableGroup &world, scene::Camera &cam);
+
+    // The Room of main.cpp: a closed box lit from inside, where paths only end at the light.
+    void Room(scene::HittableGroup &world, scene::Camera &cam);
+
+    // The Weekend scene of main.cpp, seeded: hundreds of spheres, most with a material of their own.
+    void Weekend(scene::HittableGroup &world, scene::Camera &cam);
+
+    // Benchmarks, one per file in bench/
+    void TraversalBenchmark();
+    void MeshBenchmark();
+    void TriangleBenchmark();
+    void SimdBenchmark();
+    void PacketBenchmark();
+    void ScheduleBenchmark();
+    void SamplerBenchmark();
+    void LightBenchmark();
+    void RouletteBenchmark();
+    void AdaptiveBenchmark();
+    void ImageBenchmark();
+    void MaterialBenchmark();
+    void DispatchBenchmark();
+    void BuildBenchmark();
+    void WideBenchmark();
+    void WavefrontBenchmark();
+
+};
+
+#endif
@@ -0,0 +1,115 @@
+#include "bench.h"
+
+#include "ptmath/vec3.h"
+#include "ptmath/ray.h"
+#include "util/parallel.h"
+#include "util/rng.h"
+#include "scene/object/bvh.h"
+#include "scene/object/linear_bvh.h"
+#include "scene/object/mesh.h"
+
+#include <cstring>
+#include <memory>
+
+using namespace ptmath;
+using namespace scene;
+
+namespace
+{
+    bool SameNodes(util::Span<LinearBvhNode> a, util::Span<LinearBvhNode> b)
+    {
+        return a.size() == b.size() && memcmp(a.data(), b.data(), a.size() * sizeof(LinearBvhNode)) == 0;
+    }
+
+    // Rays from outside the bounding box towards points inside it, as in the mesh benchmark.
+    double TraceSeconds(const Mesh &mesh, int ray_count)
+    {
+        util::Rng rng(11, 0);
+        aabb box = mesh.bounding_box();
+        Point3 center = box.centroid();
+        double radius = (box.max() - box.min()).length();
+        return bench::TimeSeconds([&]()
+                                  {
+            for (int i = 0; i < ray_count; i++)
+            {
+                Vec3 d(rng.NextDouble() * 2 - 1, rng.NextDouble() * 2 - 1, rng.NextDouble() * 2 - 1);
+                Point3 from = center + radius * unit_vector(d);
+                Point3 to(box.x.min + rng.NextDouble() * box.x.size(), box.y.min + rng.NextDouble() * box.y.size(),
+                          box.z.min + rng.NextDouble() * box.z.size());
+                HitRecord rec;
+                mesh.hit(ray(from, to - from), interval(0.001, INFINITY), rec);
+            } });
+    }
+
+    // Builds the tree over boxes serially and on 1, 2 and 4 threads, and checks they agree.
+    void BuildBoxes(const std::vector<aabb> &boxes, BvhBuilder builder)
+    {
+        LinearBvh serial;
+        serial.Build(boxes, LinearBvh::kSimdLeaves, {builder, nullptr});
+        std::cout << "  " << BvhBuilderName(builder) << ": " << serial.nodes().size() << " nodes, SAH cost "
+                  << serial.SahCost(LinearBvh::kSimdLeaves) << "\n";
+
+        // Builds are short, so keep the fastest of a few.
+        for (int threads : {1, 2, 4})
+        {
+            util::TaskPool pool(threads);
+            LinearBvh bvh;
+            double best = 1e30;
+            for (int run = 0; run < 5; run++)
+            {
+                bvh.Build(boxes, LinearBvh::kSimdLeaves, {builder, &pool});
+                best = std::min(best, bvh.build_seconds());
+            }
+            std::string name = "  build, " + std::to_string(threads) + (threads == 1 ? " thread" : " threads");
+            bench::Report(name.c_str(), best, double(boxes.size()), "triangles");
+            if (!SameNodes(bvh.nodes(), serial.nodes()))
+                std::cout << "    tree differs from the serial build\n";
+        }
+    }
+
+    void BuildMesh(const char *path)
+    {
+        ObjMesh mesh(path);
+        std::vector<aabb> boxes;
+        for (const Mesh::Triangle &tri : mesh.triangles())
+        {
+            const Point3 &p0 = mesh.vertices()[tri.vertex[0]];
+            const Point3 &p1 = mesh.vertices()[tri.vertex[1]];
+            const Point3 &p2 = mesh.vertices()[tri.vertex[2]];
+            boxes.push_back(aabb(aabb(p0, p1), aabb(p2, p2)).pad());
+        }
+        std::cout << "  " << path << ": " << boxes.size() << " triangles\n";
+
+        for (BvhBuilder builder : {BvhBuilder::kSah, BvhBuilder::kLbvh})
+        {
+            BuildBoxes(boxes, builder);
+
+            const int kRays = 100000;
+            ObjMesh traced(path, false, {builder, nullptr});
+            bench::Report("  trace", TraceSeconds(traced, kRays), kRays, "rays");
+        }
+    }
+
+    // Small boxes scattered through a cube, as many as the triangles of a large scanned mesh.
+    void BuildRandom(size_t count)
+    {
+        util::Rng rng(3, 0);
+        std::vector<aabb> boxes(count);
+        for (aabb &box : boxes)
+        {
+            Point3 p(rng.NextDouble(), rng.NextDouble(), rng.NextDouble());
+            box = aabb(p, p + 0.002 * Vec3(rng.NextDouble(), rng.NextDouble(), rng.NextDouble())).pad();
+        }
+        std::cout << "  random boxes: " << count << "\n";
+        for (BvhBuilder builder : {BvhBuilder::kSah, BvhBuilder::kLbvh})
+            BuildBoxes(boxes, builder);
+    }
+}
+
+void bench::BuildBenchmark()
+{
+    bench::QuietLog quiet;
+    BuildMesh("assets/skyline/model.obj");
+    BuildMesh("assets/iss/InternationalSpaceStation.obj");
+    BuildRandom(300000);
+}
@@ -0,0 +1,70 @@
+#include "bench.h"
+
+#include "ptmath/vec3.h"
+#include "ptmath/ray.h"
+#include "graphics/image.h"
+#include "scene/camera.h"
+#include "scene/compiled_scene.h"
+#include "scene/object/object.h"
+
+#include <algorithm>
+
+using namespace ptmath;
+using namespace scene;
+
+namespace
+{
+    // Renders on the calling thread and returns the fastest of a few runs.
+    double BestSeconds(bench::BenchCamera &cam, const CompiledScene &world, image &output, int runs)
+    {
+        double best = 1e30;
+        for (int i = 0; i < runs; i++)
+            best = std::min(best, cam.RenderSeconds(world, output));
+        return best;
+    }
+
+    bool SameImage(const image &a, const image &b)
+    {
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            color pa = a.pixel(i), pb = b.pixel(i);
+            if (pa.x() != pb.x() || pa.y() != pb.y() || pa.z() != pb.z())
+                return false;
+        }
+        return true;
+    }
+
+    void Compare(const char *name, void (*build)(HittableGroup &, Camera &))
+    {
+        HittableGroup world;
+        bench::BenchCamera cam;
+        cam.image_width_ = 200;
+        cam.image_height_ = 200;
+        cam.samples_per_pixel_ = 4;
+        cam.max_depth_ = 8;
+        build(world, cam);
+        CompiledScene closed(world, Dispatch::kClosedSet);
+        CompiledScene open(world, Dispatch::kVirtual);
+
+        double samples = double(cam.image_width_) * cam.image_height_ * cam.samples_per_pixel_;
+        image closed_image(cam.image_width_, cam.image_height_), virtual_image(cam.image_width_, cam.image_height_);
+        double virtual_seconds = BestSeconds(cam, open, virtual_image, 3);
+        double closed_seconds = BestSeconds(cam, closed, closed_image, 3);
+
+        std::cout << "  " << name << "\n";
+        bench::Report("  virtual", virtual_seconds, samples, "samples");
+        bench::Report("  closed set", closed_seconds, samples, "samples");
+        std::cout << "    speed-up " << virtual_seconds / closed_seconds << "x, images "
+                  << (SameImage(closed_image, virtual_image) ? "identical" : "DIFFER") << "\n";
+    }
+}
+
+void bench::DispatchBenchmark()
+{
+    // The same scenes traced and shaded through virtual calls and through the closed-set switch
+    // over primitive and material kinds; both must draw the same numbers and so the same image.
+    bench::QuietLog quiet;
+    Compare("Weekend", bench::Weekend);
+    Compare("Cornell box", bench::CornellBox);
+    Compare("sky spheres", bench::SkySpheres);
+}
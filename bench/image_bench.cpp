@@ -0,0 +1,101 @@
+#include "bench.h"
+
+#include "graphics/image.h"
+#include "ptmath/simd.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+using namespace ptmath;
+
+void bench::ImageBenchmark()
+{
+    // A 4K frame of smooth gradients with some noise, over and under the displayable range.
+    const int kWidth = 3840, kHeight = 2160;
+    image frame(kWidth, kHeight);
+    uint32_t state = 1;
+    for (int y = 0; y < kHeight; y++)
+    {
+        for (int x = 0; x < kWidth; x++)
+        {
+            state = state * 1664525u + 1013904223u;
+            double noise = (state >> 8) * 0x1p-24 * 0.05;
+            frame.setPixel(x, y, color(1.2 * x / kWidth + noise, double(y) / kHeight + noise,
+                                       0.5 + 0.5 * std::sin(x * 0.01) * noise));
+        }
+    }
+
+    double pixels = double(kWidth) * kHeight;
+    std::cout << "  " << kWidth << "x" << kHeight << " frame\n";
+
+    std::ostringstream text;
+    double seconds = bench::TimeSeconds([&]()
+                                        { frame.writePPM(text); });
+    std::cout << "  text PPM through a stream (flushToPPM): " << seconds * 1e3 << " ms, " << text.str().size() / 1e6
+              << " MB\n";
+
+    const char *kPaths[] = {"/tmp/pathtracer_bench.ppm", "/tmp/pathtracer_bench.pfm", "/tmp/pathtracer_bench.png"};
+    for (const char *path : kPaths)
+    {
+        seconds = bench::TimeSeconds([&]()
+                                     { frame.writeFile(path); });
+        FILE *file = fopen(path, "rb");
+        long size = 0;
+        if (file)
+        {
+            fseek(file, 0, SEEK_END);
+            size = ftell(file);
+            fclose(file);
+        }
+        std::cout << "  " << path << ": " << seconds * 1e3 << " ms, " << size / 1e6 << " MB\n";
+        remove(path);
+    }
+
+    // The same files written 16 rows at a time, as MultiThreadCamera::stream_output_ does, from
+    // bands in each pixel format.
+    const int kBandRows = 16;
+    const PixelFormat kFormats[] = {PixelFormat::kDouble, PixelFormat::kFloat, PixelFormat::kHalf};
+    const char *kFormatNames[] = {"double", "float", "half"};
+    for (int f = 0; f < 3; f++)
+    {
+        std::vector<image> bands;
+        for (int y = 0; y < kHeight; y += kBandRows)
+        {
+            bands.emplace_back(kWidth, kBandRows, kFormats[f], y);
+            for (int row = y; row < y + kBandRows; row++)
+                for (int x = 0; x < kWidth; x++)
+                    bands.back().setPixel(x, row, frame.pixel(x, row));
+        }
+
+        std::cout << "  " << kFormatNames[f] << " pixels, " << kBandRows << "-row bands of "
+                  << kWidth * kBandRows * 3 * (f == 0 ? 8 : f == 1 ? 4 : 2) / 1e6 << " MB:";
+        for (const char *path : {"/tmp/pathtracer_bench.pfm", "/tmp/pathtracer_bench.png"})
+        {
+            seconds = bench::TimeSeconds([&]()
+                                         {
+                ImageWriter writer(path, kWidth, kHeight, FormatForPath(path));
+                for (const image &band : bands)
+                    writer.write(band);
+                writer.finish(); });
+            std::cout << "  " << (path + strlen(path) - 3) << " " << seconds * 1e3 << " ms";
+            remove(path);
+        }
+        std::cout << "\n";
+    }
+
+    std::vector<float> floats = frame.toFloats();
+    std::vector<unsigned char> bytes(floats.size());
+    for (simd::Isa isa : {simd::Isa::kScalar, simd::Isa::kSse, simd::Isa::kAvx2})
+    {
+        if (isa > simd::BestIsa())
+            continue;
+        simd::SetIsa(isa);
+        seconds = bench::TimeSeconds([&]()
+                                     { simd::Quantize(floats.data(), bytes.data(), floats.size()); });
+        bench::Report(simd::IsaName(isa), seconds, pixels, "pixels");
+    }
+    simd::SetIsa(simd::BestIsa());
+}
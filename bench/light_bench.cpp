@@ -0,0 +1,46 @@
+#include "bench.h"
+
+#include "ptmath/vec3.h"
+#include "ptmath/ray.h"
+#include "graphics/image.h"
+#include "scene/object/object.h"
+#include "scene/object/linear_bvh.h"
+#include "scene/camera.h"
+
+#include <vector>
+
+using namespace ptmath;
+using namespace scene;
+
+void bench::LightBenchmark()
+{
+    HittableGroup world;
+    bench::BenchCamera cam;
+    cam.image_width_ = 64;
+    cam.image_height_ = 36;
+    cam.max_depth_ = 5;
+    CornellBox(world, cam);
+    CompiledScene scene(world);
+
+    bench::QuietLog quiet;
+    double seconds;
+    cam.samples_per_pixel_ = 2048;
+    cam.seed_ = 1;
+    std::vector<color> reference = cam.RenderPixels(scene, &seconds);
+    cam.seed_ = 0;
+
+    std::cout << "  Cornell box, " << cam.image_width_ << "x" << cam.image_height_ << ", RMSE against "
+              << cam.samples_per_pixel_ << " samples per pixel with light sampling\n";
+
+    for (bool light_sampling : {false, true})
+    {
+        cam.light_sampling_ = light_sampling;
+        for (int spp : {16, 64, 256})
+        {
+            cam.samples_per_pixel_ = spp;
+            double rmse = bench::Rmse(cam.RenderPixels(scene, &seconds), reference);
+            std::cout << "  " << (light_sampling ? "light sampling" : "bsdf sampling only") << ", " << spp
+                      << " spp: RMSE " << rmse << ", " << seconds * 1e3 << " ms\n";
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#include "bench.h"
+
+#include <cstring>
+
+struct Benchmark
+{
+    const char *name;
+    void (*run)();
+};
+
+static const Benchmark kBenchmarks[] = {
+    {"traversal", bench::TraversalBenchmark},
+    {"mesh", bench::MeshBenchmark},
+    {"triangle", bench::TriangleBenchmark},
+    {"simd", bench::SimdBenchmark},
+    {"packet", bench::PacketBenchmark},
+    {"schedule", bench::ScheduleBenchmark},
+    {"sampler", bench::SamplerBenchmark},
+    {"light", bench::LightBenchmark},
+    {"roulette", bench::RouletteBenchmark},
+    {"adaptive", bench::AdaptiveBenchmark},
+    {"image", bench::ImageBenchmark},
+    {"material", bench::MaterialBenchmark},
+    {"dispatch", bench::DispatchBenchmark},
+    {"build", bench::BuildBenchmark},
+    {"wide", bench::WideBenchmark},
+    {"wavefront", bench::WavefrontBenchmark},
+};
+
+int main(int argc, char **argv)
+{
+    // With no arguments every benchmark runs; otherwise only the named ones.
+    for (const Benchmark &b : kBenchmarks)
+    {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; i++)
+            selected |= strcmp(argv[i], b.name) == 0;
+
+        if (selected)
+        {
+            std::cout << b.name << "\n";
+            b.run();
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#include "bench.h"
+
+#include "ptmath/vec3.h"
+#include "ptmath/ray.h"
+#include "graphics/image.h"
+#include "util/parallel.h"
+#include "util/rng.h"
+#include "scene/object/object.h"
+#include "scene/object/sphere.h"
+#include "scene/object/linear_bvh.h"
+#include "scene/material.h"
+#include "scene/material_table.h"
+#include "scene/camera.h"
+
+using namespace ptmath;
+using namespace scene;
+
+// The Weekend scene of main.cpp: hundreds of spheres, most with a material of their own.
+void bench::Weekend(HittableGroup &world, Camera &cam)
+{
+    util::Rng rng(7, 0);
+    auto random = [&]()
+    { return rng.NextDouble(); };
+
+    world.add(make_shared<sphere>(Point3(0, -1000, 0), 1000, make_shared<Lambertian>(color(0.5, 0.5, 0.5))));
+    for (int a = -11; a < 11; a++)
+    {
+        for (int b = -11; b < 11; b++)
+        {
+            double choose_mat = random();
+            Point3 center(a + 0.9 * random(), 0.2, b + 0.9 * random());
+            if ((center - Point3(4, 0.2, 0)).length() <= 0.9)
+                continue;
+
+            shared_ptr<Material> material;
+            if (choose_mat < 0.8)
+                material = make_shared<Lambertian>(color(random() * random(), random() * random(), random() * random()));
+            else if (choose_mat < 0.95)
+                material = make_shared<Metal>(color(0.5 + random() / 2, 0.5 + random() / 2, 0.5 + random() / 2));
+            else
+                material = make_shared<Dielectric>(1.5);
+            world.add(make_shared<sphere>(center, 0.2, material));
+        }
+    }
+
+    world.add(make_shared<sphere>(Point3(0, 1, 0), 1.0, make_shared<Dielectric>(1.5)));
+    world.add(make_shared<sphere>(Point3(-4, 1, 0), 1.0,
+                                  make_shared<CheckeredLambertian>(.1, color(0, 0, 0), color(1, 0, 1))));
+    world.add(make_shared<sphere>(Point3(4, 1, 0), 1.0, make_shared<Metal>(color(0.7, 0.6, 0.5))));
+
+    cam.vfov_ = 20;
+    cam.look_from_ = Point3(13, 2, 3);
+    cam.lookat_ = Point3(0, 0, 0);
+    cam.vup_ = Vec3(0, 1, 0);
+}
+
+void bench::MaterialBenchmark()
+{
+    HittableGroup world;
+    bench::BenchCamera cam;
+    cam.image_width_ = 320;
+    cam.image_height_ = 180;
+    cam.samples_per_pixel_ = 4;
+    cam.max_depth_ = 8;
+    Weekend(world, cam);
+    CompiledScene scene(world);
+
+    bench::QuietLog quiet;
+    std::cout << "  Weekend, " << cam.image_width_ << "x" << cam.image_height_ << ", HitRecord " << sizeof(HitRecord)
+              << " bytes, " << scene.material_count() << " materials\n";
+
+    // Every hit used to copy a shared_ptr, so the speed-up with more threads shows how much
+    // the threads still contend on shared cache lines.
+    double samples = double(cam.image_width_) * cam.image_height_ * cam.samples_per_pixel_;
+    double one_thread = 0;
+    image output(cam.image_width_, cam.image_height_);
+    for (int threads : {1, 2, 4, 8})
+    {
+        util::TaskPool pool(threads);
+        double seconds = cam.RenderSeconds(scene, output, pool);
+        if (threads == 1)
+            one_thread = seconds;
+        std::string name = std::to_string(threads) + (threads == 1 ? " thread" : " threads");
+        bench::Report(name.c_str(), seconds, samples, "samples");
+        std::cout << "    speed-up " << one_thread / seconds << "x\n";
+    }
+}
@@ -0,0 +1,62 @@
+#include "bench.h"
+
+#include "ptmath/vec3.h"
+#include "ptmath/ray.h"
+#include "scene/object/mesh.h"
+
+#include <memory>
+
+using namespace ptmath;
+using namespace scene;
+
+namespace
+{
+    void LoadAndTrace(const char *path)
+    {
+        std::unique_ptr<ObjMesh> mesh;
+        double parse_seconds = bench::TimeSeconds([&]()
+                                                  { mesh = std::make_unique<ObjMesh>(path, false); });
+
+        std::cout << "  " << path << ": " << mesh->triangle_count() << " triangles, "
+                  << mesh->vertex_count() << " vertices, " << mesh->memory_usage() / 1024 << " KiB\n";
+        bench::Report("parse", parse_seconds, mesh->triangle_count(), "triangles");
+
+        // Make sure the cache exists, then time loading through it.
+        ObjMesh warmup(path);
+        double cached_seconds = bench::TimeSeconds([&]()
+                                                   { mesh = std::make_unique<ObjMesh>(path); });
+        if (!mesh->from_cache())
+            std::cout << "  cache was not used\n";
+        bench::Report("cached", cached_seconds, mesh->triangle_count(), "triangles");
+
+        // Rays from outside the bounding box towards random points inside it.
+        aabb box = mesh->bounding_box();
+        Point3 center = box.centroid();
+        double radius = (box.max() - box.min()).length();
+        const int kRays = 200000;
+        int hits = 0;
+        double trace_seconds = bench::TimeSeconds([&]()
+                                                  {
+            for (int i = 0; i < kRays; i++)
+            {
+                Point3 from = center + radius * unit_vector(Vec3::random(-1, 1));
+                Point3 to(util::RandomDouble(box.x.min, box.x.max), util::RandomDouble(box.y.min, box.y.max),
+                          util::RandomDouble(box.z.min, box.z.max));
+                HitRecord rec;
+                hits += mesh->hit(ray(from, to - from), interval(0.001, INFINITY), rec);
+            } });
+        bench::Report("trace", trace_seconds, kRays, "rays");
+        std::cout << "  " << hits << " of " << kRays << " rays hit\n";
+    }
+}
+
+void bench::MeshBenchmark()
+{
+    // Binaries built with another PRECISION or VEC4 (see the makefile) run the same scenes, so
+    // their numbers can be compared directly.
+    std::cout << "  vector layout: " << (sizeof(Real) == sizeof(float) ? "float" : "double") << ", "
+              << kVec3Lanes << " lanes, Vec3 " << sizeof(Vec3) << " bytes, HitRecord " << sizeof(HitRecord)
+              << " bytes\n";
+    LoadAndTrace("assets/skyline/model.obj");
+    LoadAndTrace("assets/iss/InternationalSpaceStation.obj");
+}
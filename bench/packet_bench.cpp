@@ -0,0 +1,152 @@
+#include "bench.h"
+
+#include "ptmath/vec3.h"
+#include "ptmath/ray.h"
+#include "graphics/image.h"
+#include "scene/object/object.h"
+#include "scene/object/quad.h"
+#include "scene/object/parallelepiped.h"
+#include "scene/object/linear_bvh.h"
+#include "scene/object/mesh.h"
+#include "scene/material.h"
+#include "scene/camera.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace ptmath;
+using namespace scene;
+
+namespace
+{
+    // The primary rays of one sample, grouped by packet_size_ x packet_size_ tile.
+    std::vector<std::vector<ray>> PrimaryTiles(bench::BenchCamera &cam, const CompiledScene &world)
+    {
+        cam.Initialize(world);
+        int tile = std::max(cam.packet_size_, 1);
+        std::vector<std::vector<ray>> tiles;
+        for (int y0 = 0; y0 < cam.image_height_; y0 += tile)
+        {
+            for (int x0 = 0; x0 < cam.image_width_; x0 += tile)
+            {
+                tiles.emplace_back();
+                for (int y = y0; y < std::min(y0 + tile, cam.image_height_); y++)
+                {
+                    for (int x = x0; x < std::min(x0 + tile, cam.image_width_); x++)
+                    {
+                        util::PixelSampler sampler = cam.SamplePixel(x, y, 0);
+                        tiles.back().push_back(cam.GetRayForPixel(x, y, sampler));
+                    }
+                }
+            }
+        }
+        return tiles;
+    }
+
+    // Traces the rays tile by tile, either one at a time or as one packet per tile.
+    double TraceTiles(const Hittable &world, const std::vector<std::vector<ray>> &tiles, bool packets, int &hits)
+    {
+        hits = 0;
+        RayPacket packet;
+        return bench::TimeSeconds([&]()
+                                  {
+            for (const auto &tile : tiles)
+            {
+                packet.size = 0;
+                for (const ray &r : tile)
+                    packet.add(r);
+
+                if (packets)
+                {
+                    world.hit_packet(packet);
+                }
+                else
+                {
+                    for (int k = 0; k < packet.size; k++)
+                        packet.hit[k] = world.hit(packet.rays[k], packet.ray_t(k), packet.rec[k]);
+                }
+
+                for (int k = 0; k < packet.size; k++)
+                    hits += packet.hit[k];
+            } });
+    }
+
+    void ComparePrimary(const char *scene_name, const CompiledScene &world, bench::BenchCamera &cam)
+    {
+        for (int size : {4, 8})
+        {
+            cam.packet_size_ = size;
+            auto tiles = PrimaryTiles(cam, world);
+            int single_hits, packet_hits;
+            double single = TraceTiles(world, tiles, false, single_hits);
+            double packet = TraceTiles(world, tiles, true, packet_hits);
+
+            std::string name = std::string(scene_name) + " " + std::to_string(size) + "x" + std::to_string(size);
+            int rays = cam.image_width_ * cam.image_height_;
+            bench::Report((name + " primary, single rays").c_str(), single, rays, "rays");
+            bench::Report((name + " primary, packets").c_str(), packet, rays, "rays");
+            std::cout << "  speedup " << single / packet << "\n";
+            if (single_hits != packet_hits)
+                std::cout << "  hit count mismatch: " << packet_hits << " vs " << single_hits << "\n";
+        }
+    }
+
+}
+
+void bench::CornellBox(HittableGroup &world, Camera &cam)
+{
+    auto red = make_shared<Lambertian>(color(.65, .05, .05));
+    auto white = make_shared<Lambertian>(color(.73, .73, .73));
+    auto green = make_shared<Lambertian>(color(.12, .45, .15));
+    auto light = make_shared<Light>(color(15, 15, 15));
+
+    world.add(make_shared<quad>(Point3(555, 0, 0), Vec3(0, 555, 0), Vec3(0, 0, 555), green));
+    world.add(make_shared<quad>(Point3(0, 0, 0), Vec3(0, 555, 0), Vec3(0, 0, 555), red));
+    world.add(make_shared<quad>(Point3(343, 554, 332), Vec3(-130, 0, 0), Vec3(0, 0, -105), light));
+    world.add(make_shared<quad>(Point3(0, 0, 0), Vec3(555, 0, 0), Vec3(0, 0, 555), white));
+    world.add(make_shared<quad>(Point3(555, 555, 555), Vec3(-555, 0, 0), Vec3(0, 0, -555), white));
+    world.add(make_shared<quad>(Point3(0, 0, 555), Vec3(555, 0, 0), Vec3(0, 555, 0), white));
+    world.add(make_shared<Parallelepiped>(Point3(130, 0, 65), Point3(295, 165, 230), white));
+    world.add(make_shared<Parallelepiped>(Point3(265, 0, 295), Point3(430, 330, 460), white));
+
+    cam.vfov_ = 40;
+    cam.look_from_ = Point3(278, 278, -800);
+    cam.lookat_ = Point3(278, 278, 0);
+    cam.vup_ = Vec3(0, 1, 0);
+}
+
+void bench::PacketBenchmark()
+{
+    HittableGroup world;
+    bench::BenchCamera cam;
+    cam.image_width_ = 320;
+    cam.image_height_ = 180;
+    cam.samples_per_pixel_ = 4;
+    cam.max_depth_ = 5;
+    bench::CornellBox(world, cam);
+    CompiledScene scene(world);
+
+    bench::QuietLog quiet;
+    int pixels = cam.image_width_ * cam.image_height_;
+    std::cout << "  Cornell box, " << cam.image_width_ << "x" << cam.image_height_ << ", "
+              << cam.samples_per_pixel_ << " samples per pixel\n";
+
+    ComparePrimary("cornell", scene, cam);
+
+    image output(cam.image_width_, cam.image_height_);
+    for (int size : {0, 4, 8})
+    {
+        cam.packet_size_ = size;
+        double seconds = cam.RenderSeconds(scene, output);
+        std::string name = size == 0 ? "render, single rays" : "render, " + std::to_string(size) + "x" +
+                                                                   std::to_string(size) + " packets";
+        bench::Report(name.c_str(), seconds, double(pixels) * cam.samples_per_pixel_, "samples");
+    }
+
+    HittableGroup skyline;
+    skyline.add(make_shared<ObjMesh>("assets/skyline/model.obj"));
+    cam.look_from_ = Point3(-2, 4, 6);
+    cam.lookat_ = Point3(-0.5, 0.5, 1.3);
+    ComparePrimary("skyline", CompiledScene(skyline), cam);
+}
@@ -0,0 +1,82 @@
+#include "bench.h"
+
+#include "ptmath/vec3.h"
+#include "ptmath/ray.h"
+#include "graphics/image.h"
+#include "scene/object/object.h"
+#include "scene/object/sphere.h"
+#include "scene/object/parallelepiped.h"
+#include "scene/object/linear_bvh.h"
+#include "scene/material.h"
+#include "scene/camera.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace ptmath;
+using namespace scene;
+
+namespace
+{
+    double Mean(const std::vector<color> &pixels)
+    {
+        double sum = 0;
+        for (const color &c : pixels)
+            sum += (c.x() + c.y() + c.z()) / 3;
+        return sum / pixels.size();
+    }
+}
+
+void bench::Room(HittableGroup &world, Camera &cam)
+{
+    auto walls = make_shared<Lambertian>(color(0.7, 0.6, 0.5));
+    auto light = make_shared<Light>(color(1, 1, 1));
+    auto red = make_shared<Lambertian>(color(1, 0, 0));
+
+    double box_scale = 4;
+    world.add(make_shared<Parallelepiped>(box_scale * Point3(-1, -1, -1), box_scale * Point3(1, 1, 1), walls));
+    world.add(make_shared<Parallelepiped>((box_scale / 4) * Point3(-1, -1, -1) + Vec3(0, box_scale * 1.2, 0),
+                                          (box_scale / 4) * Point3(1, 1, 1) + Vec3(0, box_scale * 1.2, 0), light));
+    world.add(make_shared<sphere>(Point3(0, 0, 0), 1.0, red));
+
+    cam.look_from_ = Point3(0, 0, .99 * box_scale);
+    cam.lookat_ = Point3(0, 0, 0);
+}
+
+void bench::RouletteBenchmark()
+{
+    HittableGroup world;
+    bench::BenchCamera cam;
+    cam.image_width_ = 48;
+    cam.image_height_ = 27;
+    cam.max_depth_ = 64;
+    Room(world, cam);
+    CompiledScene scene(world);
+
+    bench::QuietLog quiet;
+    double seconds;
+    cam.min_depth_ = cam.max_depth_;
+    cam.samples_per_pixel_ = 512;
+    cam.seed_ = 1;
+    std::vector<color> reference = cam.RenderPixels(scene, &seconds);
+    cam.seed_ = 0;
+
+    std::cout << "  Room, " << cam.image_width_ << "x" << cam.image_height_ << ", max depth " << cam.max_depth_
+              << ", RMSE against " << cam.samples_per_pixel_ << " samples per pixel without roulette (mean "
+              << Mean(reference) << ")\n";
+
+    // Efficiency is 1 / (RMSE^2 * time): how much less noise a second of rendering buys.
+    cam.samples_per_pixel_ = 64;
+    for (int min_depth : {cam.max_depth_, 8, 3, 1})
+    {
+        cam.min_depth_ = min_depth;
+        std::vector<color> pixels = cam.RenderPixels(scene, &seconds);
+        double rmse = bench::Rmse(pixels, reference);
+        if (min_depth >= cam.max_depth_)
+            std::cout << "  no roulette";
+        else
+            std::cout << "  roulette after " << min_depth << " bounces";
+        std::cout << ": " << seconds * 1e3 << " ms, mean " << Mean(pixels) << ", RMSE " << rmse
+                  << ", efficiency " << 1 / (rmse * rmse * seconds) << "\n";
+    }
+}
@@ -0,0 +1,75 @@
+#include "bench.h"
+
+#include "ptmath/vec3.h"
+#include "ptmath/ray.h"
+#include "graphics/image.h"
+#include "util/sampler.h"
+#include "scene/object/object.h"
+#include "scene/object/sphere.h"
+#include "scene/object/linear_bvh.h"
+#include "scene/material.h"
+#include "scene/camera.h"
+
+#include <vector>
+
+using namespace ptmath;
+using namespace scene;
+
+namespace
+{
+    // The rendered pixels, clamped to the displayable range.
+    std::vector<color> ClampedPixels(bench::BenchCamera &cam, const CompiledScene &world)
+    {
+        std::vector<color> pixels = cam.RenderPixels(world);
+        bench::ClampPixels(pixels);
+        return pixels;
+    }
+}
+
+void bench::SkySpheres(HittableGroup &world, Camera &cam)
+{
+    world.add(make_shared<sphere>(Point3(0, -1000, 0), 1000, make_shared<Lambertian>(color(0.5, 0.5, 0.5))));
+    world.add(make_shared<sphere>(Point3(-2.2, 1, 0), 1.0, make_shared<Lambertian>(color(0.4, 0.2, 0.1))));
+    world.add(make_shared<sphere>(Point3(0, 1, 0), 1.0, make_shared<Dielectric>(1.5)));
+    world.add(make_shared<sphere>(Point3(2.2, 1, 0), 1.0, make_shared<Metal>(color(0.7, 0.6, 0.5))));
+
+    cam.vfov_ = 30;
+    cam.look_from_ = Point3(0, 2, 9);
+    cam.lookat_ = Point3(0, 0.8, 0);
+    cam.vup_ = Vec3(0, 1, 0);
+}
+
+void bench::SamplerBenchmark()
+{
+    HittableGroup world;
+    bench::BenchCamera cam;
+    cam.image_width_ = 64;
+    cam.image_height_ = 36;
+    cam.max_depth_ = 5;
+    SkySpheres(world, cam);
+    CompiledScene scene(world);
+
+    bench::QuietLog quiet;
+    cam.sampler_type_ = util::SamplerType::kSobol;
+    cam.samples_per_pixel_ = 4096;
+    cam.seed_ = 1;
+    std::vector<color> reference = ClampedPixels(cam, scene);
+    cam.seed_ = 0;
+
+    std::cout << "  spheres under the sky, " << cam.image_width_ << "x" << cam.image_height_
+              << ", RMSE against " << cam.samples_per_pixel_ << " samples per pixel\n";
+
+    const util::SamplerType kTypes[] = {util::SamplerType::kIndependent, util::SamplerType::kStratified,
+                                        util::SamplerType::kSobol, util::SamplerType::kBlueNoise};
+    for (util::SamplerType type : kTypes)
+    {
+        cam.sampler_type_ = type;
+        std::cout << "  " << util::SamplerName(type) << ":";
+        for (int spp : {4, 16, 64})
+        {
+            cam.samples_per_pixel_ = spp;
+            std::cout << "  " << spp << " spp " << bench::Rmse(ClampedPixels(cam, scene), reference);
+        }
+        std::cout << "\n";
+    }
+}
@@ -0,0 +1,41 @@
+#include "bench.h"
+
+#include "ptmath/vec3.h"
+#include "ptmath/ray.h"
+#include "graphics/image.h"
+#include "util/parallel.h"
+#include "scene/object/object.h"
+#include "scene/object/linear_bvh.h"
+#include "scene/camera.h"
+
+using namespace ptmath;
+using namespace scene;
+
+void bench::ScheduleBenchmark()
+{
+    HittableGroup world;
+    bench::BenchCamera cam;
+    cam.image_width_ = 320;
+    cam.image_height_ = 180;
+    cam.samples_per_pixel_ = 4;
+    cam.max_depth_ = 5;
+    CornellBox(world, cam);
+    CompiledScene scene(world);
+
+    bench::QuietLog quiet;
+    int pixels = cam.image_width_ * cam.image_height_;
+    int threads = std::max(4u, std::thread::hardware_concurrency());
+    std::cout << "  Cornell box, " << cam.image_width_ << "x" << cam.image_height_ << ", " << threads
+              << " threads, " << cam.tile_size_ << "x" << cam.tile_size_ << " tiles\n";
+
+    image output(cam.image_width_, cam.image_height_);
+    for (bool steal : {false, true})
+    {
+        // The pool's per-thread times show how evenly the work was spread.
+        util::TaskPool pool(threads);
+        double seconds = cam.RenderSeconds(scene, output, pool, steal);
+        pool.PrintStats(std::cout);
+        bench::Report(steal ? "work stealing" : "static bands", seconds, double(pixels) * cam.samples_per_pixel_,
+                      "samples");
+    }
+}
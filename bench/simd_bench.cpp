@@ -0,0 +1,174 @@
+#include "bench.h"
+
+#include "ptmath/vec3.h"
+#include "ptmath/ray.h"
+#include "ptmath/simd.h"
+#include "scene/object/object.h"
+#include "scene/object/sphere.h"
+#include "scene/object/quad.h"
+#include "scene/object/linear_bvh.h"
+#include "scene/object/mesh.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace ptmath;
+using namespace scene;
+
+namespace
+{
+    const simd::Isa kIsas[] = {simd::Isa::kScalar, simd::Isa::kSse, simd::Isa::kAvx2};
+
+    // Kernel throughput without any traversal: every ray against every primitive, in groups of
+    // kLeaf as a BVH leaf would present them.
+    template <typename Kernel>
+    double KernelSeconds(size_t prim_count, const std::vector<ray> &rays, Kernel &&kernel, int &hits)
+    {
+        const size_t kLeaf = 8;
+        hits = 0;
+        return bench::TimeSeconds([&]()
+                                  {
+            for (const ray &r : rays)
+            {
+                simd::RayData data = simd::MakeRayData(r);
+                float t_max = INFINITY;
+                for (size_t first = 0; first < prim_count; first += kLeaf)
+                    hits += kernel(first, std::min(kLeaf, prim_count - first), data, t_max) >= 0;
+            } });
+    }
+
+    std::vector<ray> RaysThrough(const aabb &box, int count)
+    {
+        Point3 center = box.centroid();
+        double radius = (box.max() - box.min()).length();
+        std::vector<ray> rays;
+        for (int i = 0; i < count; i++)
+        {
+            Point3 from = center + radius * unit_vector(Vec3::random(-1, 1));
+            Point3 to(util::RandomDouble(box.x.min, box.x.max), util::RandomDouble(box.y.min, box.y.max),
+                      util::RandomDouble(box.z.min, box.z.max));
+            rays.emplace_back(from, to - from);
+        }
+        return rays;
+    }
+
+    void KernelBenchmark()
+    {
+        const int kPrims = 4096;
+        simd::SphereSoA spheres(kPrims);
+        simd::QuadSoA quads(kPrims);
+        for (int i = 0; i < kPrims; i++)
+        {
+            Point3 p = Point3::random(-10, 10);
+            spheres.Set(i, p, util::RandomDouble(0.05, 0.3));
+            quads.Set(i, p, Vec3::random(-0.5, 0.5), Vec3::random(-0.5, 0.5));
+        }
+
+        ObjMesh mesh("assets/skyline/model.obj");
+        simd::TriangleSoA triangles(mesh.triangle_count());
+        for (size_t i = 0; i < mesh.triangle_count(); i++)
+        {
+            const Mesh::Triangle &tri = mesh.triangles()[i];
+            triangles.Set(i, mesh.vertices()[tri.vertex[0]], mesh.vertices()[tri.vertex[1]],
+                          mesh.vertices()[tri.vertex[2]]);
+        }
+
+        std::vector<ray> rays = RaysThrough(aabb(Point3(-10, -10, -10), Point3(10, 10, 10)), 2000);
+        std::vector<ray> mesh_rays = RaysThrough(mesh.bounding_box(), 200);
+        std::cout << "  " << kPrims << " spheres and quads, " << rays.size() << " rays; "
+                  << triangles.size() << " triangles, " << mesh_rays.size() << " rays\n";
+
+        for (simd::Isa isa : kIsas)
+        {
+            simd::SetIsa(isa);
+            if (simd::ActiveIsa() != isa)
+                continue;
+
+            const simd::KernelTable &k = simd::ActiveKernels();
+            std::string name = simd::IsaName(isa);
+            int hits;
+
+            simd::SphereArrays s = spheres.arrays();
+            double seconds = KernelSeconds(
+                kPrims, rays, [&](size_t first, size_t count, const simd::RayData &r, float &t_max)
+                { return k.sphere(s, first, count, r, 0.001f, &t_max); }, hits);
+            bench::Report((name + " spheres").c_str(), seconds, double(kPrims) * rays.size(), "tests");
+
+            simd::QuadArrays q = quads.arrays();
+            seconds = KernelSeconds(
+                kPrims, rays, [&](size_t first, size_t count, const simd::RayData &r, float &t_max)
+                { return k.quad(q, first, count, r, 0.001f, &t_max); }, hits);
+            bench::Report((name + " quads").c_str(), seconds, double(kPrims) * rays.size(), "tests");
+
+            simd::TriangleArrays t = triangles.arrays();
+            seconds = KernelSeconds(
+                triangles.size(), mesh_rays, [&](size_t first, size_t count, const simd::RayData &r, float &t_max)
+                { return k.triangle(t, first, count, r, 0.001f, &t_max); }, hits);
+            bench::Report((name + " triangles").c_str(), seconds, double(triangles.size()) * mesh_rays.size(),
+                          "tests");
+        }
+        simd::SetIsa(simd::BestIsa());
+    }
+
+    // Whole-scene tracing through LinearBvhGroup and Mesh with each kernel set.
+    void TraceBenchmark()
+    {
+        HittableGroup world;
+        world.add(make_shared<sphere>(Point3(0, -1000, 0), 1000, nullptr));
+        for (int a = -11; a < 11; a++)
+        {
+            for (int b = -11; b < 11; b++)
+            {
+                Point3 center(a + 0.9 * util::RandomDouble(), 0.2, b + 0.9 * util::RandomDouble());
+                if (util::RandomDouble() < 0.5)
+                    world.add(make_shared<sphere>(center, 0.2, nullptr));
+                else
+                    world.add(make_shared<quad>(center, Vec3(0.3, 0, 0), Vec3(0, 0.3, 0.1), nullptr));
+            }
+        }
+        LinearBvhGroup group(world);
+        ObjMesh mesh("assets/skyline/model.obj");
+
+        std::vector<ray> rays = RaysThrough(aabb(Point3(-12, 0, -12), Point3(12, 1, 12)), 200000);
+        std::vector<ray> mesh_rays = RaysThrough(mesh.bounding_box(), 200000);
+
+        for (simd::Isa isa : kIsas)
+        {
+            simd::SetIsa(isa);
+            if (simd::ActiveIsa() != isa)
+                continue;
+
+            std::string name = simd::IsaName(isa);
+            int hits = 0;
+            double seconds = bench::TimeSeconds([&]()
+                                                {
+                for (const ray &r : rays)
+                {
+                    HitRecord rec;
+                    hits += group.hit(r, interval(0.001, INFINITY), rec);
+                } });
+            bench::Report((name + " spheres and quads").c_str(), seconds, rays.size(), "rays");
+            std::cout << "    " << hits << " hits\n";
+
+            hits = 0;
+            seconds = bench::TimeSeconds([&]()
+                                         {
+                for (const ray &r : mesh_rays)
+                {
+                    HitRecord rec;
+                    hits += mesh.hit(r, interval(0.001, INFINITY), rec);
+                } });
+            bench::Report((name + " skyline").c_str(), seconds, mesh_rays.size(), "rays");
+            std::cout << "    " << hits << " hits\n";
+        }
+        simd::SetIsa(simd::BestIsa());
+    }
+}
+
+void bench::SimdBenchmark()
+{
+    std::cout << "  best isa: " << simd::IsaName(simd::BestIsa()) << "\n";
+    KernelBenchmark();
+    TraceBenchmark();
+}
@@ -0,0 +1,80 @@
+#include "bench.h"
+
+#include "ptmath/vec3.h"
+#include "ptmath/ray.h"
+#include "scene/object/object.h"
+#include "scene/object/sphere.h"
+#include "scene/object/bvh.h"
+#include "scene/object/linear_bvh.h"
+
+#include <vector>
+
+using namespace ptmath;
+using namespace scene;
+
+namespace
+{
+    // Same layout as the Weekend scene: a ground sphere and a grid of small spheres.
+    void MakeWeekendSpheres(HittableGroup &world)
+    {
+        world.add(make_shared<sphere>(Point3(0, -1000, 0), 1000, nullptr));
+        for (int a = -11; a < 11; a++)
+        {
+            for (int b = -11; b < 11; b++)
+            {
+                Point3 center(a + 0.9 * util::RandomDouble(), 0.2, b + 0.9 * util::RandomDouble());
+                world.add(make_shared<sphere>(center, 0.2, nullptr));
+            }
+        }
+        world.add(make_shared<sphere>(Point3(0, 1, 0), 1.0, nullptr));
+        world.add(make_shared<sphere>(Point3(-4, 1, 0), 1.0, nullptr));
+        world.add(make_shared<sphere>(Point3(4, 1, 0), 1.0, nullptr));
+    }
+
+    double TraceAll(const Hittable &world, const std::vector<ray> &rays, int &hits)
+    {
+        hits = 0;
+        return bench::TimeSeconds([&]()
+                                  {
+            for (const ray &r : rays)
+            {
+                HitRecord rec;
+                hits += world.hit(r, interval(0.001, INFINITY), rec);
+            } });
+    }
+}
+
+void bench::TraversalBenchmark()
+{
+    HittableGroup world;
+    MakeWeekendSpheres(world);
+
+    // Rays from the Weekend camera position through the scene, plus the same number of
+    // incoherent rays starting near the ground to stand in for bounces.
+    std::vector<ray> rays;
+    const int kRays = 200000;
+    for (int i = 0; i < kRays; i++)
+    {
+        Point3 target(util::RandomDouble(-12, 12), util::RandomDouble(-1, 3), util::RandomDouble(-12, 12));
+        rays.emplace_back(Point3(13, 2, 3), target - Point3(13, 2, 3));
+        rays.emplace_back(Point3(util::RandomDouble(-11, 11), 0.01, util::RandomDouble(-11, 11)),
+                          Vec3(util::RandomDouble(-1, 1), util::RandomDouble(0, 1), util::RandomDouble(-1, 1)));
+    }
+
+    std::cout << "  " << world.objects.size() << " spheres, " << rays.size() << " rays\n";
+
+    int hits;
+    BvhNode tree(world);
+    LinearBvhGroup flat(world);
+
+    bench::Report("HittableGroup", TraceAll(world, rays, hits), rays.size(), "rays");
+    int reference = hits;
+    bench::Report("BvhNode", TraceAll(tree, rays, hits), rays.size(), "rays");
+    if (hits != reference)
+        std::cout << "  BvhNode hit count mismatch: " << hits << " vs " << reference << "\n";
+    bench::Report("LinearBvhGroup", TraceAll(flat, rays, hits), rays.size(), "rays");
+    if (hits != reference)
+        std::cout << "  LinearBvhGroup hit count mismatch: " << hits << " vs " << reference << "\n";
+    std::cout << "  " << flat.bvh().nodes().size() << " linear nodes ("
+              << flat.bvh().nodes().size() * sizeof(LinearBvhNode) << " bytes)\n";
+}
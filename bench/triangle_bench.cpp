@@ -0,0 +1,194 @@
+#include "bench.h"
+
+#include "ptmath/vec3.h"
+#include "ptmath/ray.h"
+#include "ptmath/tri3.h"
+#include "scene/object/mesh.h"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+using namespace ptmath;
+using namespace scene;
+
+namespace
+{
+    // The intersector Tri3 used before: the plane hit first, then three edge cross products,
+    // with t returned through an int.
+    struct LegacyTri3
+    {
+        Point3 p[3];
+        Vec3 e[3];
+        Vec3 normal;
+
+        LegacyTri3(const Point3 &p1, const Point3 &p2, const Point3 &p3) : p{p1, p2, p3}
+        {
+            normal = cross(p2 - p1, p3 - p1);
+            e[0] = p2 - p1;
+            e[1] = p3 - p2;
+            e[2] = p1 - p3;
+        }
+
+        bool intersect(const ray &r, int &t) const
+        {
+            float NdotRayDirection = dot(normal, r.direction());
+            if (fabs(NdotRayDirection) < kEpsilon)
+                return false;
+
+            float d = -dot(normal, p[0]);
+            t = -(dot(normal, r.origin()) + d) / NdotRayDirection;
+            if (t < 0)
+                return false;
+
+            Vec3 P = r.at(t);
+            for (int i = 0; i < 3; i++)
+            {
+                if (dot(normal, cross(e[i], P - p[i])) < 0)
+                    return false;
+            }
+            return true;
+        }
+    };
+
+    /**
+     * Fires rays at points on edges shared by two skyline triangles and checks Mesh::hit, with
+     * its SIMD leaves, against the exact test of every triangle: a ray that slips between the two
+     * triangles, or stops at the wrong one, counts as a miss.
+    */
+    void SharedEdges(const ObjMesh &mesh)
+    {
+        auto vertices = mesh.vertices();
+        auto triangles = mesh.triangles();
+
+        std::map<std::pair<uint32_t, uint32_t>, int> edge_uses;
+        for (const Mesh::Triangle &tri : triangles)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t a = tri.vertex[k], b = tri.vertex[(k + 1) % 3];
+                edge_uses[{std::min(a, b), std::max(a, b)}]++;
+            }
+        }
+
+        aabb box = mesh.bounding_box();
+        Point3 center = box.centroid();
+        double radius = (box.max() - box.min()).length();
+        const size_t kMaxRays = 4000;
+        const double kFractions[] = {0.5, 0.25};
+
+        size_t rays = 0, misses = 0;
+        for (const auto &[edge, uses] : edge_uses)
+        {
+            if (uses != 2 || rays >= kMaxRays)
+                continue;
+
+            for (double f : kFractions)
+            {
+                Point3 target = vertices[edge.first] + f * (vertices[edge.second] - vertices[edge.first]);
+                Point3 from = center + radius * unit_vector(Vec3::random(-1, 1));
+                ray r(from, target - from);
+                interval ray_t(0.001, INFINITY);
+
+                TriangleRay tri_ray(r);
+                Real exact = INFINITY;
+                for (const Mesh::Triangle &tri : triangles)
+                {
+                    Real t, b1, b2;
+                    if (IntersectTriangle(vertices[tri.vertex[0]], vertices[tri.vertex[1]], vertices[tri.vertex[2]],
+                                          tri_ray, t, b1, b2) &&
+                        ray_t.surrounds(t) && t < exact)
+                        exact = t;
+                }
+
+                HitRecord rec;
+                bool hit = mesh.hit(r, ray_t, rec);
+                if (exact != INFINITY && (!hit || rec.t != exact))
+                    misses++;
+                rays++;
+            }
+        }
+
+        std::cout << "  shared edges: " << rays << " rays, " << misses << " misses against the exact test"
+                  << (misses == 0 ? "" : " (FAILED)") << "\n";
+    }
+}
+
+void bench::TriangleBenchmark()
+{
+    ObjMesh mesh("assets/skyline/model.obj");
+    auto vertices = mesh.vertices();
+
+    std::vector<LegacyTri3> legacy;
+    std::vector<Tri3> tris;
+    for (const Mesh::Triangle &tri : mesh.triangles())
+    {
+        legacy.emplace_back(vertices[tri.vertex[0]], vertices[tri.vertex[1]], vertices[tri.vertex[2]]);
+        tris.emplace_back(vertices[tri.vertex[0]], vertices[tri.vertex[1]], vertices[tri.vertex[2]]);
+    }
+
+    // Every ray against every triangle, so both versions do exactly the same number of tests.
+    aabb box = mesh.bounding_box();
+    Point3 center = box.centroid();
+    double radius = (box.max() - box.min()).length();
+    std::vector<ray> rays;
+    for (int i = 0; i < 500; i++)
+    {
+        Point3 from = center + radius * unit_vector(Vec3::random(-1, 1));
+        Point3 to(util::RandomDouble(box.x.min, box.x.max), util::RandomDouble(box.y.min, box.y.max),
+                  util::RandomDouble(box.z.min, box.z.max));
+        rays.emplace_back(from, to - from);
+    }
+
+    double tests = double(rays.size()) * tris.size();
+    std::cout << "  " << tris.size() << " skyline triangles, " << rays.size() << " rays\n";
+
+    // Closest-hit distance per ray, accumulated so the work cannot be optimized away.
+    double legacy_sum = 0, sum = 0;
+    int legacy_hits = 0, hits = 0;
+
+    double legacy_seconds = bench::TimeSeconds([&]()
+                                               {
+        for (const ray &r : rays)
+        {
+            int best = INT32_MAX;
+            for (const LegacyTri3 &tri : legacy)
+            {
+                int t;
+                if (tri.intersect(r, t) && t < best)
+                    best = t;
+            }
+            if (best != INT32_MAX)
+            {
+                legacy_hits++;
+                legacy_sum += best;
+            }
+        } });
+
+    double seconds = bench::TimeSeconds([&]()
+                                        {
+        for (const ray &r : rays)
+        {
+            TriangleRay tri_ray(r);
+            double best = INFINITY;
+            for (const Tri3 &tri : tris)
+            {
+                Real t;
+                if (tri.intersect(tri_ray, t) && t > 0 && t < best)
+                    best = t;
+            }
+            if (best != INFINITY)
+            {
+                hits++;
+                sum += best;
+            }
+        } });
+
+    bench::Report("legacy Tri3", legacy_seconds, tests, "tests");
+    bench::Report("watertight", seconds, tests, "tests");
+    std::cout << "  hits: legacy " << legacy_hits << ", new " << hits
+              << "; mean closest t: legacy " << legacy_sum / legacy_hits << ", new " << sum / hits << "\n";
+
+    SharedEdges(mesh);
+}
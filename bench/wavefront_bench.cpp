@@ -0,0 +1,72 @@
+#include "bench.h"
+
+#include "ptmath/vec3.h"
+#include "graphics/image.h"
+#include "util/parallel.h"
+#include "scene/object/object.h"
+#include "scene/camera.h"
+#include "scene/wavefront.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+using namespace ptmath;
+using namespace scene;
+
+namespace
+{
+    void Compare(const char *name, void (*build)(HittableGroup &, Camera &), int threads)
+    {
+        HittableGroup world;
+        bench::BenchCamera cam;
+        cam.image_width_ = 200;
+        cam.image_height_ = 200;
+        cam.samples_per_pixel_ = 8;
+        cam.max_depth_ = 8;
+        build(world, cam);
+        CompiledScene scene(world);
+
+        // The same settings, which the scene function only set on cam.
+        WavefrontCamera wavefront;
+        static_cast<Camera &>(wavefront) = cam;
+
+        double samples = double(cam.image_width_) * cam.image_height_ * cam.samples_per_pixel_;
+        double path_seconds;
+        std::vector<color> path_pixels = cam.RenderPixels(scene, &path_seconds);
+
+        util::TaskPool pool(threads);
+        image output(wavefront.image_width_, wavefront.image_height_);
+        double wavefront_seconds = bench::TimeSeconds([&]()
+                                                      { wavefront.Render(scene, pool, output); });
+        std::vector<color> wavefront_pixels = output.toColors();
+
+        size_t differ = 0;
+        for (size_t i = 0; i < path_pixels.size(); i++)
+        {
+            const color &a = path_pixels[i], &b = wavefront_pixels[i];
+            differ += a.x() != b.x() || a.y() != b.y() || a.z() != b.z();
+        }
+
+        std::cout << "  " << name << "\n";
+        bench::Report("  path by path, 1 thread", path_seconds, samples, "samples");
+        std::string label = "  wavefront, " + std::to_string(threads) + (threads == 1 ? " thread" : " threads");
+        bench::Report(label.c_str(), wavefront_seconds, samples, "samples");
+        if (differ == 0)
+            std::cout << "    images identical\n";
+        else
+            std::cout << "    images DIFFER in " << differ << " pixels, RMSE "
+                      << bench::Rmse(path_pixels, wavefront_pixels) << "\n";
+    }
+}
+
+void bench::WavefrontBenchmark()
+{
+    // Both cameras draw the same random numbers for every path and do the same arithmetic on
+    // them, so they must render the same image whatever the number of threads.
+    bench::QuietLog quiet;
+    int threads = std::max(4u, std::thread::hardware_concurrency());
+    Compare("Cornell box", bench::CornellBox, threads);
+    Compare("sky spheres", bench::SkySpheres, threads);
+    Compare("Weekend", bench::Weekend, threads);
+}
@@ -0,0 +1,126 @@
+#include "bench.h"
+
+#include "ptmath/vec3.h"
+#include "ptmath/ray.h"
+#include "ptmath/simd.h"
+#include "ptmath/tri3.h"
+#include "util/rng.h"
+#include "scene/object/bvh.h"
+#include "scene/object/linear_bvh.h"
+#include "scene/object/wide_bvh.h"
+#include "scene/object/mesh.h"
+
+#include <vector>
+
+using namespace ptmath;
+using namespace scene;
+
+namespace
+{
+    // Rays from outside the bounding box towards points inside it, as in the mesh benchmark.
+    std::vector<ray> MakeRays(const Mesh &mesh, int count)
+    {
+        util::Rng rng(5, 0);
+        aabb box = mesh.bounding_box();
+        Point3 center = box.centroid();
+        double radius = (box.max() - box.min()).length();
+        std::vector<ray> rays;
+        for (int i = 0; i < count; i++)
+        {
+            Vec3 d(rng.NextDouble() * 2 - 1, rng.NextDouble() * 2 - 1, rng.NextDouble() * 2 - 1);
+            Point3 from = center + radius * unit_vector(d);
+            Point3 to(box.x.min + rng.NextDouble() * box.x.size(), box.y.min + rng.NextDouble() * box.y.size(),
+                      box.z.min + rng.NextDouble() * box.z.size());
+            rays.push_back(ray(from, to - from));
+        }
+        return rays;
+    }
+
+    // Closest hit through either tree, testing leaves exactly, and the nodes read to find it.
+    template <typename Tree>
+    double ClosestT(const Tree &tree, const Mesh &mesh, const ray &r, size_t &node_fetches)
+    {
+        TriangleRay tri_ray(r);
+        HitRecord rec;
+        rec.t = INFINITY;
+        tree.TraverseLeaves(
+            r, interval(0.001, INFINITY), rec,
+            [&](uint32_t first, uint32_t count, const ray &, interval ray_t, HitRecord &rec)
+            {
+                bool hit = false;
+                for (uint32_t i = first; i < first + count; i++)
+                {
+                    const Mesh::Triangle &tri = mesh.triangles()[i];
+                    Real t, b1, b2;
+                    if (IntersectTriangle(mesh.vertices()[tri.vertex[0]], mesh.vertices()[tri.vertex[1]],
+                                          mesh.vertices()[tri.vertex[2]], tri_ray, t, b1, b2) &&
+                        ray_t.surrounds(t))
+                    {
+                        rec.t = t;
+                        ray_t.max = t;
+                        hit = true;
+                    }
+                }
+                return hit;
+            },
+            &node_fetches);
+        return rec.t;
+    }
+
+    void Compare(const char *path)
+    {
+        ObjMesh binary(path);
+        ObjMesh wide(path, true, {BvhBuilder::kSah, nullptr, true});
+        const WideBvh &wide_bvh = wide.wide_bvh();
+
+        size_t binary_bytes = binary.bvh().nodes().size() * sizeof(LinearBvhNode);
+        std::cout << "  " << path << ": " << binary.triangle_count() << " triangles\n"
+                  << "    binary: " << binary.bvh().nodes().size() << " nodes, " << binary_bytes / 1024 << " KiB\n"
+                  << "    wide: " << wide_bvh.node_count() << " nodes and " << wide_bvh.leaf_count() << " leaves, "
+                  << wide_bvh.memory_usage() / 1024 << " KiB (" << 100.0 * wide_bvh.memory_usage() / binary_bytes
+                  << "%)\n";
+
+        const int kRays = 100000;
+        std::vector<ray> rays = MakeRays(binary, kRays);
+
+        size_t binary_fetches = 0, wide_fetches = 0;
+        int mismatches = 0;
+        for (const ray &r : rays)
+        {
+            if (ClosestT(binary.bvh(), binary, r, binary_fetches) != ClosestT(wide_bvh, wide, r, wide_fetches))
+                mismatches++;
+        }
+        std::cout << "    node fetches per ray: binary " << double(binary_fetches) / kRays << ", wide "
+                  << double(wide_fetches) / kRays << "; " << mismatches << " closest hits differ\n";
+
+        // Mesh::hit through each tree, with the node and leaf kernels of every instruction set.
+        for (simd::Isa isa : {simd::Isa::kScalar, simd::Isa::kSse, simd::Isa::kAvx2})
+        {
+            if (isa > simd::BestIsa())
+                continue;
+            simd::SetIsa(isa);
+            for (const Mesh *mesh : {static_cast<const Mesh *>(&binary), static_cast<const Mesh *>(&wide)})
+            {
+                int hits = 0;
+                double seconds = bench::TimeSeconds([&]()
+                                                    {
+                    for (const ray &r : rays)
+                    {
+                        HitRecord rec;
+                        hits += mesh->hit(r, interval(0.001, INFINITY), rec);
+                    } });
+                std::string name = std::string("  ") + simd::IsaName(isa) + (mesh == &binary ? ", binary" : ", wide");
+                bench::Report(name.c_str(), seconds, kRays, "rays");
+                std::cout << "      " << hits << " hits\n";
+            }
+        }
+        simd::SetIsa(simd::BestIsa());
+    }
+}
+
+void bench::WideBenchmark()
+{
+    bench::QuietLog quiet;
+    Compare("assets/skyline/model.obj");
+    Compare("assets/iss/InternationalSpaceStation.obj");
+}
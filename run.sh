@@ -1,3 +1,3 @@
 #/bin/bash
 
-make && ./bin/main > img.ppm &&  xdg-open img.ppm
+make && ./bin/main && xdg-open img.png
@@ -0,0 +1,297 @@
+#include "image.h"
+
+#include "./ptmath/simd.h"
+
+#include <cstring>
+#include <zlib.h>
+
+namespace
+{
+    bool EndsWith(const std::string &s, const char *suffix)
+    {
+        size_t n = strlen(suffix);
+        return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+    }
+
+    void AppendBigEndian(std::vector<unsigned char> &out, uint32_t x)
+    {
+        for (int shift = 24; shift >= 0; shift -= 8)
+            out.push_back(static_cast<unsigned char>(x >> shift));
+    }
+
+    int Paeth(int left, int up, int up_left)
+    {
+        int p = left + up - up_left;
+        int pa = abs(p - left), pb = abs(p - up), pc = abs(p - up_left);
+        if (pa <= pb && pa <= pc)
+            return left;
+        return pb <= pc ? up : up_left;
+    }
+}
+
+ImageFormat FormatForPath(const std::string &path)
+{
+    if (EndsWith(path, ".pfm"))
+        return ImageFormat::kPfm;
+    if (EndsWith(path, ".png"))
+        return ImageFormat::kPng;
+    return ImageFormat::kPpm;
+}
+
+std::vector<color> image::toColors() const
+{
+    std::vector<color> colors(size());
+    for (size_t i = 0; i < colors.size(); i++)
+        colors[i] = pixel(i);
+    return colors;
+}
+
+std::vector<float> image::toFloats() const
+{
+    if (f == PixelFormat::kFloat)
+        return floats;
+    std::vector<float> values(size() * 3);
+    for (size_t i = 0; i < values.size(); i++)
+        values[i] = f == PixelFormat::kDouble ? float(doubles[i]) : util::HalfToFloat(halves[i]);
+    return values;
+}
+
+std::vector<unsigned char> image::toBytes() const
+{
+    std::vector<float> values = toFloats();
+    std::vector<unsigned char> bytes(values.size());
+    ptmath::simd::Quantize(values.data(), bytes.data(), values.size());
+    return bytes;
+}
+
+void image::writePPM(std::ostream &out) const
+{
+    std::string text = "P3\n" + std::to_string(w) + ' ' + std::to_string(h) + "\n255\n";
+    std::vector<unsigned char> bytes = toBytes();
+    for (size_t i = 0; i < bytes.size(); i++)
+    {
+        text += std::to_string(bytes[i]);
+        text += i % 3 == 2 ? '\n' : ' ';
+    }
+    out << text;
+}
+
+bool image::writeFile(const std::string &path, ImageFormat format) const
+{
+    ImageWriter writer(path, w, h, format);
+    return writer.write(*this) && writer.finish();
+}
+
+// Writer
+
+// PNG rows are Paeth-filtered and deflated as they arrive; the compressed stream goes out as one
+// IDAT chunk whenever the output buffer fills.
+struct ImageWriter::PngStream
+{
+    z_stream zs = {};
+    std::vector<unsigned char> previous_row; // Unfiltered, for the filter of the next row
+    std::vector<unsigned char> filtered;
+    std::vector<unsigned char> out = std::vector<unsigned char>(1 << 18);
+};
+
+ImageWriter::ImageWriter(const std::string &path, int width, int height, ImageFormat format)
+    : path_(path), width_(width), height_(height), format_(format)
+{
+    file_ = fopen(path.c_str(), "wb");
+    if (!file_)
+    {
+        fail("Could not create");
+        return;
+    }
+
+    std::string header;
+    switch (format_)
+    {
+    case ImageFormat::kPpm:
+        header = "P6\n" + std::to_string(width) + ' ' + std::to_string(height) + "\n255\n";
+        break;
+    case ImageFormat::kPfm:
+    {
+        // A negative scale marks little-endian floats.
+        const uint16_t probe = 1;
+        bool little_endian = *reinterpret_cast<const unsigned char *>(&probe) == 1;
+        header = "PF\n" + std::to_string(width) + ' ' + std::to_string(height) + (little_endian ? "\n-1.0\n" : "\n1.0\n");
+        break;
+    }
+    case ImageFormat::kPng:
+    {
+        png_.reset(new PngStream());
+        png_->previous_row.assign(size_t(width) * 3, 0);
+
+        // The fastest level: noisy renders barely compress better at higher ones, and take
+        // three times longer.
+        if (deflateInit(&png_->zs, Z_BEST_SPEED) != Z_OK)
+        {
+            png_.reset();
+            fail("Could not compress");
+            return;
+        }
+
+        static const unsigned char kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        std::vector<unsigned char> ihdr;
+        AppendBigEndian(ihdr, uint32_t(width));
+        AppendBigEndian(ihdr, uint32_t(height));
+        ihdr.insert(ihdr.end(), {8, 2, 0, 0, 0}); // 8-bit RGB, deflate, filtered rows, no interlacing
+
+        header.assign(reinterpret_cast<const char *>(kSignature), 8);
+        std::vector<unsigned char> chunk;
+        AppendBigEndian(chunk, uint32_t(ihdr.size()));
+        chunk.insert(chunk.end(), {'I', 'H', 'D', 'R'});
+        chunk.insert(chunk.end(), ihdr.begin(), ihdr.end());
+        AppendBigEndian(chunk, uint32_t(crc32(0, chunk.data() + 4, uInt(chunk.size() - 4))));
+        header.append(chunk.begin(), chunk.end());
+        break;
+    }
+    }
+
+    header_size_ = header.size();
+    if (fwrite(header.data(), 1, header.size(), file_) != header.size())
+        fail("Could not write");
+
+    // PFM rows go from the bottom up, so they are placed by seeking; extending the file to its
+    // full size first makes every row's place exist.
+    if (format_ == ImageFormat::kPfm && ok_)
+    {
+        long end = long(header_size_ + size_t(width) * height * 3 * sizeof(float));
+        if (end > long(header_size_) && (fseek(file_, end - 1, SEEK_SET) != 0 || fputc(0, file_) == EOF))
+            fail("Could not write");
+    }
+}
+
+ImageWriter::~ImageWriter()
+{
+    if (png_)
+        deflateEnd(&png_->zs);
+    if (file_)
+        fclose(file_);
+}
+
+bool ImageWriter::fail(const char *what)
+{
+    if (ok_)
+        std::clog << what << " image " << path_ << "\n";
+    ok_ = false;
+    return false;
+}
+
+bool ImageWriter::write(const image &band)
+{
+    if (!ok_)
+        return false;
+    if (band.width() != width_ || band.firstRow() != next_row_ || next_row_ + band.height() > height_)
+        return fail("Rows out of order for");
+
+    switch (format_)
+    {
+    case ImageFormat::kPpm:
+    {
+        std::vector<unsigned char> bytes = band.toBytes();
+        if (fwrite(bytes.data(), 1, bytes.size(), file_) != bytes.size())
+            return fail("Could not write");
+        break;
+    }
+    case ImageFormat::kPfm:
+    {
+        std::vector<float> values = band.toFloats();
+        size_t row_values = size_t(width_) * 3;
+        for (int row = 0; row < band.height(); row++)
+        {
+            long offset = long(header_size_ + (height_ - 1 - (next_row_ + row)) * row_values * sizeof(float));
+            if (fseek(file_, offset, SEEK_SET) != 0 ||
+                fwrite(values.data() + row * row_values, sizeof(float), row_values, file_) != row_values)
+                return fail("Could not write");
+        }
+        break;
+    }
+    case ImageFormat::kPng:
+        if (!writePngRows(band.toBytes(), band.height()))
+            return false;
+        break;
+    }
+
+    next_row_ += band.height();
+    return true;
+}
+
+bool ImageWriter::writePngRows(const std::vector<unsigned char> &rgb, int rows)
+{
+    size_t stride = size_t(width_) * 3;
+    png_->filtered.resize((stride + 1) * rows);
+    for (int y = 0; y < rows; y++)
+    {
+        const unsigned char *row = rgb.data() + y * stride;
+        const unsigned char *prev = y > 0 ? row - stride : png_->previous_row.data();
+        unsigned char *dst = png_->filtered.data() + y * (stride + 1);
+        *dst++ = 4;
+        for (size_t i = 0; i < stride; i++)
+        {
+            int left = i >= 3 ? row[i - 3] : 0;
+            int up_left = i >= 3 ? prev[i - 3] : 0;
+            dst[i] = static_cast<unsigned char>(row[i] - Paeth(left, prev[i], up_left));
+        }
+    }
+    if (rows > 0)
+        memcpy(png_->previous_row.data(), rgb.data() + (rows - 1) * stride, stride);
+
+    png_->zs.next_in = png_->filtered.data();
+    png_->zs.avail_in = uInt(png_->filtered.size());
+    return flushPng(Z_NO_FLUSH);
+}
+
+bool ImageWriter::flushPng(int flush)
+{
+    z_stream &zs = png_->zs;
+    std::vector<unsigned char> &out = png_->out;
+    int status;
+    do
+    {
+        zs.next_out = out.data() + 8; // Room for the chunk's length and type
+        zs.avail_out = uInt(out.size() - 12);
+        status = deflate(&zs, flush);
+        if (status == Z_STREAM_ERROR)
+            return fail("Could not compress");
+
+        size_t size = out.size() - 12 - zs.avail_out;
+        if (size == 0)
+            continue;
+
+        unsigned char *chunk = out.data();
+        for (int k = 0; k < 4; k++)
+            chunk[k] = static_cast<unsigned char>(size >> (24 - 8 * k));
+        memcpy(chunk + 4, "IDAT", 4);
+        uint32_t crc = uint32_t(crc32(0, chunk + 4, uInt(size + 4)));
+        for (int k = 0; k < 4; k++)
+            chunk[8 + size + k] = static_cast<unsigned char>(crc >> (24 - 8 * k));
+        if (fwrite(chunk, 1, size + 12, file_) != size + 12)
+            return fail("Could not write");
+    } while (zs.avail_out == 0 || (flush == Z_FINISH && status != Z_STREAM_END));
+    return true;
+}
+
+bool ImageWriter::finish()
+{
+    if (!ok_)
+        return false;
+    if (next_row_ != height_)
+        return fail("Rows missing from");
+
+    if (format_ == ImageFormat::kPng)
+    {
+        if (!flushPng(Z_FINISH))
+            return false;
+        static const unsigned char kEnd[12] = {0, 0, 0, 0, 'I', 'E', 'N', 'D', 0xae, 0x42, 0x60, 0x82};
+        if (fwrite(kEnd, 1, sizeof(kEnd), file_) != sizeof(kEnd))
+            return fail("Could not write");
+    }
+
+    int status = fclose(file_);
+    file_ = nullptr;
+    if (status != 0)
+        return fail("Could not write");
+    return true;
+}
@@ -1,41 +1,161 @@
 #ifndef IMAGE_H
 #define IMAGE_H
 
+#include <cstdint>
+#include <cstdio>
 #include <thread>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "color.h"
+#include "./util/half.h"
 
+enum class ImageFormat
+{
+    kPpm, // Binary P6
+    kPfm, // Linear 32-bit float, for HDR compositing
+    kPng
+};
+
+// The format that the extension of path names: .pfm, .png, or binary PPM for anything else.
+ImageFormat FormatForPath(const std::string &path);
+
+// How pixels are held in memory: 24, 12 or 6 bytes each.
+enum class PixelFormat
+{
+    kDouble,
+    kFloat,
+    kHalf
+};
+
+/**
+ * Pixels of a frame, or of a band of its rows starting at firstRow(), so that a frame can be
+ * rendered and written out one band at a time. Pixels are addressed either by their (x, y) in
+ * the frame or by their index in the band.
+*/
 class image
 {
 public:
-    image(int width, int height) : w(width), h(height)
+    image(int width, int height, PixelFormat format = PixelFormat::kDouble, int first_row = 0)
+        : w(width), h(height), first(first_row), f(format)
     {
-        b = new color[width * height];
+        size_t values = size_t(width) * height * 3;
+        if (format == PixelFormat::kDouble)
+            doubles.resize(values);
+        else if (format == PixelFormat::kFloat)
+            floats.resize(values);
+        else
+            halves.resize(values);
     }
 
     int width() const { return w; }
     int height() const { return h; }
-    color *buffer() const { return b; }
+    int firstRow() const { return first; }
+    PixelFormat format() const { return f; }
+    size_t size() const { return size_t(w) * h; }
 
-    void flushToPPM()
+    color pixel(size_t i) const
     {
-        std::cout << "P3\n"
-                  << w << ' ' << h << "\n255\n";
+        switch (f)
+        {
+        case PixelFormat::kDouble:
+            return color(doubles[3 * i], doubles[3 * i + 1], doubles[3 * i + 2]);
+        case PixelFormat::kFloat:
+            return color(floats[3 * i], floats[3 * i + 1], floats[3 * i + 2]);
+        default:
+            return color(util::HalfToFloat(halves[3 * i]), util::HalfToFloat(halves[3 * i + 1]),
+                         util::HalfToFloat(halves[3 * i + 2]));
+        }
+    }
 
-        for (int i = 0; i < w * h; i++)
+    void setPixel(size_t i, const color &c)
+    {
+        for (int k = 0; k < 3; k++)
         {
-            color pixel_color = sqrt(b[i]);
-            std::cout << static_cast<int>(255.999 * pixel_color.x()) << ' '
-                      << static_cast<int>(255.999 * pixel_color.y()) << ' '
-                      << static_cast<int>(255.999 * pixel_color.z()) << '\n';
+            if (f == PixelFormat::kDouble)
+                doubles[3 * i + k] = c[k];
+            else if (f == PixelFormat::kFloat)
+                floats[3 * i + k] = float(c[k]);
+            else
+                halves[3 * i + k] = util::FloatToHalf(float(c[k]));
         }
     }
 
+    color pixel(int x, int y) const { return pixel(size_t(y - first) * w + x); }
+    void setPixel(int x, int y, const color &c) { setPixel(size_t(y - first) * w + x, c); }
+
+    void flushToPPM() const
+    {
+        writePPM(std::cout);
+    }
+
+    // Writes the image as a text PPM, with the 8-bit values of toBytes.
+    void writePPM(std::ostream &out) const;
+
+    // Writes the image to path. PPM and PNG hold 8-bit gamma-encoded values, PFM the linear
+    // values. Returns false, after logging why, if it fails.
+    bool writeFile(const std::string &path) const { return writeFile(path, FormatForPath(path)); }
+    bool writeFile(const std::string &path, ImageFormat format) const;
+
+    // The pixels in row order.
+    std::vector<color> toColors() const;
+
+    // The pixels as interleaved RGB floats, top row first.
+    std::vector<float> toFloats() const;
+
+    // The pixels as interleaved 8-bit RGB display values, top row first.
+    std::vector<unsigned char> toBytes() const;
+
 private:
     int w;
     int h;
-    color *b;
+    int first;
+    PixelFormat f;
+    std::vector<double> doubles;
+    std::vector<float> floats;
+    std::vector<uint16_t> halves;
+};
+
+/**
+ * Writes an image file one band of rows at a time, top to bottom, in buffered bulk writes, so
+ * that the frame never has to be in memory whole.
+*/
+class ImageWriter
+{
+public:
+    // Creates path; check ok() before writing.
+    ImageWriter(const std::string &path, int width, int height, ImageFormat format);
+    ~ImageWriter();
+
+    ImageWriter(const ImageWriter &) = delete;
+    ImageWriter &operator=(const ImageWriter &) = delete;
+
+    bool ok() const { return ok_; }
+
+    // Appends the rows of band, which must start where the previous band ended.
+    bool write(const image &band);
+
+    // Completes the file once every row was written. Returns false, after logging why, if
+    // anything failed.
+    bool finish();
+
+private:
+    struct PngStream;
+
+    std::string path_;
+    int width_, height_;
+    ImageFormat format_;
+    FILE *file_ = nullptr;
+    size_t header_size_ = 0;
+    int next_row_ = 0;
+    bool ok_ = true;
+    std::unique_ptr<PngStream> png_;
+
+    bool fail(const char *what);
+    bool writePngRows(const std::vector<unsigned char> &rgb, int rows);
+    bool flushPng(int flush);
 };
 
-#endif
\ No newline at end of file
+#endif
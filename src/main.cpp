@@ -8,9 +8,13 @@
 #include "scene/object/tri.h"
 #include "scene/object/quad.h"
 #include "scene/object/parallelepiped.h"
+#include "scene/object/linear_bvh.h"
+#include "scene/object/mesh.h"
 #include "scene/material.h"
 
+#include "scene/compiled_scene.h"
 #include "scene/camera.h"
+#include "util/parallel.h"
 
 #include <iostream>
 #include <chrono>
@@ -133,23 +137,54 @@ void CornellBox(HittableGroup &world, Camera &cam) {
     cam.vup_      = Vec3(0,1,0);
 }
 
+// Mesh scenes build their BVHs on pool and pick the builder that suits them.
+void Skyline(HittableGroup &world, Camera &cam, util::TaskPool &pool)
+{
+    world.add(make_shared<ObjMesh>("assets/skyline/model.obj", true, BvhBuildOptions{BvhBuilder::kSah, &pool}));
+
+    cam.vfov_ = 40;
+    cam.look_from_ = Point3(-2, 4, 6);
+    cam.lookat_ = Point3(-0.5, 0.5, 1.3);
+    cam.vup_ = Vec3(0, 1, 0);
+}
+
+void SpaceStation(HittableGroup &world, Camera &cam, util::TaskPool &pool)
+{
+    // Quick to build for previews, at some cost in trace speed.
+    world.add(make_shared<ObjMesh>("assets/iss/InternationalSpaceStation.obj", true,
+                                   BvhBuildOptions{BvhBuilder::kLbvh, &pool}));
+
+    cam.vfov_ = 50;
+    cam.look_from_ = Point3(40, 30, 40);
+    cam.lookat_ = Point3(0, 4, 0);
+    cam.vup_ = Vec3(0, 1, 0);
+}
+
 int main()
 {
     int num_cores = 4;
 
+    // One pool builds the BVHs and then renders.
+    util::TaskPool pool(num_cores);
+
     HittableGroup world;
 
-    BatchedMultiThreadCamera cam;
+    MultiThreadCamera cam;
 
     cam.image_height_ = 1080 / 4;
     cam.image_width_ = 1920 / 4;
     cam.samples_per_pixel_ = 10;
     cam.max_depth_ = 5;
+    cam.output_path_ = "img.png";
 
     CornellBox(world, cam);
 
+    // Freeze the scene into the read-only form that the render threads share.
+    CompiledScene scene(world, Dispatch::kClosedSet, BvhBuildOptions{BvhBuilder::kSah, &pool});
+    scene.PrintStats(std::clog);
+
     auto start = std::chrono::high_resolution_clock::now();
-    cam.Render(world, num_cores);
+    cam.Render(scene, pool);
     auto stop = std::chrono::high_resolution_clock::now();
     auto ns = std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count();
     std::clog << "Total time: " << (ns / 1e6) << "\n";
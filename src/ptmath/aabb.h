@@ -0,0 +1,112 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include <utility>
+
+#include "vec3.h"
+#include "ray.h"
+#include "interval.h"
+
+namespace ptmath
+{
+
+    class aabb
+    {
+    public:
+        interval x, y, z;
+
+        aabb() {} // Default box is empty, since intervals are empty by default
+
+        aabb(const interval &ix, const interval &iy, const interval &iz) : x(ix), y(iy), z(iz) {}
+
+        aabb(const Point3 &a, const Point3 &b)
+        {
+            // Treat the two points a and b as extrema for the bounding box, so we don't require a
+            // particular minimum/maximum coordinate order.
+            x = interval(fmin(a[0], b[0]), fmax(a[0], b[0]));
+            y = interval(fmin(a[1], b[1]), fmax(a[1], b[1]));
+            z = interval(fmin(a[2], b[2]), fmax(a[2], b[2]));
+        }
+
+        aabb(const aabb &box0, const aabb &box1)
+            : x(box0.x, box1.x), y(box0.y, box1.y), z(box0.z, box1.z) {}
+
+        const interval &axis(int n) const
+        {
+            if (n == 1)
+                return y;
+            if (n == 2)
+                return z;
+            return x;
+        }
+
+        bool empty() const
+        {
+            return x.min > x.max || y.min > y.max || z.min > z.max;
+        }
+
+        Point3 min() const { return Point3(x.min, y.min, z.min); }
+        Point3 max() const { return Point3(x.max, y.max, z.max); }
+
+        Point3 centroid() const
+        {
+            return Point3(0.5 * (x.min + x.max), 0.5 * (y.min + y.max), 0.5 * (z.min + z.max));
+        }
+
+        double surface_area() const
+        {
+            if (empty())
+                return 0;
+            auto dx = x.size(), dy = y.size(), dz = z.size();
+            return 2 * (dx * dy + dy * dz + dz * dx);
+        }
+
+        int longest_axis() const
+        {
+            if (x.size() > y.size())
+                return x.size() > z.size() ? 0 : 2;
+            return y.size() > z.size() ? 1 : 2;
+        }
+
+        aabb pad() const
+        {
+            // Return an AABB that has no side narrower than some delta, padding if necessary.
+            // Axis-aligned quads and triangles would otherwise produce zero-width slabs.
+            double delta = 0.0001;
+            interval new_x = (x.size() >= delta) ? x : x.expand(delta);
+            interval new_y = (y.size() >= delta) ? y : y.expand(delta);
+            interval new_z = (z.size() >= delta) ? z : z.expand(delta);
+
+            return aabb(new_x, new_y, new_z);
+        }
+
+        bool hit(const ray &r, interval ray_t) const
+        {
+            Point3 origin = r.origin();
+            Vec3 direction = r.direction();
+            for (int a = 0; a < 3; a++)
+            {
+                auto invD = 1 / direction[a];
+                auto orig = origin[a];
+
+                auto t0 = (axis(a).min - orig) * invD;
+                auto t1 = (axis(a).max - orig) * invD;
+
+                if (invD < 0)
+                    std::swap(t0, t1);
+
+                if (t0 > ray_t.min)
+                    ray_t.min = t0;
+                if (t1 < ray_t.max)
+                    ray_t.max = t1;
+
+                if (ray_t.max <= ray_t.min)
+                    return false;
+            }
+            return true;
+        }
+    };
+
+}
+
+#endif
@@ -16,7 +16,7 @@ namespace ptmath
         Point3 origin() const { return orig; }
         Vec3 direction() const { return dir; }
 
-        Point3 at(double t) const
+        Point3 at(Real t) const
         {
             return orig + t * dir;
         }
@@ -0,0 +1,229 @@
+#include "simd.h"
+
+#include <cmath>
+
+using namespace ptmath;
+using namespace ptmath::simd;
+
+// Scalar kernels: the same code with one float per lane vector. Masks are 0 or 1.
+
+namespace ptmath::simd::scalar
+{
+
+    struct Lanes
+    {
+        static const int kWidth = 1;
+        float v;
+    };
+
+    inline Lanes operator+(Lanes a, Lanes b) { return {a.v + b.v}; }
+    inline Lanes operator-(Lanes a, Lanes b) { return {a.v - b.v}; }
+    inline Lanes operator*(Lanes a, Lanes b) { return {a.v * b.v}; }
+    inline Lanes operator/(Lanes a, Lanes b) { return {a.v / b.v}; }
+
+    template <typename V> V Load(const float *p);
+    template <> inline Lanes Load<Lanes>(const float *p) { return {*p}; }
+    template <typename V> V LoadBytes(const uint8_t *p);
+    template <> inline Lanes LoadBytes<Lanes>(const uint8_t *p) { return {float(*p)}; }
+    template <typename V> V Set1(float x);
+    template <> inline Lanes Set1<Lanes>(float x) { return {x}; }
+    template <typename V> V Iota();
+    template <> inline Lanes Iota<Lanes>() { return {0}; }
+    inline void Store(Lanes a, float *p) { *p = a.v; }
+    inline int MoveMask(Lanes a) { return a.v != 0; }
+
+    inline Lanes Sqrt(Lanes a) { return {std::sqrt(a.v)}; }
+    inline Lanes Min(Lanes a, Lanes b) { return {a.v < b.v ? a.v : b.v}; }
+    inline Lanes Max(Lanes a, Lanes b) { return {a.v > b.v ? a.v : b.v}; }
+
+    inline Lanes Lt(Lanes a, Lanes b) { return {float(a.v < b.v)}; }
+    inline Lanes Le(Lanes a, Lanes b) { return {float(a.v <= b.v)}; }
+    inline Lanes Gt(Lanes a, Lanes b) { return {float(a.v > b.v)}; }
+    inline Lanes Ge(Lanes a, Lanes b) { return {float(a.v >= b.v)}; }
+    inline Lanes Ne(Lanes a, Lanes b) { return {float(a.v != b.v)}; }
+
+    inline Lanes And(Lanes a, Lanes b) { return {float(a.v != 0 && b.v != 0)}; }
+    inline Lanes Or(Lanes a, Lanes b) { return {float(a.v != 0 || b.v != 0)}; }
+    inline Lanes AndNot(Lanes a, Lanes b) { return {float(a.v == 0 && b.v != 0)}; }
+    inline Lanes Select(Lanes mask, Lanes a, Lanes b) { return mask.v != 0 ? a : b; }
+
+#include "simd_kernels.inl"
+
+}
+
+KernelTable ptmath::simd::ScalarKernels()
+{
+    return {scalar::ClosestSphere, scalar::ClosestQuad, scalar::ClosestTriangle, scalar::Quantize,
+            scalar::IntersectWide};
+}
+
+// Dispatch
+
+namespace
+{
+    struct Dispatch
+    {
+        Isa isa;
+        KernelTable kernels;
+    };
+
+    KernelTable KernelsFor(Isa isa)
+    {
+        switch (isa)
+        {
+        case Isa::kAvx2:
+            return Avx2Kernels();
+        case Isa::kSse:
+            return SseKernels();
+        default:
+            return ScalarKernels();
+        }
+    }
+
+    Dispatch &CurrentDispatch()
+    {
+        static Dispatch dispatch = {BestIsa(), KernelsFor(BestIsa())};
+        return dispatch;
+    }
+}
+
+Isa ptmath::simd::BestIsa()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2"))
+        return Isa::kAvx2;
+    if (__builtin_cpu_supports("sse2"))
+        return Isa::kSse;
+#endif
+    return Isa::kScalar;
+}
+
+Isa ptmath::simd::ActiveIsa()
+{
+    return CurrentDispatch().isa;
+}
+
+void ptmath::simd::SetIsa(Isa isa)
+{
+    if (isa > BestIsa())
+        isa = BestIsa();
+    CurrentDispatch() = {isa, KernelsFor(isa)};
+}
+
+const char *ptmath::simd::IsaName(Isa isa)
+{
+    switch (isa)
+    {
+    case Isa::kAvx2:
+        return "avx2";
+    case Isa::kSse:
+        return "sse";
+    default:
+        return "scalar";
+    }
+}
+
+const KernelTable &ptmath::simd::ActiveKernels()
+{
+    return CurrentDispatch().kernels;
+}
+
+RayData ptmath::simd::MakeRayData(const ray &r, const TriangleRay &tri_ray)
+{
+    Point3 o = r.origin();
+    Vec3 d = r.direction();
+    return {float(o[0]), float(o[1]), float(o[2]),
+            float(d[0]), float(d[1]), float(d[2]),
+            tri_ray.kx, tri_ray.ky, tri_ray.kz,
+            tri_ray.sx, tri_ray.sy, tri_ray.sz};
+}
+
+// Structure-of-arrays storage
+
+namespace
+{
+    template <size_t N>
+    void Allocate(std::vector<float> (&data)[N], size_t size)
+    {
+        for (auto &array : data)
+            array.assign(size + kMaxWidth, NAN);
+    }
+}
+
+SphereSoA::SphereSoA(size_t size) : size_(size)
+{
+    Allocate(data_, size);
+}
+
+void SphereSoA::Set(size_t i, const Point3 &center, double radius)
+{
+    data_[0][i] = float(center[0]);
+    data_[1][i] = float(center[1]);
+    data_[2][i] = float(center[2]);
+    data_[3][i] = float(radius);
+}
+
+SphereArrays SphereSoA::arrays() const
+{
+    return {data_[0].data(), data_[1].data(), data_[2].data(), data_[3].data()};
+}
+
+QuadSoA::QuadSoA(size_t size) : size_(size)
+{
+    Allocate(data_, size);
+}
+
+void QuadSoA::Set(size_t i, const Point3 &q, const Vec3 &u, const Vec3 &v)
+{
+    Vec3 n = cross(u, v);
+    Vec3 vectors[5] = {q, u, v, unit_vector(n), n / dot(n, n)};
+    for (int k = 0; k < 5; k++)
+        for (int a = 0; a < 3; a++)
+            data_[3 * k + a][i] = float(vectors[k][a]);
+}
+
+QuadArrays QuadSoA::arrays() const
+{
+    QuadArrays arrays;
+    const float **fields[15] = {&arrays.qx, &arrays.qy, &arrays.qz, &arrays.ux, &arrays.uy,
+                                &arrays.uz, &arrays.vx, &arrays.vy, &arrays.vz, &arrays.nx,
+                                &arrays.ny, &arrays.nz, &arrays.wx, &arrays.wy, &arrays.wz};
+    for (int k = 0; k < 15; k++)
+        *fields[k] = data_[k].data();
+    return arrays;
+}
+
+TriangleSoA::TriangleSoA(size_t size) : size_(size), data_(FloatCount(size), NAN)
+{
+}
+
+void TriangleSoA::Adopt(const float *data, size_t size)
+{
+    size_ = size;
+    data_.clear();
+    data_.shrink_to_fit();
+    external_ = data;
+}
+
+void TriangleSoA::Set(size_t i, const Point3 &a, const Point3 &b, const Point3 &c)
+{
+    const Point3 *vertices[3] = {&a, &b, &c};
+    size_t stride = size_ + kMaxWidth;
+    for (int k = 0; k < 3; k++)
+        for (int axis = 0; axis < 3; axis++)
+            data_[(3 * k + axis) * stride + i] = float((*vertices[k])[axis]);
+}
+
+TriangleArrays TriangleSoA::arrays() const
+{
+    TriangleArrays arrays;
+    const float *block = data();
+    size_t stride = size_ + kMaxWidth;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        arrays.a[axis] = block + axis * stride;
+        arrays.b[axis] = block + (3 + axis) * stride;
+        arrays.c[axis] = block + (6 + axis) * stride;
+    }
+    return arrays;
+}
@@ -0,0 +1,142 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cstddef>
+#include <vector>
+
+#include "vec3.h"
+#include "ray.h"
+#include "tri3.h"
+#include "simd_kernels.h"
+
+namespace ptmath::simd
+{
+
+    enum class Isa
+    {
+        kScalar,
+        kSse,
+        kAvx2
+    };
+
+    // The widest instruction set supported by this CPU.
+    Isa BestIsa();
+
+    // The instruction set whose kernels the Closest* functions call. Defaults to BestIsa().
+    Isa ActiveIsa();
+
+    // Switches kernels, e.g. to compare them in a benchmark. Isas the CPU lacks fall back to
+    // the best supported one. Not thread safe: call it before rendering starts.
+    void SetIsa(Isa isa);
+
+    const char *IsaName(Isa isa);
+
+    const KernelTable &ActiveKernels();
+
+    RayData MakeRayData(const ray &r, const TriangleRay &tri_ray);
+
+    inline RayData MakeRayData(const ray &r)
+    {
+        return MakeRayData(r, TriangleRay(r));
+    }
+
+    /**
+     * Structure-of-arrays storage for the kernels: one float array per coordinate, with
+     * kMaxWidth trailing NaN entries so the last vector load of a range stays in bounds
+     * and can never report a hit.
+    */
+    class SphereSoA
+    {
+    public:
+        SphereSoA(size_t size = 0);
+
+        void Set(size_t i, const Point3 &center, double radius);
+
+        size_t size() const { return size_; }
+        SphereArrays arrays() const;
+        size_t memory_usage() const { return sizeof(float) * 4 * data_[0].size(); }
+
+    private:
+        size_t size_;
+        std::vector<float> data_[4];
+    };
+
+    class QuadSoA
+    {
+    public:
+        QuadSoA(size_t size = 0);
+
+        void Set(size_t i, const Point3 &q, const Vec3 &u, const Vec3 &v);
+
+        size_t size() const { return size_; }
+        QuadArrays arrays() const;
+        size_t memory_usage() const { return sizeof(float) * 15 * data_[0].size(); }
+
+    private:
+        size_t size_;
+        std::vector<float> data_[15];
+    };
+
+    /**
+     * Unlike the other two, keeps its nine arrays back to back in one block, so that the block
+     * can be written to a file and later used in place with Adopt.
+    */
+    class TriangleSoA
+    {
+    public:
+        TriangleSoA(size_t size = 0);
+
+        // Floats in the block of a TriangleSoA of the given size.
+        static size_t FloatCount(size_t size) { return 9 * (size + kMaxWidth); }
+
+        // Uses a block laid out as data() is, owned by someone else, e.g. a mapped cache file.
+        void Adopt(const float *data, size_t size);
+
+        void Set(size_t i, const Point3 &a, const Point3 &b, const Point3 &c);
+
+        size_t size() const { return size_; }
+        size_t memory_usage() const { return sizeof(float) * FloatCount(size_); }
+        const float *data() const { return external_ ? external_ : data_.data(); }
+        TriangleArrays arrays() const;
+
+    private:
+        size_t size_;
+        std::vector<float> data_;
+        const float *external_ = nullptr;
+    };
+
+    // Closest hit among spheres [first, first + count): see KernelTable.
+    inline int ClosestSphere(const SphereArrays &s, size_t first, size_t count, const RayData &r, float t_min,
+                             float &t_max)
+    {
+        return ActiveKernels().sphere(s, first, count, r, t_min, &t_max);
+    }
+
+    inline int ClosestQuad(const QuadArrays &s, size_t first, size_t count, const RayData &r, float t_min,
+                           float &t_max)
+    {
+        return ActiveKernels().quad(s, first, count, r, t_min, &t_max);
+    }
+
+    inline int ClosestTriangle(const TriangleArrays &s, size_t first, size_t count, const RayData &r, float t_min,
+                               float &t_max)
+    {
+        return ActiveKernels().triangle(s, first, count, r, t_min, &t_max);
+    }
+
+    // Child boxes of a wide BVH node that the ray crosses: see KernelTable.
+    inline int IntersectWide(const QuantizedBoxes &boxes, const WideRay &r, float t_min, float t_max,
+                             float *t_near)
+    {
+        return ActiveKernels().wide_node(boxes, r, t_min, t_max, t_near);
+    }
+
+    // 8-bit display values of count linear values: see KernelTable.
+    inline void Quantize(const float *linear, unsigned char *out, size_t count)
+    {
+        ActiveKernels().quantize(linear, out, count);
+    }
+
+}
+
+#endif
@@ -0,0 +1,60 @@
+#include "simd_kernels.h"
+
+#include <immintrin.h>
+
+// AVX2 kernels, eight floats per lane vector. This unit is compiled with -mavx2 (see the
+// makefile), so it must only run after simd.cpp has checked CPUID.
+
+namespace ptmath::simd::avx2
+{
+
+    struct Lanes
+    {
+        static const int kWidth = 8;
+        __m256 v;
+    };
+
+    inline Lanes operator+(Lanes a, Lanes b) { return {_mm256_add_ps(a.v, b.v)}; }
+    inline Lanes operator-(Lanes a, Lanes b) { return {_mm256_sub_ps(a.v, b.v)}; }
+    inline Lanes operator*(Lanes a, Lanes b) { return {_mm256_mul_ps(a.v, b.v)}; }
+    inline Lanes operator/(Lanes a, Lanes b) { return {_mm256_div_ps(a.v, b.v)}; }
+
+    template <typename V> V Load(const float *p);
+    template <> inline Lanes Load<Lanes>(const float *p) { return {_mm256_loadu_ps(p)}; }
+    template <typename V> V LoadBytes(const uint8_t *p);
+    template <> inline Lanes LoadBytes<Lanes>(const uint8_t *p)
+    {
+        __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p));
+        return {_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes))};
+    }
+    template <typename V> V Set1(float x);
+    template <> inline Lanes Set1<Lanes>(float x) { return {_mm256_set1_ps(x)}; }
+    template <typename V> V Iota();
+    template <> inline Lanes Iota<Lanes>() { return {_mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)}; }
+    inline void Store(Lanes a, float *p) { _mm256_storeu_ps(p, a.v); }
+    inline int MoveMask(Lanes a) { return _mm256_movemask_ps(a.v); }
+
+    inline Lanes Sqrt(Lanes a) { return {_mm256_sqrt_ps(a.v)}; }
+    inline Lanes Min(Lanes a, Lanes b) { return {_mm256_min_ps(a.v, b.v)}; }
+    inline Lanes Max(Lanes a, Lanes b) { return {_mm256_max_ps(a.v, b.v)}; }
+
+    inline Lanes Lt(Lanes a, Lanes b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+    inline Lanes Le(Lanes a, Lanes b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)}; }
+    inline Lanes Gt(Lanes a, Lanes b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)}; }
+    inline Lanes Ge(Lanes a, Lanes b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)}; }
+    inline Lanes Ne(Lanes a, Lanes b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_NEQ_UQ)}; }
+
+    inline Lanes And(Lanes a, Lanes b) { return {_mm256_and_ps(a.v, b.v)}; }
+    inline Lanes Or(Lanes a, Lanes b) { return {_mm256_or_ps(a.v, b.v)}; }
+    inline Lanes AndNot(Lanes a, Lanes b) { return {_mm256_andnot_ps(a.v, b.v)}; } // ~a & b
+    inline Lanes Select(Lanes mask, Lanes a, Lanes b) { return {_mm256_blendv_ps(b.v, a.v, mask.v)}; }
+
+#include "simd_kernels.inl"
+
+}
+
+ptmath::simd::KernelTable ptmath::simd::Avx2Kernels()
+{
+    return {avx2::ClosestSphere, avx2::ClosestQuad, avx2::ClosestTriangle, avx2::Quantize,
+            avx2::IntersectWide};
+}
@@ -0,0 +1,104 @@
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Plain data shared between the dispatcher in simd.cpp and the per-ISA kernel translation units.
+// Those units are compiled with different instruction set flags, so nothing here may define an
+// inline function: the linker could otherwise keep an AVX2 copy and call it on any machine.
+
+namespace ptmath::simd
+{
+
+    // A ray rounded to float, plus the shear setup of the watertight triangle test.
+    struct RayData
+    {
+        float ox, oy, oz;
+        float dx, dy, dz;
+        int kx, ky, kz;
+        float sx, sy, sz;
+    };
+
+    struct SphereArrays
+    {
+        const float *cx, *cy, *cz, *radius;
+    };
+
+    struct QuadArrays
+    {
+        const float *qx, *qy, *qz; // Corner
+        const float *ux, *uy, *uz; // First edge
+        const float *vx, *vy, *vz; // Second edge
+        const float *nx, *ny, *nz; // Unit normal
+        const float *wx, *wy, *wz; // n / (n . n) for the unnormalized normal u x v
+    };
+
+    struct TriangleArrays
+    {
+        const float *a[3], *b[3], *c[3]; // Vertex coordinates, indexed by axis
+    };
+
+    const int kMaxWidth = 8;
+
+    // Children of a wide BVH node.
+    const int kWideBvhWidth = 8;
+
+    /**
+     * The child boxes of a wide BVH node, quantized to 8 bits per plane on a grid per axis whose
+     * origin is the low corner of the node's bounds and whose spacing is 2^exponent. Children
+     * [0, child_count) are used.
+    */
+    struct QuantizedBoxes
+    {
+        float origin[3];
+        int8_t exponent[3];
+        uint8_t child_count;
+        uint8_t lo[3][kWideBvhWidth];
+        uint8_t hi[3][kWideBvhWidth];
+    };
+
+    /**
+     * A ray set up for one QuantizedBoxes: it crosses the plane with quantized coordinate q on
+     * axis a at t = q * step[a] + offset[a]. negative[a] is set when the ray runs towards lower
+     * coordinates, so that it crosses the hi planes first.
+    */
+    struct WideRay
+    {
+        float step[3];
+        float offset[3];
+        int negative[3];
+    };
+
+    // Widens each child's far distance so that rounding in the slab test never drops a box the
+    // ray grazes: 1 + 2 gamma(3) in the notation of pbrt.
+    const float kWideBoxPad = 1.0000004f;
+
+    /**
+     * Each kernel tests primitives [first, first + count) against the ray and returns the index
+     * of the closest one hit with t in (t_min, *t_max), storing its t in *t_max, or -1 on a miss.
+     * Arrays must be readable up to kMaxWidth elements past the last primitive.
+     *
+     * quantize encodes count linear values for display: clamped to [0, 1], raised to the power
+     * 1/2 and scaled to 8 bits.
+     *
+     * wide_node tests the ray against every child box of a wide BVH node and returns a bit mask
+     * of those it crosses within [t_min, t_max], storing the distance at which it enters each
+     * child in t_near[kWideBvhWidth].
+    */
+    struct KernelTable
+    {
+        int (*sphere)(const SphereArrays &, size_t first, size_t count, const RayData &, float t_min, float *t_max);
+        int (*quad)(const QuadArrays &, size_t first, size_t count, const RayData &, float t_min, float *t_max);
+        int (*triangle)(const TriangleArrays &, size_t first, size_t count, const RayData &, float t_min, float *t_max);
+        void (*quantize)(const float *linear, unsigned char *out, size_t count);
+        int (*wide_node)(const QuantizedBoxes &, const WideRay &, float t_min, float t_max, float *t_near);
+    };
+
+    KernelTable ScalarKernels();
+    KernelTable SseKernels();
+    KernelTable Avx2Kernels();
+
+}
+
+#endif
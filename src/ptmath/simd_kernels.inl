@@ -0,0 +1,266 @@
+// Ray/primitive and pixel kernels written once against a lane type V, and included by each
+// per-ISA translation unit inside its own namespace. V provides kWidth and the free functions
+// Load, LoadBytes, Set1, Iota, Store, MoveMask, Sqrt, Min, Max, Lt, Le, Gt, Ge, Ne, And, Or, AndNot
+// and Select, where comparisons return all-ones or all-zeros lanes of the same type, LoadBytes
+// converts kWidth bytes to floats and MoveMask packs the sign bit of each lane into an int. See simd_kernels.h for
+// why nothing outside this file may be called from here.
+
+template <typename V>
+int ReduceClosest(V best_t, V best_index, float *t_max)
+{
+    float ts[V::kWidth], indices[V::kWidth];
+    Store(best_t, ts);
+    Store(best_index, indices);
+
+    int best = -1;
+    float closest = *t_max;
+    for (int i = 0; i < V::kWidth; i++)
+    {
+        if (indices[i] >= 0 && ts[i] < closest)
+        {
+            closest = ts[i];
+            best = static_cast<int>(indices[i]);
+        }
+    }
+
+    if (best >= 0)
+        *t_max = closest;
+    return best;
+}
+
+template <typename V>
+int ClosestSphereT(const SphereArrays &s, size_t first, size_t count, const RayData &r, float t_min, float *t_max)
+{
+    const V dx = Set1<V>(r.dx), dy = Set1<V>(r.dy), dz = Set1<V>(r.dz);
+    const V ox = Set1<V>(r.ox), oy = Set1<V>(r.oy), oz = Set1<V>(r.oz);
+    const V zero = Set1<V>(0);
+    const V a = dx * dx + dy * dy + dz * dz;
+    const V inv_a = Set1<V>(1) / a;
+    const V tmin = Set1<V>(t_min);
+    const V end = Set1<V>(static_cast<float>(count));
+
+    V best_t = Set1<V>(*t_max);
+    V best_index = Set1<V>(-1);
+
+    for (size_t offset = 0; offset < count; offset += V::kWidth)
+    {
+        size_t base = first + offset;
+        V lane = Iota<V>() + Set1<V>(static_cast<float>(offset));
+        V valid = Lt(lane, end);
+
+        V fx = ox - Load<V>(s.cx + base);
+        V fy = oy - Load<V>(s.cy + base);
+        V fz = oz - Load<V>(s.cz + base);
+        V radius = Load<V>(s.radius + base);
+        V r2 = radius * radius;
+
+        V half_b = fx * dx + fy * dy + fz * dz;
+        V c = fx * fx + fy * fy + fz * fz - r2;
+
+        // The discriminant from the distance between the center and the closest point on the
+        // line avoids the cancellation in half_b^2 - a*c that float cannot afford.
+        V k = half_b * inv_a;
+        V lx = fx - k * dx, ly = fy - k * dy, lz = fz - k * dz;
+        V disc = a * (r2 - (lx * lx + ly * ly + lz * lz));
+        V sqrtd = Sqrt(Max(disc, zero));
+
+        // Stable roots: q has the sign of -half_b, so neither c / q nor q / a cancels.
+        V q = Select(Lt(half_b, zero), sqrtd - half_b, zero - half_b - sqrtd);
+        V t0 = c / q;
+        V t1 = q * inv_a;
+        V t_near = Min(t0, t1);
+        V t_far = Max(t0, t1);
+
+        V near_ok = And(Gt(t_near, tmin), Lt(t_near, best_t));
+        V far_ok = And(Gt(t_far, tmin), Lt(t_far, best_t));
+        V hit = And(And(valid, Ge(disc, zero)), Or(near_ok, far_ok));
+
+        best_t = Select(hit, Select(near_ok, t_near, t_far), best_t);
+        best_index = Select(hit, lane + Set1<V>(static_cast<float>(first)), best_index);
+    }
+
+    return ReduceClosest(best_t, best_index, t_max);
+}
+
+template <typename V>
+int ClosestQuadT(const QuadArrays &s, size_t first, size_t count, const RayData &r, float t_min, float *t_max)
+{
+    // Hits within this distance of an edge, in plane coordinates, are reported so that float
+    // rounding cannot open cracks between quads; callers confirm the hit in double.
+    const V kEdgeTolerance = Set1<V>(1e-4f);
+
+    const V dx = Set1<V>(r.dx), dy = Set1<V>(r.dy), dz = Set1<V>(r.dz);
+    const V ox = Set1<V>(r.ox), oy = Set1<V>(r.oy), oz = Set1<V>(r.oz);
+    const V zero = Set1<V>(0), one = Set1<V>(1);
+    const V tmin = Set1<V>(t_min);
+    const V end = Set1<V>(static_cast<float>(count));
+
+    V best_t = Set1<V>(*t_max);
+    V best_index = Set1<V>(-1);
+
+    for (size_t offset = 0; offset < count; offset += V::kWidth)
+    {
+        size_t base = first + offset;
+        V lane = Iota<V>() + Set1<V>(static_cast<float>(offset));
+        V valid = Lt(lane, end);
+
+        V nx = Load<V>(s.nx + base), ny = Load<V>(s.ny + base), nz = Load<V>(s.nz + base);
+        V px = ox - Load<V>(s.qx + base);
+        V py = oy - Load<V>(s.qy + base);
+        V pz = oz - Load<V>(s.qz + base);
+
+        V denom = nx * dx + ny * dy + nz * dz;
+        V t = (zero - (nx * px + ny * py + nz * pz)) / denom;
+
+        // Hit point relative to the corner, then its plane coordinates.
+        V hx = px + t * dx, hy = py + t * dy, hz = pz + t * dz;
+        V ux = Load<V>(s.ux + base), uy = Load<V>(s.uy + base), uz = Load<V>(s.uz + base);
+        V vx = Load<V>(s.vx + base), vy = Load<V>(s.vy + base), vz = Load<V>(s.vz + base);
+        V wx = Load<V>(s.wx + base), wy = Load<V>(s.wy + base), wz = Load<V>(s.wz + base);
+
+        V alpha = wx * (hy * vz - hz * vy) + wy * (hz * vx - hx * vz) + wz * (hx * vy - hy * vx);
+        V beta = wx * (uy * hz - uz * hy) + wy * (uz * hx - ux * hz) + wz * (ux * hy - uy * hx);
+
+        V inside = And(And(Ge(alpha, zero - kEdgeTolerance), Le(alpha, one + kEdgeTolerance)),
+                       And(Ge(beta, zero - kEdgeTolerance), Le(beta, one + kEdgeTolerance)));
+        V facing = Gt(Max(denom, zero - denom), Set1<V>(1e-8f));
+        V hit = And(And(valid, facing), And(inside, And(Gt(t, tmin), Lt(t, best_t))));
+
+        best_t = Select(hit, t, best_t);
+        best_index = Select(hit, lane + Set1<V>(static_cast<float>(first)), best_index);
+    }
+
+    return ReduceClosest(best_t, best_index, t_max);
+}
+
+template <typename V>
+int ClosestTriangleT(const TriangleArrays &s, size_t first, size_t count, const RayData &r, float t_min, float *t_max)
+{
+    // The watertight test of ptmath::IntersectTriangle, one triangle per lane. Exactly zero edge
+    // functions count as inside, so shared edges stay closed without the double fallback.
+    const float o[3] = {r.ox, r.oy, r.oz};
+    const V okx = Set1<V>(o[r.kx]), oky = Set1<V>(o[r.ky]), okz = Set1<V>(o[r.kz]);
+    const V sx = Set1<V>(r.sx), sy = Set1<V>(r.sy), sz = Set1<V>(r.sz);
+    const V zero = Set1<V>(0);
+    const V tmin = Set1<V>(t_min);
+    const V end = Set1<V>(static_cast<float>(count));
+
+    V best_t = Set1<V>(*t_max);
+    V best_index = Set1<V>(-1);
+
+    for (size_t offset = 0; offset < count; offset += V::kWidth)
+    {
+        size_t base = first + offset;
+        V lane = Iota<V>() + Set1<V>(static_cast<float>(offset));
+        V valid = Lt(lane, end);
+
+        V az = Load<V>(s.a[r.kz] + base) - okz;
+        V bz = Load<V>(s.b[r.kz] + base) - okz;
+        V cz = Load<V>(s.c[r.kz] + base) - okz;
+        V ax = Load<V>(s.a[r.kx] + base) - okx - sx * az;
+        V ay = Load<V>(s.a[r.ky] + base) - oky - sy * az;
+        V bx = Load<V>(s.b[r.kx] + base) - okx - sx * bz;
+        V by = Load<V>(s.b[r.ky] + base) - oky - sy * bz;
+        V cx = Load<V>(s.c[r.kx] + base) - okx - sx * cz;
+        V cy = Load<V>(s.c[r.ky] + base) - oky - sy * cz;
+
+        V u = cx * by - cy * bx;
+        V v = ax * cy - ay * cx;
+        V w = bx * ay - by * ax;
+
+        V any_negative = Or(Or(Lt(u, zero), Lt(v, zero)), Lt(w, zero));
+        V any_positive = Or(Or(Gt(u, zero), Gt(v, zero)), Gt(w, zero));
+        V det = u + v + w;
+        V t = sz * (u * az + v * bz + w * cz) / det;
+
+        V hit = AndNot(And(any_negative, any_positive), And(valid, Ne(det, zero)));
+        hit = And(hit, And(Gt(t, tmin), Lt(t, best_t)));
+
+        best_t = Select(hit, t, best_t);
+        best_index = Select(hit, lane + Set1<V>(static_cast<float>(first)), best_index);
+    }
+
+    return ReduceClosest(best_t, best_index, t_max);
+}
+
+template <typename V>
+void QuantizeT(const float *linear, unsigned char *out, size_t count)
+{
+    const V zero = Set1<V>(0), one = Set1<V>(1), scale = Set1<V>(255.999f);
+    float encoded[V::kWidth];
+
+    for (size_t offset = 0; offset < count; offset += V::kWidth)
+    {
+        size_t lanes = count - offset < size_t(V::kWidth) ? count - offset : size_t(V::kWidth);
+
+        // The last, partial vector is loaded from a copy so that no read goes past the end.
+        V x;
+        if (lanes == size_t(V::kWidth))
+        {
+            x = Load<V>(linear + offset);
+        }
+        else
+        {
+            float tail[V::kWidth] = {};
+            for (size_t i = 0; i < lanes; i++)
+                tail[i] = linear[offset + i];
+            x = Load<V>(tail);
+        }
+
+        // Max before Min turns NaN into 0 on every ISA.
+        Store(Sqrt(Min(Max(x, zero), one)) * scale, encoded);
+        for (size_t i = 0; i < lanes; i++)
+            out[offset + i] = static_cast<unsigned char>(encoded[i]);
+    }
+}
+
+template <typename V>
+int IntersectWideT(const QuantizedBoxes &node, const WideRay &r, float t_min, float t_max, float *t_near)
+{
+    int mask = 0;
+    for (int offset = 0; offset < kWideBvhWidth; offset += V::kWidth)
+    {
+        V near = Set1<V>(t_min);
+        V far = Set1<V>(t_max);
+        for (int a = 0; a < 3; a++)
+        {
+            const uint8_t *near_planes = (r.negative[a] ? node.hi[a] : node.lo[a]) + offset;
+            const uint8_t *far_planes = (r.negative[a] ? node.lo[a] : node.hi[a]) + offset;
+            const V step = Set1<V>(r.step[a]);
+            const V base = Set1<V>(r.offset[a]);
+
+            // Max and Min keep their second operand when the first is NaN, from 0 * inf on a
+            // slab parallel to the ray, so such a slab leaves the interval alone.
+            near = Max(LoadBytes<V>(near_planes) * step + base, near);
+            far = Min(LoadBytes<V>(far_planes) * step + base, far);
+        }
+        Store(near, t_near + offset);
+        mask |= MoveMask(Le(near, far * Set1<V>(kWideBoxPad))) << offset;
+    }
+    return mask & ((1 << node.child_count) - 1);
+}
+
+int ClosestSphere(const SphereArrays &s, size_t first, size_t count, const RayData &r, float t_min, float *t_max)
+{
+    return ClosestSphereT<Lanes>(s, first, count, r, t_min, t_max);
+}
+
+int ClosestQuad(const QuadArrays &s, size_t first, size_t count, const RayData &r, float t_min, float *t_max)
+{
+    return ClosestQuadT<Lanes>(s, first, count, r, t_min, t_max);
+}
+
+int ClosestTriangle(const TriangleArrays &s, size_t first, size_t count, const RayData &r, float t_min, float *t_max)
+{
+    return ClosestTriangleT<Lanes>(s, first, count, r, t_min, t_max);
+}
+
+void Quantize(const float *linear, unsigned char *out, size_t count)
+{
+    QuantizeT<Lanes>(linear, out, count);
+}
+
+int IntersectWide(const QuantizedBoxes &node, const WideRay &r, float t_min, float t_max, float *t_near)
+{
+    return IntersectWideT<Lanes>(node, r, t_min, t_max, t_near);
+}
@@ -0,0 +1,67 @@
+#include "simd_kernels.h"
+
+#include <cstring>
+#include <emmintrin.h>
+
+// SSE2 kernels, four floats per lane vector. SSE2 is part of x86-64, so this unit needs no
+// extra compiler flags.
+
+namespace ptmath::simd::sse
+{
+
+    struct Lanes
+    {
+        static const int kWidth = 4;
+        __m128 v;
+    };
+
+    inline Lanes operator+(Lanes a, Lanes b) { return {_mm_add_ps(a.v, b.v)}; }
+    inline Lanes operator-(Lanes a, Lanes b) { return {_mm_sub_ps(a.v, b.v)}; }
+    inline Lanes operator*(Lanes a, Lanes b) { return {_mm_mul_ps(a.v, b.v)}; }
+    inline Lanes operator/(Lanes a, Lanes b) { return {_mm_div_ps(a.v, b.v)}; }
+
+    template <typename V> V Load(const float *p);
+    template <> inline Lanes Load<Lanes>(const float *p) { return {_mm_loadu_ps(p)}; }
+    template <typename V> V LoadBytes(const uint8_t *p);
+    template <> inline Lanes LoadBytes<Lanes>(const uint8_t *p)
+    {
+        // SSE2 has no byte-to-int conversion; widen by unpacking with zeros instead.
+        int32_t bytes;
+        memcpy(&bytes, p, sizeof(bytes));
+        __m128i zero = _mm_setzero_si128();
+        __m128i words = _mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero);
+        return {_mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero))};
+    }
+    template <typename V> V Set1(float x);
+    template <> inline Lanes Set1<Lanes>(float x) { return {_mm_set1_ps(x)}; }
+    template <typename V> V Iota();
+    template <> inline Lanes Iota<Lanes>() { return {_mm_setr_ps(0, 1, 2, 3)}; }
+    inline void Store(Lanes a, float *p) { _mm_storeu_ps(p, a.v); }
+    inline int MoveMask(Lanes a) { return _mm_movemask_ps(a.v); }
+
+    inline Lanes Sqrt(Lanes a) { return {_mm_sqrt_ps(a.v)}; }
+    inline Lanes Min(Lanes a, Lanes b) { return {_mm_min_ps(a.v, b.v)}; }
+    inline Lanes Max(Lanes a, Lanes b) { return {_mm_max_ps(a.v, b.v)}; }
+
+    inline Lanes Lt(Lanes a, Lanes b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+    inline Lanes Le(Lanes a, Lanes b) { return {_mm_cmple_ps(a.v, b.v)}; }
+    inline Lanes Gt(Lanes a, Lanes b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+    inline Lanes Ge(Lanes a, Lanes b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+    inline Lanes Ne(Lanes a, Lanes b) { return {_mm_cmpneq_ps(a.v, b.v)}; }
+
+    inline Lanes And(Lanes a, Lanes b) { return {_mm_and_ps(a.v, b.v)}; }
+    inline Lanes Or(Lanes a, Lanes b) { return {_mm_or_ps(a.v, b.v)}; }
+    inline Lanes AndNot(Lanes a, Lanes b) { return {_mm_andnot_ps(a.v, b.v)}; } // ~a & b
+    inline Lanes Select(Lanes mask, Lanes a, Lanes b)
+    {
+        return {_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))};
+    }
+
+#include "simd_kernels.inl"
+
+}
+
+ptmath::simd::KernelTable ptmath::simd::SseKernels()
+{
+    return {sse::ClosestSphere, sse::ClosestQuad, sse::ClosestTriangle, sse::Quantize, sse::IntersectWide};
+}
@@ -1,6 +1,8 @@
 #ifndef TRI3_H
 #define TRI3_H
 
+#include <utility>
+
 #include "./util/util.h"
 #include "vec3.h"
 #include "ray.h"
@@ -8,25 +10,108 @@
 namespace ptmath
 {
 
+    /**
+     * Per-ray setup for IntersectTriangle: an axis permutation that makes z the dominant ray
+     * direction, and the shear that maps the ray onto the +z axis. Computing it once per ray
+     * keeps it out of the per-triangle work.
+    */
+    struct TriangleRay
+    {
+        Point3 origin;
+        int kx, ky, kz;
+        float sx, sy, sz;
+
+        TriangleRay() {}
+
+        TriangleRay(const ray &r) : origin(r.origin())
+        {
+            Vec3 d = r.direction();
+            kz = fabs(d[0]) > fabs(d[1]) ? (fabs(d[0]) > fabs(d[2]) ? 0 : 2) : (fabs(d[1]) > fabs(d[2]) ? 1 : 2);
+            kx = kz == 2 ? 0 : kz + 1;
+            ky = kx == 2 ? 0 : kx + 1;
+            if (d[kz] < 0)
+                std::swap(kx, ky); // Keep the winding of the permuted space
+
+            sx = float(d[kx] / d[kz]);
+            sy = float(d[ky] / d[kz]);
+            sz = float(1 / d[kz]);
+        }
+    };
+
+    /**
+     * Watertight ray/triangle test (Woop, Benthin and Wald 2013) in single precision. On a hit,
+     * returns the ray parameter t and the barycentric weights b1, b2 of p1 and p2 (p0 gets
+     * 1 - b1 - b2).
+     *
+     * The vertices are moved into the sheared ray space of TriangleRay and the three edge
+     * functions are evaluated there. Adjacent triangles compute bitwise-identical edge functions
+     * for a shared edge, so a ray through an edge or vertex can never slip between them, which
+     * Moller-Trumbore does not guarantee. Vertex differences are taken in Real before rounding to float,
+     * so triangles far from the origin keep their precision.
+    */
+    inline bool IntersectTriangle(const Point3 &p0, const Point3 &p1, const Point3 &p2, const TriangleRay &r,
+                                  Real &t, Real &b1, Real &b2)
+    {
+        float az = float(p0[r.kz] - r.origin[r.kz]);
+        float bz = float(p1[r.kz] - r.origin[r.kz]);
+        float cz = float(p2[r.kz] - r.origin[r.kz]);
+        float ax = float(p0[r.kx] - r.origin[r.kx]) - r.sx * az;
+        float ay = float(p0[r.ky] - r.origin[r.ky]) - r.sy * az;
+        float bx = float(p1[r.kx] - r.origin[r.kx]) - r.sx * bz;
+        float by = float(p1[r.ky] - r.origin[r.ky]) - r.sy * bz;
+        float cx = float(p2[r.kx] - r.origin[r.kx]) - r.sx * cz;
+        float cy = float(p2[r.ky] - r.origin[r.ky]) - r.sy * cz;
+
+        float u = cx * by - cy * bx;
+        float v = ax * cy - ay * cx;
+        float w = bx * ay - by * ax;
+
+        // Exactly zero edge functions are resolved in double, which keeps the test watertight
+        // for rays that pass exactly through an edge.
+        if (u == 0.0f || v == 0.0f || w == 0.0f)
+        {
+            u = float(double(cx) * double(by) - double(cy) * double(bx));
+            v = float(double(ax) * double(cy) - double(ay) * double(cx));
+            w = float(double(bx) * double(ay) - double(by) * double(ax));
+        }
+
+        float det = u + v + w;
+        float t_scaled = r.sz * (u * az + v * bz + w * cz);
+
+        // Inside if the edge functions agree in sign; the triangle may face either way.
+        bool outside = ((u < 0) | (v < 0) | (w < 0)) & ((u > 0) | (v > 0) | (w > 0));
+        if (outside | (det == 0.0f))
+            return false;
+
+        float inv_det = 1.0f / det;
+        t = t_scaled * inv_det;
+        b1 = v * inv_det;
+        b2 = w * inv_det;
+        return true;
+    }
+
+    inline bool IntersectTriangle(const Point3 &p0, const Point3 &p1, const Point3 &p2, const ray &r,
+                                  Real &t, Real &b1, Real &b2)
+    {
+        return IntersectTriangle(p0, p1, p2, TriangleRay(r), t, b1, b2);
+    }
+
     class Tri3
     {
     public:
         Tri3(const Point3 &p1, const Point3 &p2, const Point3 p3) : p_{p1, p2, p3}
         {
             normal_ = cross(p2 - p1, p3 - p1);
-            e_[0] = p2 - p1;
-            e_[1] = p3 - p2;
-            e_[2] = p1 - p3;
         }
 
         inline Point3 p1() const {
             return p_[0];
         }
         inline Point3 p2() const {
-            return p_[2];
+            return p_[1];
         }
         inline Point3 p3() const {
-            return p_[3];
+            return p_[2];
         }
 
         Vec3 normal() const
@@ -36,39 +121,30 @@ namespace ptmath
 
         bool includes(Point3 p) const
         {
+            // p is inside if it lies on the inner side of all three edges.
+            for (int i = 0; i < 3; i++)
+            {
+                Vec3 edge = p_[(i + 1) % 3] - p_[i];
+                if (dot(normal_, cross(edge, p - p_[i])) < 0)
+                    return false;
+            }
+            return true;
         }
 
-        bool intersect(ray r, int &t) const
+        bool intersect(const TriangleRay &r, Real &t, Real &b1, Real &b2) const
         {
-            float NdotRayDirection = dot(normal_, r.direction());
-            if (fabs(NdotRayDirection) < kEpsilon) // almost 0
-                return false;
-
-            float d = -dot(normal_, p_[0]);
-            t = -(dot(normal_, r.origin()) + d) / NdotRayDirection;
-
-            if (t < 0)
-                return false;
-
-            Vec3 P = r.at(t);
-            Vec3 C;
-
-            Vec3 vp0 = P - p_[0];
-            C = cross(e_[0], vp0);
-            if (dot(normal_, C) < 0)
-                return false;
-
-            Vec3 vp1 = P - p_[1];
-            C = cross(e_[1], vp1);
-            if (dot(normal_, C) < 0)
-                return false;
+            return IntersectTriangle(p_[0], p_[1], p_[2], r, t, b1, b2);
+        }
 
-            Vec3 vp2 = P - p_[2];
-            C = cross(e_[2], vp2);
-            if (dot(normal_, C) < 0)
-                return false;
+        bool intersect(const ray &r, Real &t, Real &b1, Real &b2) const
+        {
+            return intersect(TriangleRay(r), t, b1, b2);
+        }
 
-            return true;
+        bool intersect(const TriangleRay &r, Real &t) const
+        {
+            Real b1, b2;
+            return intersect(r, t, b1, b2);
         }
 
         inline Tri3 translate(const Vec3 &v)
@@ -76,16 +152,15 @@ namespace ptmath
             return Tri3(p1() + v, p2() + v, p3() + v);
         }
 
-        double area() const
+        Real area() const
         {
-            return normal_.length();
+            return normal_.length() / 2;
         }
 
     private:
         Point3 p_[3];
-        Vec3 e_[3];
         Vec3 normal_;
     };
 }
 
-#endif
\ No newline at end of file
+#endif
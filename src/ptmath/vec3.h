@@ -5,53 +5,75 @@
 #include <iostream>
 
 #include "./util/util.h"
+#include "./util/sampler.h"
 
 namespace ptmath
 {
 
-    class Vec3
+    // Scalar type of vectors, rays and intervals. Building with -DPTMATH_FLOAT halves the size of
+    // every vertex, normal and hit record; the default stays double.
+#ifdef PTMATH_FLOAT
+    using Real = float;
+#else
+    using Real = double;
+#endif
+
+    // With -DPTMATH_VEC4 a vector is padded to four lanes aligned to their size, so that four
+    // floats fill an SSE register (four doubles an AVX one) and the compiler can do the
+    // component-wise operators in one instruction. The fourth lane is always zero.
+#ifdef PTMATH_VEC4
+    constexpr int kVec3Lanes = 4;
+#else
+    constexpr int kVec3Lanes = 3;
+#endif
+
+    class alignas(kVec3Lanes == 4 ? 4 * sizeof(Real) : alignof(Real)) Vec3
     {
     public:
-        double e[3];
+        Real e[kVec3Lanes];
 
-        Vec3() : e{0, 0, 0} {}
-        Vec3(double e0, double e1, double e2) : e{e0, e1, e2} {}
+        Vec3() : e{} {}
+        Vec3(Real e0, Real e1, Real e2) : e{e0, e1, e2} {}
 
-        double x() const { return e[0]; }
-        double y() const { return e[1]; }
-        double z() const { return e[2]; }
+        Real x() const { return e[0]; }
+        Real y() const { return e[1]; }
+        Real z() const { return e[2]; }
 
-        Vec3 operator-() const { return Vec3(-e[0], -e[1], -e[2]); }
-        double operator[](int i) const { return e[i]; }
-        double &operator[](int i) { return e[i]; }
+        Vec3 operator-() const
+        {
+            Vec3 v;
+            for (int i = 0; i < kVec3Lanes; i++)
+                v.e[i] = -e[i];
+            return v;
+        }
+        Real operator[](int i) const { return e[i]; }
+        Real &operator[](int i) { return e[i]; }
 
         Vec3 &operator+=(const Vec3 &v)
         {
-            e[0] += v.e[0];
-            e[1] += v.e[1];
-            e[2] += v.e[2];
+            for (int i = 0; i < kVec3Lanes; i++)
+                e[i] += v.e[i];
             return *this;
         }
 
-        Vec3 &operator*=(double t)
+        Vec3 &operator*=(Real t)
         {
-            e[0] *= t;
-            e[1] *= t;
-            e[2] *= t;
+            for (int i = 0; i < kVec3Lanes; i++)
+                e[i] *= t;
             return *this;
         }
 
-        Vec3 &operator/=(double t)
+        Vec3 &operator/=(Real t)
         {
             return *this *= 1 / t;
         }
 
-        double length() const
+        Real length() const
         {
             return std::sqrt(length_squared());
         }
 
-        double length_squared() const
+        Real length_squared() const
         {
             return e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
         }
@@ -83,32 +105,47 @@ namespace ptmath
         return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
     }
 
+    // The component-wise operators run over every lane, the padding one included, so that they
+    // vectorize; the padding stays zero.
+
     inline Vec3 operator+(const Vec3 &u, const Vec3 &v)
     {
-        return Vec3(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
+        Vec3 r;
+        for (int i = 0; i < kVec3Lanes; i++)
+            r.e[i] = u.e[i] + v.e[i];
+        return r;
     }
 
     inline Vec3 operator-(const Vec3 &u, const Vec3 &v)
     {
-        return Vec3(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
+        Vec3 r;
+        for (int i = 0; i < kVec3Lanes; i++)
+            r.e[i] = u.e[i] - v.e[i];
+        return r;
     }
 
     inline Vec3 operator*(const Vec3 &u, const Vec3 &v)
     {
-        return Vec3(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
+        Vec3 r;
+        for (int i = 0; i < kVec3Lanes; i++)
+            r.e[i] = u.e[i] * v.e[i];
+        return r;
     }
 
-    inline Vec3 operator*(double t, const Vec3 &v)
+    inline Vec3 operator*(Real t, const Vec3 &v)
     {
-        return Vec3(t * v.e[0], t * v.e[1], t * v.e[2]);
+        Vec3 r;
+        for (int i = 0; i < kVec3Lanes; i++)
+            r.e[i] = t * v.e[i];
+        return r;
     }
 
-    inline Vec3 operator*(const Vec3 &v, double t)
+    inline Vec3 operator*(const Vec3 &v, Real t)
     {
         return t * v;
     }
 
-    inline Vec3 operator/(Vec3 v, double t)
+    inline Vec3 operator/(Vec3 v, Real t)
     {
         return (1 / t) * v;
     }
@@ -118,7 +155,7 @@ namespace ptmath
         return Vec3(std::sqrt(v.e[0]), std::sqrt(v.e[1]), std::sqrt(v.e[2]));
     }
 
-    inline double dot(const Vec3 &u, const Vec3 &v)
+    inline Real dot(const Vec3 &u, const Vec3 &v)
     {
         return u.e[0] * v.e[0] + u.e[1] * v.e[1] + u.e[2] * v.e[2];
     }
@@ -135,7 +172,7 @@ namespace ptmath
         return v - 2 * dot(v, n) * n;
     }
 
-    inline Vec3 refract(const Vec3 &uv, const Vec3 &n, double etai_over_etat)
+    inline Vec3 refract(const Vec3 &uv, const Vec3 &n, Real etai_over_etat)
     {
         auto cos_theta = fmin(dot(-uv, n), 1.0);
         Vec3 r_out_perp = etai_over_etat * (uv + cos_theta * n);
@@ -150,20 +187,42 @@ namespace ptmath
 
     inline auto distance2(const Vec3 &u, const Vec3 &v)
     {
-        const double dx = u.x() - v.x();
-        const double dy = u.y() - v.y();
-        const double dz = u.z() - v.y();
+        const Real dx = u.x() - v.x();
+        const Real dy = u.y() - v.y();
+        const Real dz = u.z() - v.y();
         return dx * dx + dy * dy + dz * dz;
     }
 
-    inline Vec3 random_unit_vector()
+    // Uniformly distributed on the unit sphere, from the next two dimensions of sampler.
+    inline Vec3 random_unit_vector(util::PixelSampler &sampler)
     {
-        return unit_vector(Vec3::random());
+        util::Sample2 s = sampler.Get2D();
+        double z = 1 - 2 * s.u;
+        double r = std::sqrt(std::fmax(0.0, 1 - z * z));
+        double phi = 2 * kPi * s.v;
+        return Vec3(r * std::cos(phi), r * std::sin(phi), z);
+    }
+
+    // Cosine-distributed around the unit vector normal, from the next two dimensions of sampler.
+    inline Vec3 random_cosine_direction(const Vec3 &normal, util::PixelSampler &sampler)
+    {
+        util::Sample2 s = sampler.Get2D();
+        double r = std::sqrt(s.u);
+        double phi = 2 * kPi * s.v;
+        double x = r * std::cos(phi), y = r * std::sin(phi), z = std::sqrt(std::fmax(0.0, 1 - s.u));
+
+        // Orthonormal basis around normal (Duff et al., "Building an Orthonormal Basis, Revisited", 2017).
+        double sign = std::copysign(1.0, normal.z());
+        double a = -1 / (sign + normal.z());
+        double b = normal.x() * normal.y() * a;
+        Vec3 tangent(1 + sign * normal.x() * normal.x() * a, sign * b, -sign * normal.x());
+        Vec3 bitangent(b, sign + normal.y() * normal.y() * a, -normal.y());
+        return x * tangent + y * bitangent + z * normal;
     }
 
-    inline Vec3 random_on_hemisphere(const Vec3 &normal)
+    inline Vec3 random_on_hemisphere(const Vec3 &normal, util::PixelSampler &sampler)
     {
-        Vec3 on_unit_sphere = random_unit_vector();
+        Vec3 on_unit_sphere = random_unit_vector(sampler);
         if (dot(on_unit_sphere, normal) > 0.0) // In the same hemisphere as the normal
             return on_unit_sphere;
         else
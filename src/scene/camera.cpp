@@ -4,14 +4,41 @@
 #include "./graphics/image.h"
 #include "object/object.h"
 #include "material.h"
+#include "checkpoint.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
 #include <math.h>
-#include <mutex>
+#include <thread>
 
 using namespace scene;
 using namespace ptmath;
 
-void Camera::Initialize()
+void PixelEstimate::Add(const color &sample)
+{
+    sum += sample;
+    count++;
+
+    double luminance = 0.2126 * sample.x() + 0.7152 * sample.y() + 0.0722 * sample.z();
+    double delta = luminance - mean;
+    mean += delta / count;
+    m2 += delta * (luminance - mean);
+}
+
+double PixelEstimate::DisplayError() const
+{
+    if (count < 2)
+        return INFINITY;
+
+    double standard_error = sqrt(m2 / (count - 1) / count);
+    double low = std::min(std::max(mean, 0.0), 1.0);
+    double high = std::min(std::max(mean, 0.0) + standard_error, 1.0);
+    return sqrt(high) - sqrt(low);
+}
+
+void Camera::Initialize(const CompiledScene &world)
 {
     center = look_from_;
 
@@ -32,46 +59,325 @@ void Camera::Initialize()
 
     viewport_center = center - focal_length * w;
     viewport_upper_left = center - (focal_length * w) - U / 2 - V / 2;
+
+    sampler_ = util::MakeSampler(sampler_type_, samples_per_pixel_, seed_);
+    // Streaming renders count the samples of one band at a time.
+    sample_counts_.clear();
+    sample_counts_row_ = 0;
+    if ((adaptive_threshold_ > 0 && !Streaming()) || progressive_)
+        sample_counts_.assign(size_t(image_width_) * image_height_, 0);
+
+    lights_ = light_sampling_ ? world.lights() : LightList();
     std::clog << center;
 }
 
-void Camera::Render(const HittableGroup &world)
+void Camera::Render(const CompiledScene &world)
 {
-    this->Initialize();
+    this->Initialize(world);
 
-    image output(image_width_, image_height_);
+    image output(image_width_, image_height_, pixel_format_);
 
-    int pixel_index = 0;
-    for (int j = 0; j < image_height_; ++j)
+    if (progressive_)
     {
-        for (int i = 0; i < image_width_; ++i)
-        {
-            color c = RenderPixel(world, i, j);
-            output.buffer()[pixel_index++] = c;
-        }
+        util::TaskPool pool(1);
+        RenderProgressive(world, output, pool);
+        WriteOutput(output);
+        return;
+    }
+
+    for (int j = 0; j < image_height_; j += RowsPerBand())
+    {
+        RenderRows(world, output, j, std::min(j + RowsPerBand(), image_height_));
         double progress = (double) j / image_height_;
         util::PrintProgress(progress);
     }
 
-    output.flushToPPM();
+    if (adaptive_threshold_ > 0)
+        WriteSampleHeatmap();
+    WriteOutput(output);
+}
+
+void Camera::RenderRegion(const CompiledScene &world, image &output, int x_start, int x_end, int y_start,
+                          int y_end)
+{
+    if (packet_size_ > 1 && max_depth_ > 0)
+    {
+        int tile = std::min(packet_size_, 8);
+        for (int y = y_start; y < y_end; y += tile)
+            for (int x = x_start; x < x_end; x += tile)
+                RenderTile(world, output, x, std::min(x + tile, x_end), y, std::min(y + tile, y_end));
+        return;
+    }
+
+    for (int y = y_start; y < y_end; y++)
+    {
+        for (int x = x_start; x < x_end; x++)
+            output.setPixel(x, y, RenderPixel(world, x, y));
+    }
+}
+
+void Camera::RenderTile(const CompiledScene &world, image &output, int x_start, int x_end, int y_start,
+                        int y_end)
+{
+    PixelEstimate estimates[RayPacket::kMaxSize];
+    util::PixelSampler samplers[RayPacket::kMaxSize];
+    RayPacket packet;
+
+    for (int sample = 0; sample < samples_per_pixel_; sample++)
+    {
+        packet.size = 0;
+        for (int y = y_start; y < y_end; y++)
+        {
+            for (int x = x_start; x < x_end; x++)
+            {
+                samplers[packet.size] = SamplePixel(x, y, sample);
+                packet.add(GetRayForPixel(x, y, samplers[packet.size]));
+            }
+        }
+
+        world.hit_packet(packet);
+
+        for (int k = 0; k < packet.size; k++)
+        {
+            const ray &r = packet.rays[k];
+            estimates[k].Add(packet.hit[k] ? RenderRay(r, world, samplers[k], &packet.rec[k]) : Background(r));
+        }
+    }
+
+    // Pixels that need more samples than the tile take them one ray at a time.
+    int k = 0;
+    for (int y = y_start; y < y_end; y++)
+        for (int x = x_start; x < x_end; x++)
+            output.setPixel(x, y, FinishPixel(world, x, y, estimates[k++]));
 }
 
-color Camera::RenderPixel(const HittableGroup &world, int i, int j)
+color Camera::RenderPixel(const CompiledScene &world, int i, int j)
 {
-    color color;
+    PixelEstimate estimate;
     for (int sample = 0; sample < samples_per_pixel_; sample++)
+        estimate.Add(RenderSample(world, i, j, sample));
+    return FinishPixel(world, i, j, estimate);
+}
+
+color Camera::RenderSample(const CompiledScene &world, int i, int j, int index)
+{
+    util::PixelSampler sampler = SamplePixel(i, j, index);
+    ray r = GetRayForPixel(i, j, sampler);
+    return RenderRay(r, world, sampler);
+}
+
+color Camera::FinishPixel(const CompiledScene &world, int i, int j, PixelEstimate &estimate)
+{
+    // More samples are taken in batches of samples_per_pixel_, so that the error is not
+    // re-estimated after every sample and stratified samplers see whole sets of strata.
+    if (adaptive_threshold_ > 0)
+    {
+        while (estimate.count > 0 && estimate.count < max_samples_per_pixel_ &&
+               estimate.DisplayError() > adaptive_threshold_)
+        {
+            int end = std::min(estimate.count + std::max(samples_per_pixel_, 1), max_samples_per_pixel_);
+            for (int sample = estimate.count; sample < end; sample++)
+                estimate.Add(RenderSample(world, i, j, sample));
+        }
+    }
+
+    if (!sample_counts_.empty())
+        sample_counts_[size_t(j - sample_counts_row_) * image_width_ + i] = estimate.count;
+    return estimate.Mean();
+}
+
+void Camera::RenderProgressive(const CompiledScene &world, image &output, util::TaskPool &pool)
+{
+    using Clock = std::chrono::steady_clock;
+    auto Seconds = [](Clock::time_point since)
+    { return std::chrono::duration<double>(Clock::now() - since).count(); };
+
+    Clock::time_point start = Clock::now();
+    Clock::time_point last_snapshot = start;
+    Clock::time_point last_checkpoint = start;
+    std::vector<PixelEstimate> estimates(size_t(image_width_) * image_height_);
+    std::atomic<bool> out_of_time(false);
+
+    // Pixels that a pass cut short did not reach keep one sample fewer, which their means
+    // account for; a resumed render first brings them level.
+    int first_pass = 0;
+    RenderKey key = CheckpointKey(world);
+    if (!checkpoint_path_.empty() && ReadCheckpoint(checkpoint_path_, key, estimates.data(), estimates.size()))
+    {
+        first_pass = samples_per_pixel_;
+        for (const PixelEstimate &estimate : estimates)
+            first_pass = std::min(first_pass, estimate.count);
+        std::clog << "Resuming from " << checkpoint_path_ << " at " << first_pass << " samples per pixel\n";
+    }
+
+    // Checkpoints are written by a thread of their own from a copy of the estimates, so that
+    // rendering goes on while they are saved.
+    std::vector<PixelEstimate> saved;
+    std::thread writer;
+    auto SaveCheckpoint = [&]()
+    {
+        if (writer.joinable())
+            writer.join();
+        saved = estimates;
+        writer = std::thread([&]()
+                             { WriteCheckpoint(checkpoint_path_, key, saved.data(), saved.size()); });
+    };
+
+    // Each pixel takes its samples in index order, one per pass, so a render that runs all its
+    // passes matches a non-progressive one, however often it was interrupted and resumed.
+    int pass = first_pass;
+    double error = INFINITY;
+    for (; pass < samples_per_pixel_ && !out_of_time; pass++)
+    {
+        util::ParallelFor(pool, size_t(image_height_), [&](size_t begin, size_t end)
+                          {
+            for (int y = int(begin); y < int(end) && !out_of_time; y++)
+            {
+                for (int x = 0; x < image_width_; x++)
+                {
+                    PixelEstimate &estimate = estimates[size_t(y) * image_width_ + x];
+                    if (estimate.count <= pass)
+                        estimate.Add(RenderSample(world, x, y, estimate.count));
+                }
+                if (time_budget_seconds_ > 0 && Seconds(start) >= time_budget_seconds_)
+                    out_of_time = true;
+            } });
+
+        double elapsed = Seconds(start);
+        double progress = double(pass + 1) / samples_per_pixel_;
+        if (time_budget_seconds_ > 0)
+            progress = std::max(progress, elapsed / time_budget_seconds_);
+        util::PrintProgress(std::min(progress, 1.0));
+
+        if (target_error_ > 0 && pass > 0)
+        {
+            error = 0;
+            for (const PixelEstimate &estimate : estimates)
+                error += estimate.DisplayError();
+            error /= estimates.size();
+            if (error <= target_error_)
+            {
+                pass++;
+                break;
+            }
+        }
+
+        if (snapshot_interval_seconds_ > 0 && Seconds(last_snapshot) >= snapshot_interval_seconds_)
+        {
+            ResolveEstimates(estimates, output);
+            WriteSnapshot(output);
+            last_snapshot = Clock::now();
+        }
+
+        if (!checkpoint_path_.empty() && Seconds(last_checkpoint) >= checkpoint_interval_seconds_)
+        {
+            SaveCheckpoint();
+            last_checkpoint = Clock::now();
+        }
+    }
+
+    if (writer.joinable())
+        writer.join();
+    if (!checkpoint_path_.empty())
+        WriteCheckpoint(checkpoint_path_, key, estimates.data(), estimates.size());
+
+    ResolveEstimates(estimates, output);
+    std::clog << "\nProgressive: " << pass - first_pass << " passes in " << Seconds(start) << " s";
+    if (target_error_ > 0 && pass > 1)
+        std::clog << ", average display error " << error;
+    std::clog << "\n";
+}
+
+RenderKey Camera::CheckpointKey(const CompiledScene &world) const
+{
+    RenderKey key = {};
+    key.width = image_width_;
+    key.height = image_height_;
+    key.samples_per_pixel = samples_per_pixel_;
+    key.max_depth = max_depth_;
+    key.min_depth = min_depth_;
+    key.sampler_type = int64_t(sampler_type_);
+    key.light_sampling = light_sampling_;
+    key.seed = seed_;
+    for (int a = 0; a < 3; a++)
+    {
+        key.look_from[a] = look_from_[a];
+        key.lookat[a] = lookat_[a];
+        key.vup[a] = vup_[a];
+    }
+    key.vfov = vfov_;
+    key.dispatch = int64_t(world.dispatch());
+    key.object_count = world.object_count();
+    key.material_count = world.material_count();
+    key.scene_hash = world.ContentHash();
+    return key;
+}
+
+void Camera::ResolveEstimates(const std::vector<PixelEstimate> &estimates, image &output)
+{
+    for (size_t p = 0; p < estimates.size(); p++)
+    {
+        output.setPixel(p, estimates[p].Mean());
+        sample_counts_[p] = estimates[p].count;
+    }
+}
+
+void Camera::WriteSnapshot(const image &output) const
+{
+    // Readers polling the snapshot never see it half written.
+    std::string temporary = snapshot_path_ + ".tmp";
+    if (!output.writeFile(temporary, FormatForPath(snapshot_path_)))
+        return;
+    if (std::rename(temporary.c_str(), snapshot_path_.c_str()) != 0)
+        std::clog << "Could not replace the snapshot " << snapshot_path_ << "\n";
+}
+
+void Camera::WriteOutput(const image &output) const
+{
+    if (output_path_.empty())
+        output.flushToPPM();
+    else if (output.writeFile(output_path_))
+        std::clog << "Wrote " << output_path_ << "\n";
+}
+
+image Camera::SampleHeatmap() const
+{
+    // Single precision is plenty for colours that are written with 8 bits.
+    double range = max_samples_per_pixel_ - samples_per_pixel_;
+    int rows = int(sample_counts_.size() / image_width_);
+    image heatmap(image_width_, rows, PixelFormat::kFloat, sample_counts_row_);
+    for (size_t p = 0; p < sample_counts_.size(); p++)
     {
-        ray r = GetRayForPixel(i, j);
-        color += RenderRay(r, world);
+        double t = range > 0 ? (sample_counts_[p] - samples_per_pixel_) / range : 0;
+        t = std::min(std::max(t, 0.0), 1.0);
+        color c = t < 0.5 ? color(0, 2 * t, 1 - 2 * t) : color(2 * t - 1, 2 - 2 * t, 0);
+        heatmap.setPixel(p, c * c); // Image files hold square roots
     }
-    color = color / samples_per_pixel_;
-    return color;
+    return heatmap;
+}
+
+void Camera::WriteSampleHeatmap() const
+{
+    if (!SampleHeatmap().writeFile(sample_heatmap_path_))
+        return;
+
+    double total = 0;
+    for (int count : sample_counts_)
+        total += count;
+    LogSampleAverage(total);
+}
+
+void Camera::LogSampleAverage(double total_samples) const
+{
+    std::clog << "Adaptive sampling: " << total_samples / (double(image_width_) * image_height_)
+              << " samples per pixel on average, heatmap in " << sample_heatmap_path_ << "\n";
 }
 
-ray Camera::GetRayForPixel(const int i, const int j)
+ray Camera::GetRayForPixel(const int i, const int j, util::PixelSampler &sampler)
 {
-    double u_variance = util::RandomDouble() - .5;
-    double v_variance = util::RandomDouble() - .5;
+    util::Sample2 jitter = sampler.Get2D();
+    double u_variance = jitter.u - .5;
+    double v_variance = jitter.v - .5;
 
     auto vj = V * (double(j) + u_variance) / (image_height_ - 1);
     auto ui = U * (double(i) + v_variance) / (image_width_ - 1);
@@ -82,29 +388,101 @@ ray Camera::GetRayForPixel(const int i, const int j)
     return ray(origin, direction);
 }
 
-color Camera::RenderRay(const ray &r, const HittableGroup &world, const int depth)
+color Camera::RenderRay(ray r, const CompiledScene &world, util::PixelSampler &sampler, const HitRecord *first_hit)
 {
-    if (depth <= 0)
-    {
-        return color(0, 0, 0);
-    }
+    if (world.dispatch() == Dispatch::kVirtual)
+        return TracePath<Material>(r, world, sampler, first_hit);
+    return TracePath<MaterialRecord>(r, world, sampler, first_hit);
+}
 
+template <typename M>
+color Camera::TracePath(ray r, const CompiledScene &world, util::PixelSampler &sampler, const HitRecord *first_hit)
+{
+    color radiance(0, 0, 0);
+    color throughput(1, 1, 1);
+    double bsdf_pdf = 0; // Density of the last bounce if it also sampled the lights, else 0
     HitRecord rec;
-    if (world.hit(r, interval(0.001, INFINITY), rec))
+
+    for (int depth = 0; depth < max_depth_; depth++)
     {
-        if (rec.mat == NULL) // Default material
+        if (depth == 0 && first_hit)
+        {
+            rec = *first_hit;
+        }
+        else if (!world.hit(r, interval(0.001, INFINITY), rec))
+        {
+            radiance += throughput * Background(r);
+            break;
+        }
+
+        const M &mat = MaterialAs<M>(world.materials(), rec.mat);
+        BsdfSample bsdf;
+        if (!mat.Sample(r, rec, sampler, bsdf))
+        {
+            // Emission also reachable by light sampling is weighted against it.
+            color emitted = mat.Emit(r, rec);
+            if (bsdf_pdf > 0 && lights_.Contains(rec.mat))
+                emitted = emitted * PowerHeuristic(bsdf_pdf, lights_.Pdf(r.origin(), r.direction()));
+            radiance += throughput * emitted;
+            break;
+        }
+
+        // The last bounce gathers no light.
+        if (depth + 1 >= max_depth_)
+            break;
+
+        // Light sampling pays off only where scattering is spread out.
+        bsdf_pdf = 0;
+        if (!lights_.empty() && !bsdf.is_specular)
         {
-            Vec3 direction = rec.normal + random_unit_vector();
-            return 0.7 * RenderRay(ray(rec.p, direction), world, depth - 1);
+            radiance += throughput * SampleDirect(r, rec, mat, world, sampler);
+            bsdf_pdf = bsdf.pdf;
         }
 
-        ray scattered;
-        color attenuation;
-        if (rec.mat->Scatter(r, rec, attenuation, scattered))
-            return attenuation * RenderRay(scattered, world, depth - 1);
-        return rec.mat->Emit(r, rec);
+        throughput = throughput * (bsdf.value / bsdf.pdf);
+        if (!SurvivesRoulette(throughput, depth, sampler))
+            break;
+        r = ray(rec.p, bsdf.direction);
     }
 
+    return radiance;
+}
+
+bool Camera::SurvivesRoulette(color &throughput, int depth, util::PixelSampler &sampler) const
+{
+    if (depth + 1 < min_depth_)
+        return true;
+
+    // Survival is capped below 1 so that paths bouncing between bright surfaces end as well.
+    double survival = std::min<double>(0.95, std::max({throughput.x(), throughput.y(), throughput.z()}));
+    if (sampler.Get1D() >= survival)
+        return false;
+    throughput = throughput / survival;
+    return true;
+}
+
+template <typename M>
+color Camera::SampleDirect(const ray &r, const HitRecord &rec, const M &mat, const CompiledScene &world,
+                           util::PixelSampler &sampler)
+{
+    LightSample light;
+    if (!lights_.Sample(rec.p, sampler, light))
+        return color(0, 0, 0);
+
+    double bsdf_pdf = mat.Pdf(r, rec, light.direction);
+    if (bsdf_pdf <= 0)
+        return color(0, 0, 0);
+
+    HitRecord occluder;
+    if (world.hit(ray(rec.p, light.direction), interval(0.001, light.distance - 0.001), occluder))
+        return color(0, 0, 0);
+
+    double weight = PowerHeuristic(light.pdf, bsdf_pdf);
+    return mat.Eval(r, rec, light.direction) * light.emission * (weight / light.pdf);
+}
+
+color Camera::Background(const ray &r) const
+{
     Vec3 unit_direction = unit_vector(r.direction());
     auto a = 0.5 * (unit_direction.y() + 1.0);
     return (1.0 - a) * color(1.0, 1.0, 1.0) + a * color(0.5, 0.7, 1.0);
@@ -112,102 +490,136 @@ color Camera::RenderRay(const ray &r, const HittableGroup &world, const int dept
 
 // Multi Threaded
 
-void MultiThreadCamera::Render(const HittableGroup &world, int num_threads)
+void MultiThreadCamera::Render(const CompiledScene &world, int num_threads)
 {
     if (num_threads <= 0)
     {
         return;
     }
 
-    this->Initialize();
-
-    image output(image_width_, image_height_);
+    util::TaskPool pool(num_threads);
+    Render(world, pool);
+}
 
-    std::vector<std::thread> threads;
-    std::mutex mu;
-    int line = 0;
+void MultiThreadCamera::Render(const CompiledScene &world, util::TaskPool &pool)
+{
+    this->Initialize(world);
 
-    for (int t = 0; t < num_threads; t++)
-    {
-        threads.emplace_back(&BatchedMultiThreadCamera::ThreadJob, *this, world, output, std::ref(line), std::ref(mu));
-    }
+    pool.ResetStats();
+    if (stream_output_ && output_path_.empty())
+        std::clog << "Streaming needs an output path, rendering the whole frame instead\n";
 
-    // Join the threads to wait for them to finish
-    for (std::thread &thread : threads)
+    if (Streaming())
     {
-        thread.join();
+        RenderStreaming(world, pool);
+        std::clog << "\n";
+        pool.PrintStats(std::clog);
+        return;
     }
 
-    output.flushToPPM();
+    image output(image_width_, image_height_, pixel_format_);
+    if (progressive_)
+        RenderProgressive(world, output, pool);
+    else
+        RenderTiles(world, output, pool, true);
+    WriteOutput(output);
+    std::clog << "\n";
+    pool.PrintStats(std::clog);
+
+    if (adaptive_threshold_ > 0)
+        WriteSampleHeatmap();
 }
 
-void MultiThreadCamera::ThreadJob(const HittableGroup &world, const image &output, int& line_ref, std::mutex& mu) {
-    int current_line = -1;
-    while (current_line < image_height_) {
-        mu.lock();
-        current_line = line_ref;
-        line_ref += 1;
-        mu.unlock();
-        if (current_line < image_height_) {
-            RenderScanline(world, output, current_line);
-        }
-        double progress = (double) current_line / image_height_;
-        util::PrintProgress(progress);
-    }
+int MultiThreadCamera::TileSize() const
+{
+    int band = RowsPerBand();
+    return (std::max(tile_size_, 1) + band - 1) / band * band;
 }
 
-void MultiThreadCamera::RenderScanline(const HittableGroup &world, const image &output, const int line)
+void MultiThreadCamera::RenderTiles(const CompiledScene &world, image &output, util::TaskPool &pool,
+                                    bool steal)
 {
-    int pixel_index = line * image_width_;
-    for (int x = 0; x < image_width_; ++x)
-    {
-        color c = RenderPixel(world, x, line);
-        output.buffer()[pixel_index++] = c;
-    }
+    int tile = TileSize();
+    int y_start = output.firstRow();
+    int y_end = y_start + output.height();
+    int tiles_x = (image_width_ + tile - 1) / tile;
+    int tiles_y = (output.height() + tile - 1) / tile;
+    size_t tile_count = size_t(tiles_x) * tiles_y;
+
+    // Tiles are numbered in scanline order, so each thread's initial share is a band of rows.
+    // Progress counts the rows above output as done.
+    pool.Run(tile_count, [&](size_t index, int thread)
+             {
+        int x = int(index % tiles_x) * tile;
+        int y = y_start + int(index / tiles_x) * tile;
+        RenderRegion(world, output, x, std::min(x + tile, image_width_), y, std::min(y + tile, y_end));
+        if (thread == 0)
+        {
+            double rows_done = y_start + output.height() * double(pool.completed()) / tile_count;
+            util::PrintProgress(rows_done / image_height_);
+        } }, steal);
+    util::PrintProgress(double(y_end) / image_height_);
 }
 
-void BatchedMultiThreadCamera::Render(const HittableGroup &world, int num_threads)
+void MultiThreadCamera::RenderStreaming(const CompiledScene &world, util::TaskPool &pool)
 {
-    if (num_threads <= 0)
+    ImageWriter writer(output_path_, image_width_, image_height_, FormatForPath(output_path_));
+    std::unique_ptr<ImageWriter> heatmap;
+    if (adaptive_threshold_ > 0)
+        heatmap.reset(new ImageWriter(sample_heatmap_path_, image_width_, image_height_,
+                                      FormatForPath(sample_heatmap_path_)));
+
+    int tile = TileSize();
+    double total_samples = 0;
+    for (int y = 0; y < image_height_ && writer.ok(); y += tile)
     {
-        return;
-    }
-
-    this->Initialize();
-
-    image output(image_width_, image_height_);
+        int rows = std::min(tile, image_height_ - y);
+        if (heatmap)
+        {
+            sample_counts_.assign(size_t(image_width_) * rows, 0);
+            sample_counts_row_ = y;
+        }
 
-    std::vector<std::thread> threads;
+        image band(image_width_, rows, pixel_format_, y);
+        RenderTiles(world, band, pool, true);
+        writer.write(band);
 
-    int rangeSize = image_height_ / num_threads;
-    for (int i = 0; i < num_threads; i++)
-    {
-        int start = i * rangeSize;
-        int end = (i + 1) * rangeSize - 1;
-        threads.emplace_back(&BatchedMultiThreadCamera::RenderScanlines, *this, world, output, start, end);
-    }
-    if (image_height_ % rangeSize != 0)
-    {
-        int start = image_height_ - (image_height_ % rangeSize);
-        int end = image_height_ - 1;
-        threads.emplace_back(&BatchedMultiThreadCamera::RenderScanlines, *this, world, output, start, end);
+        if (heatmap)
+        {
+            heatmap->write(SampleHeatmap());
+            for (int count : sample_counts_)
+                total_samples += count;
+        }
     }
 
-    // Join the threads to wait for them to finish
-    for (std::thread &thread : threads)
+    if (writer.finish())
+        std::clog << "\nWrote " << output_path_;
+    if (heatmap && heatmap->finish())
     {
-        thread.join();
+        std::clog << "\n";
+        LogSampleAverage(total_samples);
     }
-
-    output.flushToPPM();
 }
 
-void BatchedMultiThreadCamera::RenderScanlines(const HittableGroup &world, const image &output, const int line_start, const int line_end)
+void BatchedMultiThreadCamera::Render(const CompiledScene &world, int num_threads)
 {
-    for (int y = line_start; y <= line_end; ++y)
+    if (num_threads <= 0)
     {
-        RenderScanline(world, output, y);
-        double progress = (double)(y - line_start) / (line_end - line_start);
-        util::PrintProgress(progress);
+        return;
     }
-}
\ No newline at end of file
+
+    this->Initialize(world);
+
+    image output(image_width_, image_height_, pixel_format_);
+    util::TaskPool pool(num_threads);
+    if (progressive_)
+        RenderProgressive(world, output, pool);
+    else
+        RenderTiles(world, output, pool, false);
+    std::clog << "\n";
+    pool.PrintStats(std::clog);
+
+    if (adaptive_threshold_ > 0)
+        WriteSampleHeatmap();
+    WriteOutput(output);
+}
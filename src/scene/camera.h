@@ -1,20 +1,45 @@
 #ifndef CAMERA_H
 #define CAMERA_H
 
-#include <thread>
+#include <cstdint>
 #include <iostream>
-#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "./ptmath/vec3.h"
 #include "./graphics/color.h"
 #include "./graphics/image.h"
+#include "./util/parallel.h"
+#include "./util/sampler.h"
 #include "object/object.h"
+#include "compiled_scene.h"
+#include "light_list.h"
+#include "material.h"
+#include "material_table.h"
+#include "checkpoint.h"
 
 using namespace ptmath;
 
 namespace scene
 {
 
+    // Running estimate of one pixel: the mean of its samples and the variance of their
+    // luminance, updated one sample at a time (Welford).
+    struct PixelEstimate
+    {
+        color sum;
+        int count = 0;
+        double mean = 0, m2 = 0; // Luminance
+
+        void Add(const color &sample);
+        color Mean() const { return count > 0 ? sum / count : color(0, 0, 0); }
+
+        // Likely error of the mean once displayed: the standard error of the luminance, carried
+        // through the gamma curve and the clamp to white of 8-bit image files.
+        double DisplayError() const;
+    };
+
     class Camera
     {
     public:
@@ -22,7 +47,12 @@ namespace scene
         int image_height_ = 200;
 
         int samples_per_pixel_ = 10;
+
+        // Paths bounce at most max_depth_ times. After min_depth_ bounces, Russian roulette ends
+        // them with a probability that grows as their throughput drops, so dark paths stop early.
+        // min_depth_ >= max_depth_ turns it off.
         int max_depth_ = 10;
+        int min_depth_ = 3;
 
         double vfov_ = 90;
 
@@ -30,7 +60,59 @@ namespace scene
         Point3 lookat_ = Point3(0, 0, 0);     // Point camera is looking at
         Vec3 vup_ = Vec3(0, 1, 0);            // Camera-relative "up" direction
 
-        void Render(const HittableGroup &world);
+        // Side of the square pixel tiles whose primary rays are traced together as one RayPacket,
+        // at most 8. Bounces are traced one ray at a time. 0 or 1 disables packets.
+        int packet_size_ = 0;
+
+        // How the random numbers of each pixel's samples are spread, and their seed. Renders with
+        // the same sampler and seed produce the same image, whatever the number of threads.
+        util::SamplerType sampler_type_ = util::SamplerType::kSobol;
+        uint64_t seed_ = 0;
+
+        // Sample the scene's lights directly at diffuse surfaces (next event estimation), and
+        // weigh those samples against hitting the lights by chance with multiple importance
+        // sampling.
+        bool light_sampling_ = true;
+
+        // File the rendered image is written to, in the format its extension names (see
+        // FormatForPath): .png, .pfm for the linear HDR values, or binary .ppm. When empty, the
+        // image is written to standard output as a text PPM.
+        std::string output_path_;
+
+        // Precision of the pixels held in memory until the image is written.
+        PixelFormat pixel_format_ = PixelFormat::kDouble;
+
+        // Adaptive sampling, off when adaptive_threshold_ is 0. Every pixel takes
+        // samples_per_pixel_ samples, then keeps taking as many more, up to
+        // max_samples_per_pixel_, while PixelEstimate::DisplayError is above the threshold (0.01
+        // is about 2.5 of 255 levels). The number of samples of each pixel is written as a heatmap to
+        // sample_heatmap_path_. WavefrontCamera always takes samples_per_pixel_.
+        double adaptive_threshold_ = 0;
+        int max_samples_per_pixel_ = 256;
+        std::string sample_heatmap_path_ = "samples.ppm";
+
+        // Progressive rendering: the whole image is rendered one sample per pixel at a time into
+        // an accumulation buffer, for up to samples_per_pixel_ passes. Rendering stops early
+        // once time_budget_seconds_ of wall time have gone, even in the middle of a pass, or once
+        // the average PixelEstimate::DisplayError is below target_error_ (0 disables either).
+        // The image so far is written to snapshot_path_ every snapshot_interval_seconds_.
+        // Adaptive sampling does not apply.
+        bool progressive_ = false;
+        double time_budget_seconds_ = 0;
+        double target_error_ = 0;
+        double snapshot_interval_seconds_ = 5;
+        std::string snapshot_path_ = "progress.ppm";
+
+        // With checkpoint_path_ set, a progressive render saves its accumulation buffer there
+        // every checkpoint_interval_seconds_ and when it stops, and resumes from it if a
+        // checkpoint of a render with the same settings is already there. The resumed render
+        // ends up exactly as if it had never stopped. A moved camera, or a scene whose objects,
+        // material parameters or BVH builder hash differently, starts over. Materials outside
+        // the closed set of MaterialRecord are only told apart by type.
+        std::string checkpoint_path_;
+        double checkpoint_interval_seconds_ = 60;
+
+        void Render(const CompiledScene &world);
 
     protected:
         double aspect_ratio_;
@@ -41,43 +123,145 @@ namespace scene
         Point3 viewport_upper_left;
         Point3 viewport_center;
 
-        void Initialize();
+        std::shared_ptr<util::Sampler> sampler_;
+        LightList lights_;
+
+        // Samples taken by each pixel, in image order, kept for adaptive and progressive renders.
+        // Streaming renders keep only the rows of the band in progress, from sample_counts_row_ on.
+        std::vector<int> sample_counts_;
+        int sample_counts_row_ = 0;
 
-        color RenderPixel(const HittableGroup &world, int i, int j);
+        void Initialize(const CompiledScene &world);
 
-        ray GetRayForPixel(const int i, const int j);
+        // Whether the image is written band by band rather than held whole.
+        virtual bool Streaming() const { return false; }
 
-        color RenderRay(const ray &r, const HittableGroup &world)
+        // Number of rows rendered together, so that packet tiles are not cut short.
+        int RowsPerBand() const { return packet_size_ > 1 ? packet_size_ : 1; }
+
+        // Renders rows [y_start, y_end) of the image into output.
+        void RenderRows(const CompiledScene &world, image &output, int y_start, int y_end)
         {
-            return RenderRay(r, world, max_depth_);
+            RenderRegion(world, output, 0, image_width_, y_start, y_end);
         }
-        color RenderRay(const ray &r, const HittableGroup &world, const int depth);
+
+        // Renders the pixels [x_start, x_end) x [y_start, y_end) into output.
+        void RenderRegion(const CompiledScene &world, image &output, int x_start, int x_end, int y_start,
+                          int y_end);
+
+        // Renders the pixels [x_start, x_end) x [y_start, y_end) as one ray packet per sample.
+        void RenderTile(const CompiledScene &world, image &output, int x_start, int x_end, int y_start,
+                        int y_end);
+
+        color RenderPixel(const CompiledScene &world, int i, int j);
+
+        // Color of sample `index` of pixel (i, j).
+        color RenderSample(const CompiledScene &world, int i, int j, int index);
+
+        // Adds samples to estimate as adaptive sampling asks, records the pixel's sample count
+        // and returns its color.
+        color FinishPixel(const CompiledScene &world, int i, int j, PixelEstimate &estimate);
+
+        // Renders the image progressively into output, running each pass on pool.
+        void RenderProgressive(const CompiledScene &world, image &output, util::TaskPool &pool);
+
+        // Writes the means of estimates to output and their counts to sample_counts_.
+        void ResolveEstimates(const std::vector<PixelEstimate> &estimates, image &output);
+
+        // The settings a checkpoint must have been written with to resume this render of world.
+        RenderKey CheckpointKey(const CompiledScene &world) const;
+
+        // Writes output to snapshot_path_, replacing the previous snapshot whole.
+        void WriteSnapshot(const image &output) const;
+
+        // Writes the finished image where output_path_ says.
+        void WriteOutput(const image &output) const;
+
+        // The rows of sample_counts_ as a heatmap, from blue for samples_per_pixel_ through green
+        // to red for max_samples_per_pixel_.
+        image SampleHeatmap() const;
+
+        // Writes the heatmap of the whole frame's sample_counts_ to sample_heatmap_path_, and
+        // logs the average.
+        void WriteSampleHeatmap() const;
+
+        void LogSampleAverage(double total_samples) const;
+
+        // Random numbers of sample `index` of pixel (i, j).
+        util::PixelSampler SamplePixel(int i, int j, int index) const
+        {
+            return util::PixelSampler(sampler_.get(), i, j, index);
+        }
+
+        ray GetRayForPixel(const int i, const int j, util::PixelSampler &sampler);
+
+        // Color seen along r, following the path bounce by bounce. first_hit, if given, is the
+        // closest hit of r, already found.
+        color RenderRay(ray r, const CompiledScene &world, util::PixelSampler &sampler,
+                        const HitRecord *first_hit = nullptr);
+
+        // RenderRay with the materials reached as M: MaterialRecord, or Material for scenes
+        // compiled with Dispatch::kVirtual.
+        template <typename M>
+        color TracePath(ray r, const CompiledScene &world, util::PixelSampler &sampler, const HitRecord *first_hit);
+
+        // Russian roulette after the bounce at vertex depth (0 for the camera ray's hit): returns
+        // false if the path ends there, and otherwise scales throughput so the estimate stays
+        // unbiased.
+        bool SurvivesRoulette(color &throughput, int depth, util::PixelSampler &sampler) const;
+
+        // Light arriving at rec straight from a sampled light, scattered by mat back along r.
+        template <typename M>
+        color SampleDirect(const ray &r, const HitRecord &rec, const M &mat, const CompiledScene &world,
+                           util::PixelSampler &sampler);
+
+        color Background(const ray &r) const;
 
     };
 
     /**
-     * Threads take threads as they go until all lines are rendered
+     * Renders the image as square tiles spread over a pool of threads, which steal tiles from
+     * each other as they run out, and reports how busy each thread was
     */
     class MultiThreadCamera : public Camera
     {
     public:
-        void Render(const HittableGroup &world, const int num_threads);
-    private:
-        void ThreadJob(const HittableGroup &world, const image &output, int& line_ref, std::mutex& mu);
+        // Side of the tiles, rounded up to a whole number of packet tiles.
+        int tile_size_ = 16;
+
+        // Render one row of tiles at a time and append it to output_path_ as soon as it is done,
+        // so that only that band of the frame is ever in memory. Needs output_path_, and does
+        // not apply to progressive renders, which accumulate the whole frame. Adaptive renders
+        // stream their sample heatmap the same way.
+        bool stream_output_ = false;
+
+        void Render(const CompiledScene &world, const int num_threads);
+
+        // Renders on the threads of pool, e.g. the one that built the scene's BVHs.
+        void Render(const CompiledScene &world, util::TaskPool &pool);
+
     protected:
-        void RenderScanline(const HittableGroup &world, const image &output, const int line);
+        bool Streaming() const override { return stream_output_ && !output_path_.empty() && !progressive_; }
+
+        int TileSize() const;
+
+        // Renders all tiles of output, a frame or a band of it, on pool; without stealing each
+        // thread only renders its own band of tiles.
+        void RenderTiles(const CompiledScene &world, image &output, util::TaskPool &pool, bool steal);
+
+        // Renders the frame band by band into output_path_, and the heatmap of adaptive renders
+        // band by band into sample_heatmap_path_.
+        void RenderStreaming(const CompiledScene &world, util::TaskPool &pool);
     };
 
     /**
-     * Each thread is assigned a sector of the image to render at the beginning
+     * Each thread is assigned a sector of the image to render at the beginning and never steals,
+     * which shows how much the scheduling of MultiThreadCamera gains
     */
     class BatchedMultiThreadCamera : public MultiThreadCamera
     {
     public:
-        void Render(const HittableGroup &world, const int num_threads);
-
-    protected:
-        void RenderScanlines(const HittableGroup &world, const image &output, const int line_start, const int line_end);
+        void Render(const CompiledScene &world, const int num_threads);
     };
 
 }
@@ -0,0 +1,93 @@
+#include "checkpoint.h"
+#include "camera.h"
+
+#include "./util/mapped_file.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+#include <unistd.h>
+
+using namespace scene;
+
+namespace
+{
+    const char kCheckpointMagic[8] = {'P', 'T', 'C', 'K', 'P', 'T', 0, 0};
+    const uint32_t kCheckpointVersion = 3;
+    const uint64_t kPixelsOffset = 256;
+
+    struct CheckpointHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t estimate_size; // sizeof(PixelEstimate), so checkpoints from other builds are rejected
+        RenderKey key;
+        uint64_t count;
+        uint64_t offset;
+    };
+
+    static_assert(sizeof(CheckpointHeader) <= kPixelsOffset, "checkpoint header overlaps the pixels");
+    static_assert(std::is_trivially_copyable<PixelEstimate>::value, "estimates are saved as raw bytes");
+}
+
+bool scene::WriteCheckpoint(const std::string &path, const RenderKey &key, const PixelEstimate *estimates,
+                            size_t count)
+{
+    CheckpointHeader header = {};
+    memcpy(header.magic, kCheckpointMagic, sizeof(kCheckpointMagic));
+    header.version = kCheckpointVersion;
+    header.estimate_size = sizeof(PixelEstimate);
+    header.key = key;
+    header.count = count;
+    header.offset = kPixelsOffset;
+
+    // Write to a temporary file and rename it into place, so that a job preempted while writing
+    // still finds the previous checkpoint.
+    std::string tmp_path = path + ".tmp";
+    FILE *file = fopen(tmp_path.c_str(), "wb");
+    if (!file)
+    {
+        std::clog << "Could not write checkpoint " << path << "\n";
+        return false;
+    }
+
+    static const char kZeros[kPixelsOffset] = {};
+    size_t bytes = count * sizeof(PixelEstimate);
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok &= fwrite(kZeros, 1, kPixelsOffset - sizeof(header), file) == kPixelsOffset - sizeof(header);
+    ok &= bytes == 0 || fwrite(estimates, 1, bytes, file) == bytes;
+    ok &= fflush(file) == 0 && fsync(fileno(file)) == 0;
+    ok &= fclose(file) == 0;
+
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0)
+    {
+        std::clog << "Could not write checkpoint " << path << "\n";
+        remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool scene::ReadCheckpoint(const std::string &path, const RenderKey &key, PixelEstimate *estimates, size_t count)
+{
+    auto file = util::MappedFile::Open(path);
+    if (!file || file->size() < sizeof(CheckpointHeader))
+        return false;
+
+    CheckpointHeader header;
+    memcpy(&header, file->data(), sizeof(header));
+    if (memcmp(header.magic, kCheckpointMagic, sizeof(kCheckpointMagic)) != 0 ||
+        header.version != kCheckpointVersion || header.estimate_size != sizeof(PixelEstimate))
+        return false;
+
+    if (!(header.key == key) || header.count != count || header.offset > file->size() ||
+        header.count > (file->size() - header.offset) / sizeof(PixelEstimate))
+    {
+        std::clog << "Checkpoint " << path << " belongs to another render, ignoring it\n";
+        return false;
+    }
+
+    memcpy(static_cast<void *>(estimates), file->data() + header.offset, count * sizeof(PixelEstimate));
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace scene
+{
+
+    struct PixelEstimate;
+
+    // The settings a checkpoint was rendered with, and a hash of its scene. Resuming with any
+    // other would mix samples of different images.
+    struct RenderKey
+    {
+        int64_t width, height;
+        int64_t samples_per_pixel;
+        int64_t max_depth, min_depth;
+        int64_t sampler_type;
+        int64_t light_sampling;
+        uint64_t seed;
+
+        double look_from[3], lookat[3], vup[3];
+        double vfov;
+
+        int64_t dispatch;
+        uint64_t object_count, material_count;
+        uint64_t scene_hash; // CompiledScene::ContentHash
+
+        bool operator==(const RenderKey &other) const
+        {
+            for (int a = 0; a < 3; a++)
+            {
+                if (look_from[a] != other.look_from[a] || lookat[a] != other.lookat[a] || vup[a] != other.vup[a])
+                    return false;
+            }
+            return width == other.width && height == other.height && samples_per_pixel == other.samples_per_pixel &&
+                   max_depth == other.max_depth && min_depth == other.min_depth &&
+                   sampler_type == other.sampler_type && light_sampling == other.light_sampling &&
+                   seed == other.seed && vfov == other.vfov && dispatch == other.dispatch &&
+                   object_count == other.object_count && material_count == other.material_count &&
+                   scene_hash == other.scene_hash;
+        }
+    };
+
+    // Saves the accumulation buffer of a progressive render to path, replacing any previous
+    // checkpoint whole. The file is a fixed header followed by the estimates exactly as they
+    // are laid out in memory, on a 64-byte boundary, so it can be mapped and used in place.
+    bool WriteCheckpoint(const std::string &path, const RenderKey &key, const PixelEstimate *estimates,
+                         size_t count);
+
+    // Loads the count estimates saved to path by a render with the same key. Returns false,
+    // leaving estimates untouched, if there is no such checkpoint.
+    bool ReadCheckpoint(const std::string &path, const RenderKey &key, PixelEstimate *estimates, size_t count);
+
+}
+
+#endif
@@ -0,0 +1,77 @@
+#include "compiled_scene.h"
+#include "object/mesh.h"
+
+using namespace scene;
+
+namespace
+{
+    // Interns the materials of world's objects into materials, which the objects' hit records
+    // refer to from then on. The BVH copies some objects, so it has to come afterwards.
+    const HittableGroup &InternWorldMaterials(const HittableGroup &world, MaterialTable &materials)
+    {
+        for (const auto &object : world.objects)
+            object->InternMaterials(materials);
+        return world;
+    }
+}
+
+CompiledScene::CompiledScene(const HittableGroup &world, Dispatch dispatch, const BvhBuildOptions &build,
+                             Clock::time_point start)
+    : dispatch_(dispatch), bvh_(InternWorldMaterials(world, materials_), dispatch, build),
+      builder_(build.builder)
+{
+    lights_.Collect(bvh_, materials_);
+    build_seconds_ = std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+uint64_t CompiledScene::ContentHash() const
+{
+    util::Hash hash;
+    hash.Add(uint32_t(builder_));
+    hash.Add(bvh_.wide_bvh().empty());
+    bvh_.HashContent(hash);
+    materials_.HashContent(hash);
+    return hash.value();
+}
+
+size_t CompiledScene::memory_usage() const
+{
+    size_t bytes = bvh_.memory_usage() + materials_.memory_usage();
+    for (const auto &object : bvh_.objects())
+    {
+        if (auto mesh = dynamic_cast<const Mesh *>(object.get()))
+            bytes += mesh->memory_usage();
+    }
+    return bytes;
+}
+
+void CompiledScene::PrintStats(std::ostream &out) const
+{
+    out << "Scene: " << object_count() << " objects, " << material_count() << " materials, "
+        << lights_.size() << " lights, compiled in " << build_seconds_ * 1e3 << " ms, "
+        << memory_usage() / 1024 << " KiB\n";
+    out << "  BVH (" << BvhBuilderName(builder_) << "): " << bvh_.bvh().nodes().size() << " nodes, built in "
+        << bvh_.bvh().build_seconds() * 1e3 << " ms, SAH cost " << bvh_.bvh().SahCost(LinearBvh::kSimdLeaves)
+        << "\n";
+    if (!bvh_.wide_bvh().empty())
+        out << "  wide BVH: " << bvh_.wide_bvh().node_count() << " nodes, "
+            << bvh_.wide_bvh().memory_usage() / 1024 << " KiB\n";
+
+    for (const auto &object : bvh_.objects())
+    {
+        auto mesh = dynamic_cast<const Mesh *>(object.get());
+        if (!mesh)
+            continue;
+        out << "  mesh BVH (" << BvhBuilderName(mesh->bvh_builder()) << "): " << mesh->triangle_count()
+            << " triangles, " << mesh->bvh().nodes().size() << " nodes, ";
+        if (mesh->from_cache())
+            out << "from cache";
+        else
+            out << "built in " << mesh->bvh().build_seconds() * 1e3 << " ms";
+        out << ", SAH cost " << mesh->bvh().SahCost(LinearBvh::kSimdLeaves) << "\n";
+        if (!mesh->wide_bvh().empty())
+            out << "  mesh wide BVH: " << mesh->wide_bvh().node_count() << " nodes, "
+                << mesh->wide_bvh().memory_usage() / 1024 << " KiB against "
+                << mesh->bvh().nodes().size() * sizeof(LinearBvhNode) / 1024 << " KiB binary\n";
+    }
+}
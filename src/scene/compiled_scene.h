@@ -0,0 +1,84 @@
+#ifndef COMPILED_SCENE_H
+#define COMPILED_SCENE_H
+
+#include <chrono>
+#include <iostream>
+
+#include "./ptmath/vec3.h"
+#include "./ptmath/ray.h"
+#include "object/object.h"
+#include "object/linear_bvh.h"
+#include "light_list.h"
+#include "material_table.h"
+
+namespace scene
+{
+
+    /**
+     * The scene as the cameras render it: compiled once from the HittableGroup that a scene
+     * function fills in, then read-only, so that every render thread shares one copy by reference.
+     * Nested groups are flattened into a single LinearBvhGroup that owns the objects, their
+     * materials are interned into a MaterialTable of the scene's own, and the lights are collected
+     * up front. Objects keep the material ids of the scene compiled from them last; compiling the
+     * same group again hands out the same ids, but an object shared with a different scene must
+     * not be rendered through both. The dispatch setting picks how the cameras reach its
+     * primitives and materials, and build how its BVH is built; meshes build their own when they
+     * are loaded.
+    */
+    class CompiledScene final : public Hittable
+    {
+    public:
+        explicit CompiledScene(const HittableGroup &world, Dispatch dispatch = Dispatch::kClosedSet,
+                               const BvhBuildOptions &build = BvhBuildOptions())
+            : CompiledScene(world, dispatch, build, Clock::now()) {}
+
+        // Copies would only duplicate the acceleration structure; pass it by reference.
+        CompiledScene(const CompiledScene &) = delete;
+        CompiledScene &operator=(const CompiledScene &) = delete;
+
+        bool hit(const ray &r, interval ray_t, HitRecord &rec) const override { return bvh_.hit(r, ray_t, rec); }
+        void hit_packet(RayPacket &packet) const override { bvh_.hit_packet(packet); }
+        aabb bounding_box() const override { return bvh_.bounding_box(); }
+
+        const LinearBvhGroup &bvh() const { return bvh_; }
+        const LightList &lights() const { return lights_; }
+        const MaterialTable &materials() const { return materials_; }
+        Dispatch dispatch() const { return dispatch_; }
+        size_t object_count() const { return bvh_.objects().size(); }
+
+        // Distinct materials of the scene's objects.
+        size_t material_count() const { return materials_.size(); }
+
+        double build_seconds() const { return build_seconds_; }
+
+        // Hash of the objects, their materials' parameters and how the BVH was built, which a
+        // checkpoint keeps to tell its scene apart from an edited one. It goes through every
+        // mesh array, so it is computed on each call rather than with the scene.
+        uint64_t ContentHash() const;
+
+        // Bytes of the acceleration structure, the material table and the meshes; other objects
+        // are not counted.
+        size_t memory_usage() const;
+
+        // Logs the object, material and light counts, the build time and the memory usage, and
+        // how each BVH was built and its SAH cost.
+        void PrintStats(std::ostream &out) const;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        Dispatch dispatch_;
+        MaterialTable materials_; // Filled before bvh_ copies the objects
+        LinearBvhGroup bvh_;
+        LightList lights_;
+        double build_seconds_;
+
+        BvhBuilder builder_;
+
+        CompiledScene(const HittableGroup &world, Dispatch dispatch, const BvhBuildOptions &build,
+                      Clock::time_point start);
+    };
+
+}
+
+#endif
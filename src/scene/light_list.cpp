@@ -0,0 +1,174 @@
+#include "light_list.h"
+
+#include "./util/util.h"
+#include "object/quad.h"
+#include "object/sphere.h"
+#include "object/linear_bvh.h"
+#include "material.h"
+#include "material_table.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace scene;
+using namespace ptmath;
+
+void LightList::Collect(const Hittable &object, const MaterialTable &materials)
+{
+    if (auto group = dynamic_cast<const HittableGroup *>(&object))
+    {
+        for (const auto &child : group->objects)
+            Collect(*child, materials);
+    }
+    else if (auto bvh = dynamic_cast<const LinearBvhGroup *>(&object))
+    {
+        for (const auto &child : bvh->objects())
+            Collect(*child, materials);
+    }
+    else if (auto q = dynamic_cast<const quad *>(&object))
+    {
+        auto light = dynamic_cast<const scene::Light *>(materials.Get(q->get_material()));
+        if (!light)
+            return;
+
+        Vec3 n = cross(q->get_u(), q->get_v());
+        lights_.push_back({false, q->get_q(), q->get_u(), q->get_v(), unit_vector(n), n.length(), 0,
+                           light->Emit(ray(), HitRecord()), q->get_material()});
+    }
+    else if (auto s = dynamic_cast<const sphere *>(&object))
+    {
+        auto light = dynamic_cast<const scene::Light *>(materials.Get(s->get_material()));
+        if (!light)
+            return;
+
+        lights_.push_back({true, s->get_center(), Vec3(), Vec3(), Vec3(), 0, s->get_radius(),
+                           light->Emit(ray(), HitRecord()), s->get_material()});
+    }
+}
+
+bool LightList::Contains(MaterialId material) const
+{
+    for (const Light &light : lights_)
+        if (light.material == material)
+            return true;
+    return false;
+}
+
+bool LightList::Sample(const Point3 &origin, util::PixelSampler &sampler, LightSample &sample) const
+{
+    if (lights_.empty())
+        return false;
+
+    // Draw both dimensions even when the light turns out to be unusable, so that later
+    // dimensions keep their meaning.
+    int count = int(lights_.size());
+    const Light &light = lights_[std::min(int(sampler.Get1D() * count), count - 1)];
+    util::Sample2 s = sampler.Get2D();
+
+    bool valid = light.is_sphere ? SampleSphere(light, origin, s, sample) : SampleQuad(light, origin, s, sample);
+    if (!valid)
+        return false;
+
+    // Other lights may cover the same direction.
+    sample.pdf = count > 1 ? Pdf(origin, sample.direction) : sample.pdf / count;
+    sample.emission = light.emission;
+    return sample.pdf > 0;
+}
+
+double LightList::Pdf(const Point3 &origin, const Vec3 &direction) const
+{
+    if (lights_.empty())
+        return 0;
+
+    double sum = 0;
+    for (const Light &light : lights_)
+        sum += light.is_sphere ? SpherePdf(light, origin, direction) : QuadPdf(light, origin, direction);
+    return sum / lights_.size();
+}
+
+bool LightList::SampleQuad(const Light &light, const Point3 &origin, util::Sample2 s, LightSample &sample) const
+{
+    Point3 point = light.position + s.u * light.u + s.v * light.v;
+    Vec3 to_light = point - origin;
+    double distance_squared = to_light.length_squared();
+    double distance = sqrt(distance_squared);
+    Vec3 direction = to_light / distance;
+
+    double cos_light = fabs(dot(light.normal, direction));
+    if (cos_light < 1e-8)
+        return false;
+
+    sample.direction = direction;
+    sample.distance = distance;
+    sample.pdf = distance_squared / (cos_light * light.area);
+    return true;
+}
+
+double LightList::QuadPdf(const Light &light, const Point3 &origin, const Vec3 &direction) const
+{
+    double denom = dot(light.normal, direction);
+    if (fabs(denom) < 1e-8)
+        return 0;
+
+    double t = dot(light.normal, light.position - origin) / denom;
+    if (t <= 0)
+        return 0;
+
+    // Plane coordinates of the hit point, as in quad::hit.
+    Vec3 n = cross(light.u, light.v);
+    Vec3 w = n / dot(n, n);
+    Vec3 p = origin + t * direction - light.position;
+    double alpha = dot(w, cross(p, light.v));
+    double beta = dot(w, cross(light.u, p));
+    if (alpha < 0 || alpha > 1 || beta < 0 || beta > 1)
+        return 0;
+
+    double distance_squared = t * t * direction.length_squared();
+    double cos_light = fabs(denom) / direction.length();
+    return distance_squared / (cos_light * light.area);
+}
+
+bool LightList::SampleSphere(const Light &light, const Point3 &origin, util::Sample2 s, LightSample &sample) const
+{
+    Vec3 to_center = light.position - origin;
+    double distance_squared = to_center.length_squared();
+    double radius_squared = light.radius * light.radius;
+    if (distance_squared <= radius_squared) // Inside the light: the cone is not defined
+        return false;
+
+    // Uniform direction in the cone around to_center that the sphere fills.
+    double cos_max = sqrt(1 - radius_squared / distance_squared);
+    double cos_theta = 1 - s.u * (1 - cos_max);
+    double sin_theta = sqrt(std::max(0.0, 1 - cos_theta * cos_theta));
+    double phi = 2 * kPi * s.v;
+
+    Vec3 w = unit_vector(to_center);
+    Vec3 a = fabs(w.x()) > 0.9 ? Vec3(0, 1, 0) : Vec3(1, 0, 0);
+    Vec3 v = unit_vector(cross(w, a));
+    Vec3 u = cross(w, v);
+    Vec3 direction = sin_theta * cos(phi) * u + sin_theta * sin(phi) * v + cos_theta * w;
+
+    // Distance to the near side of the sphere along direction.
+    double along = dot(direction, to_center);
+    double half_chord = sqrt(std::max(0.0, radius_squared - (distance_squared - along * along)));
+
+    sample.direction = direction;
+    sample.distance = along - half_chord;
+    sample.pdf = 1 / (2 * kPi * (1 - cos_max));
+    return true;
+}
+
+double LightList::SpherePdf(const Light &light, const Point3 &origin, const Vec3 &direction) const
+{
+    Vec3 to_center = light.position - origin;
+    double distance_squared = to_center.length_squared();
+    double radius_squared = light.radius * light.radius;
+    if (distance_squared <= radius_squared)
+        return 0;
+
+    double cos_max = sqrt(1 - radius_squared / distance_squared);
+    double cos_direction = dot(to_center, direction) / (sqrt(distance_squared) * direction.length());
+    if (cos_direction < cos_max)
+        return 0;
+    return 1 / (2 * kPi * (1 - cos_max));
+}
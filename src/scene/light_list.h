@@ -0,0 +1,80 @@
+#ifndef LIGHT_LIST_H
+#define LIGHT_LIST_H
+
+#include <vector>
+
+#include "./ptmath/vec3.h"
+#include "./graphics/color.h"
+#include "./util/sampler.h"
+#include "object/object.h"
+
+namespace scene
+{
+
+    class Material;
+
+    // A point picked on a light, as seen from the point being shaded.
+    struct LightSample
+    {
+        Vec3 direction;  // Unit vector towards the light
+        double distance; // Along direction, to the picked point
+        double pdf;      // Solid-angle density of direction, counting the choice of light
+        color emission;
+    };
+
+    /**
+     * The emitters of a scene that can be sampled directly: every quad and sphere whose material
+     * is a Light. Sampling picks one of them uniformly, then a point on a quad uniformly by area
+     * or a direction towards a sphere uniformly within the cone it subtends.
+    */
+    class LightList
+    {
+    public:
+        // Adds the lights found in object, looking through groups and BVHs, with the materials
+        // their ids refer to.
+        void Collect(const Hittable &object, const MaterialTable &materials);
+        void Clear() { lights_.clear(); }
+
+        bool empty() const { return lights_.empty(); }
+        size_t size() const { return lights_.size(); }
+
+        // Whether material belongs to a light that Sample can pick.
+        bool Contains(MaterialId material) const;
+
+        // Picks a light and a direction towards it from origin, drawing one 1D and one 2D
+        // dimension of sampler. Returns false when the pick cannot contribute.
+        bool Sample(const Point3 &origin, util::PixelSampler &sampler, LightSample &sample) const;
+
+        // Density with which Sample picks direction from origin.
+        double Pdf(const Point3 &origin, const Vec3 &direction) const;
+
+    private:
+        struct Light
+        {
+            bool is_sphere;
+            Point3 position; // Quad corner or sphere center
+            Vec3 u, v;       // Quad edges
+            Vec3 normal;     // Quad normal
+            double area;     // Quad area
+            double radius;   // Sphere radius
+            color emission;
+            MaterialId material;
+        };
+
+        std::vector<Light> lights_;
+
+        bool SampleQuad(const Light &light, const Point3 &origin, util::Sample2 s, LightSample &sample) const;
+        bool SampleSphere(const Light &light, const Point3 &origin, util::Sample2 s, LightSample &sample) const;
+        double QuadPdf(const Light &light, const Point3 &origin, const Vec3 &direction) const;
+        double SpherePdf(const Light &light, const Point3 &origin, const Vec3 &direction) const;
+    };
+
+    // Power heuristic weight of a sample drawn with density pdf when other_pdf could also draw it.
+    inline double PowerHeuristic(double pdf, double other_pdf)
+    {
+        return pdf * pdf / (pdf * pdf + other_pdf * other_pdf);
+    }
+
+}
+
+#endif
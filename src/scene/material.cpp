@@ -1,55 +1,92 @@
 #include "./ptmath/vec3.h"
+#include "./util/util.h"
 #include "material.h"
 
+#include <typeinfo>
+
 using namespace scene;
 using namespace ptmath;
 
-bool Lambertian::Scatter(const ray &r_in, const HitRecord &rec, color &attenuation, ray &scattered)
-    const
+namespace
 {
-    auto scatter_direction = rec.normal + random_unit_vector();
-    scattered = ray(rec.p, scatter_direction);
-    attenuation = albedo_;
-    return true;
+    // Only exact types get a closed-set record: a subclass could override what the record skips.
+    template <typename T>
+    MaterialRecord MakeRecord(const T *material, MaterialRecord::Kind kind, const color &albedo,
+                              const color &albedo2 = color(), double param = 0)
+    {
+        MaterialRecord record = material->Material::ToRecord();
+        if (typeid(*material) != typeid(T))
+            return record;
+
+        record.kind = kind;
+        record.albedo = albedo;
+        record.albedo2 = albedo2;
+        record.param = param;
+        return record;
+    }
 }
 
-bool CheckeredLambertian::Scatter(const ray &r_in, const HitRecord &rec, color &attenuation, ray &scattered)
-    const
+// Diffuse
+
+bool DiffuseMaterial::Sample([[maybe_unused]] const ray &r_in, const HitRecord &rec, util::PixelSampler &sampler,
+                             BsdfSample &sample) const
 {
-    auto scatter_direction = rec.normal + random_unit_vector();
-    scattered = ray(rec.p, scatter_direction);
+    return SampleAlbedo(Albedo(rec), rec, sampler, sample);
+}
 
-    Point3 p = (1 / scale_) * rec.p;
-    auto sum = ((int)p.x() + (int)p.y() + (int)p.z());
-    attenuation = sum % 2 != 0 ? albedo_1_ : albedo_2_;
+color DiffuseMaterial::Eval([[maybe_unused]] const ray &r_in, const HitRecord &rec, const Vec3 &direction) const
+{
+    return EvalAlbedo(Albedo(rec), rec, direction);
+}
 
-    return true;
+double DiffuseMaterial::Pdf([[maybe_unused]] const ray &r_in, const HitRecord &rec, const Vec3 &direction) const
+{
+    return CosinePdf(rec, direction);
 }
 
-bool Metal::Scatter(const ray &r_in, const HitRecord &rec, color &attenuation, ray &scattered)
-    const
+MaterialRecord Lambertian::ToRecord() const
 {
-    Vec3 reflected = reflect(unit_vector(r_in.direction()), rec.normal);
-    scattered = ray(rec.p, reflected);
-    attenuation = albedo_;
-    return true;
+    return MakeRecord(this, MaterialRecord::kLambertian, albedo_);
 }
 
-bool Dielectric::Scatter(const ray &r_in, const HitRecord &rec, color &attenuation, ray &scattered)
-    const
+color CheckeredLambertian::Albedo(const HitRecord &rec) const
 {
-    attenuation = .9 * color(1.0, 1.0, 1.0);
-    double refraction_ratio = rec.front_face ? (1.0 / ir) : ir;
+    return Checker(scale_, albedo_1_, albedo_2_, rec);
+}
 
-    Vec3 unit_direction = unit_vector(r_in.direction());
-    Vec3 refracted = refract(unit_direction, rec.normal, refraction_ratio);
+MaterialRecord CheckeredLambertian::ToRecord() const
+{
+    return MakeRecord(this, MaterialRecord::kCheckered, albedo_1_, albedo_2_, scale_);
+}
+
+// Special Properties
 
-    scattered = ray(rec.p, refracted);
+bool Metal::Sample(const ray &r_in, const HitRecord &rec, [[maybe_unused]] util::PixelSampler &sampler,
+                   BsdfSample &sample) const
+{
+    Reflect(albedo_, r_in, rec, sample);
     return true;
 }
 
-bool Light::Scatter([[maybe_unused]] const ray &r_in, [[maybe_unused]] const HitRecord &rec, [[maybe_unused]] color &attenuation, [[maybe_unused]] ray &scattered)
-    const
+MaterialRecord Metal::ToRecord() const
+{
+    return MakeRecord(this, MaterialRecord::kMetal, albedo_);
+}
+
+bool Dielectric::Sample(const ray &r_in, const HitRecord &rec, util::PixelSampler &sampler,
+                        BsdfSample &sample) const
+{
+    Scatter(ir, r_in, rec, sampler, sample);
+    return true;
+}
+
+MaterialRecord Dielectric::ToRecord() const
+{
+    return MakeRecord(this, MaterialRecord::kDielectric, color(), color(), ir);
+}
+
+bool Light::Sample([[maybe_unused]] const ray &r_in, [[maybe_unused]] const HitRecord &rec,
+                   [[maybe_unused]] util::PixelSampler &sampler, [[maybe_unused]] BsdfSample &sample) const
 {
     return false;
 }
@@ -57,4 +94,9 @@ bool Light::Scatter([[maybe_unused]] const ray &r_in, [[maybe_unused]] const Hit
 color Light::Emit([[maybe_unused]] const ray &r_in, [[maybe_unused]] const HitRecord &rec) const
 {
     return albedo_;
-}
\ No newline at end of file
+}
+
+MaterialRecord Light::ToRecord() const
+{
+    return MakeRecord(this, MaterialRecord::kLight, albedo_);
+}
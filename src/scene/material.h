@@ -4,47 +4,139 @@
 #include "./ptmath/vec3.h"
 #include "./ptmath/ray.h"
 #include "./graphics/color.h"
+#include "./util/sampler.h"
 #include "object/object.h"
 
+#include <cstdint>
+
 using namespace ptmath;
 
 namespace scene
 {
 
+    struct MaterialRecord;
+
+    // A direction picked by Material::Sample.
+    struct BsdfSample
+    {
+        Vec3 direction;
+        color value;      // BSDF times the cosine of direction with the normal
+        double pdf;       // Solid-angle density of direction
+        bool is_specular; // Picked from a finite set of directions; value / pdf is still the weight
+    };
+
+    /**
+     * How a surface scatters and emits light. Sample picks an incoming light direction for a path
+     * arriving along r_in; Eval and Pdf give the value and density Sample would have for any
+     * given direction, which is what light sampling needs. Specular materials return 0 from both.
+    */
     class Material
     {
     public:
         virtual ~Material() = default;
 
-        virtual bool Scatter(
-            const ray &r_in, const HitRecord &rec, color &attenuation, ray &scattered) const = 0;
+        // Returns false if the path ends here. Random choices draw the next dimensions of sampler.
+        virtual bool Sample(const ray &r_in, const HitRecord &rec, util::PixelSampler &sampler,
+                            BsdfSample &sample) const = 0;
+
+        virtual color Eval([[maybe_unused]] const ray &r_in, [[maybe_unused]] const HitRecord &rec,
+                           [[maybe_unused]] const Vec3 &direction) const
+        {
+            return color(0, 0, 0);
+        }
+
+        virtual double Pdf([[maybe_unused]] const ray &r_in, [[maybe_unused]] const HitRecord &rec,
+                           [[maybe_unused]] const Vec3 &direction) const
+        {
+            return 0;
+        }
 
         virtual color Emit(
             [[maybe_unused]] const ray &r_in, [[maybe_unused]] const HitRecord &rec) const
         {
             return color(0, 0, 0);
         }
+
+        // This material as plain data, for MaterialTable. Only the built-in materials have a
+        // closed-set form; others are forwarded to through a kVirtual record.
+        virtual MaterialRecord ToRecord() const;
     };
 
     // Solid Materials
 
-    class Lambertian : public Material
+    /**
+     * Ideal diffuse reflection of albedo(rec), importance sampled by cosine.
+    */
+    class DiffuseMaterial : public Material
+    {
+    public:
+        bool Sample(const ray &r_in, const HitRecord &rec, util::PixelSampler &sampler,
+                    BsdfSample &sample) const override;
+        color Eval(const ray &r_in, const HitRecord &rec, const Vec3 &direction) const override;
+        double Pdf(const ray &r_in, const HitRecord &rec, const Vec3 &direction) const override;
+
+        // The BSDF of a diffuse surface of the given albedo, shared with MaterialRecord.
+        static bool SampleAlbedo(const color &albedo, const HitRecord &rec, util::PixelSampler &sampler,
+                                 BsdfSample &sample)
+        {
+            sample.direction = random_cosine_direction(rec.normal, sampler);
+            double cosine = dot(rec.normal, sample.direction);
+            if (cosine <= 0) // Grazing sample, lost to rounding
+                return false;
+
+            sample.pdf = cosine / kPi;
+            sample.value = albedo * sample.pdf;
+            sample.is_specular = false;
+            return true;
+        }
+
+        static color EvalAlbedo(const color &albedo, const HitRecord &rec, const Vec3 &direction)
+        {
+            double cosine = dot(rec.normal, unit_vector(direction));
+            return cosine > 0 ? albedo * (cosine / kPi) : color(0, 0, 0);
+        }
+
+        static double CosinePdf(const HitRecord &rec, const Vec3 &direction)
+        {
+            double cosine = dot(rec.normal, unit_vector(direction));
+            return cosine > 0 ? cosine / kPi : 0;
+        }
+
+    protected:
+        virtual color Albedo(const HitRecord &rec) const = 0;
+    };
+
+    class Lambertian : public DiffuseMaterial
     {
     public:
         Lambertian(const color &a) : albedo_(a) {}
-        bool Scatter(const ray &r_in, const HitRecord &rec, color &attenuation, ray &scattered)
-            const override;
+
+        MaterialRecord ToRecord() const override;
+
+    protected:
+        color Albedo([[maybe_unused]] const HitRecord &rec) const override { return albedo_; }
 
     private:
         color albedo_;
     };
 
-    class CheckeredLambertian : public Material
+    class CheckeredLambertian : public DiffuseMaterial
     {
     public:
         CheckeredLambertian(const double scale, const color &c1, const color &c2) : scale_(scale), albedo_1_(c1), albedo_2_(c2) {}
-        bool Scatter(const ray &r_in, const HitRecord &rec, color &attenuation, ray &scattered)
-            const override;
+
+        MaterialRecord ToRecord() const override;
+
+        // Albedo at rec of a checkerboard of cubes of side scale.
+        static color Checker(double scale, const color &c1, const color &c2, const HitRecord &rec)
+        {
+            Point3 p = (1 / scale) * rec.p;
+            auto sum = ((int)p.x() + (int)p.y() + (int)p.z());
+            return sum % 2 != 0 ? c1 : c2;
+        }
+
+    protected:
+        color Albedo(const HitRecord &rec) const override;
 
     private:
         double scale_;
@@ -58,23 +150,66 @@ namespace scene
     public:
         Metal(const color &a) : albedo_(a) {}
 
-        bool Scatter(const ray &r_in, const HitRecord &rec, color &attenuation, ray &scattered)
-            const override;
+        bool Sample(const ray &r_in, const HitRecord &rec, util::PixelSampler &sampler,
+                    BsdfSample &sample) const override;
+        MaterialRecord ToRecord() const override;
+
+        static void Reflect(const color &albedo, const ray &r_in, const HitRecord &rec, BsdfSample &sample)
+        {
+            sample.direction = reflect(unit_vector(r_in.direction()), rec.normal);
+            sample.value = albedo;
+            sample.pdf = 1;
+            sample.is_specular = true;
+        }
 
     private:
         color albedo_;
     };
 
+    /**
+     * Smooth glass: reflects with the Fresnel reflectance (Schlick's approximation) and refracts
+     * otherwise, choosing between the two at random.
+    */
     class Dielectric : public Material
     {
     public:
         Dielectric(double index_of_refraction) : ir(index_of_refraction) {}
 
-        bool Scatter(const ray &r_in, const HitRecord &rec, color &attenuation, ray &scattered)
-            const override;
+        bool Sample(const ray &r_in, const HitRecord &rec, util::PixelSampler &sampler,
+                    BsdfSample &sample) const override;
+        MaterialRecord ToRecord() const override;
+
+        static void Scatter(double ir, const ray &r_in, const HitRecord &rec, util::PixelSampler &sampler,
+                            BsdfSample &sample)
+        {
+            double choice = sampler.Get1D();
+            double refraction_ratio = rec.front_face ? (1.0 / ir) : ir;
+
+            Vec3 unit_direction = unit_vector(r_in.direction());
+            double cos_theta = fmin(dot(-unit_direction, rec.normal), 1.0);
+            double sin_theta = sqrt(1.0 - cos_theta * cos_theta);
+
+            // Reflect with the Fresnel probability; beyond the critical angle, always.
+            bool cannot_refract = refraction_ratio * sin_theta > 1.0;
+            if (cannot_refract || choice < Reflectance(cos_theta, refraction_ratio))
+                sample.direction = reflect(unit_direction, rec.normal);
+            else
+                sample.direction = refract(unit_direction, rec.normal, refraction_ratio);
+
+            sample.value = .9 * color(1.0, 1.0, 1.0);
+            sample.pdf = 1;
+            sample.is_specular = true;
+        }
 
     private:
         double ir; // Index of Refraction
+
+        static double Reflectance(double cosine, double refraction_ratio)
+        {
+            auto r0 = (1 - refraction_ratio) / (1 + refraction_ratio);
+            r0 = r0 * r0;
+            return r0 + (1 - r0) * pow(1 - cosine, 5);
+        }
     };
 
     class Light : public Material
@@ -82,14 +217,111 @@ namespace scene
     public:
         Light(const color &a) : albedo_(a) {}
 
-        bool Scatter(const ray &r_in, const HitRecord &rec, color &attenuation, ray &scattered)
-            const override;
+        bool Sample(const ray &r_in, const HitRecord &rec, util::PixelSampler &sampler,
+                    BsdfSample &sample) const override;
         color Emit(const ray &r_in, const HitRecord &rec) const override;
+        MaterialRecord ToRecord() const override;
 
     private:
         color albedo_;
     };
 
+    /**
+     * Closed-set form of a material: the built-in materials as plain data, evaluated with a
+     * switch that inlines into the path loop instead of a virtual call per bounce. Records of
+     * other materials are kVirtual and forward to them. Both forms share the same code, so they
+     * give bit-identical results.
+    */
+    struct MaterialRecord
+    {
+        enum Kind : uint8_t
+        {
+            kLambertian,
+            kCheckered,
+            kMetal,
+            kDielectric,
+            kLight,
+            kVirtual
+        };
+
+        Kind kind = kVirtual;
+        color albedo, albedo2;              // albedo2 is the second colour of kCheckered
+        double param = 0;                   // kCheckered: scale. kDielectric: index of refraction
+        const Material *material = nullptr; // The material the record was made from
+
+        bool Sample(const ray &r_in, const HitRecord &rec, util::PixelSampler &sampler, BsdfSample &sample) const
+        {
+            switch (kind)
+            {
+            case kLambertian:
+                return DiffuseMaterial::SampleAlbedo(albedo, rec, sampler, sample);
+            case kCheckered:
+                return DiffuseMaterial::SampleAlbedo(CheckeredLambertian::Checker(param, albedo, albedo2, rec), rec,
+                                                     sampler, sample);
+            case kMetal:
+                Metal::Reflect(albedo, r_in, rec, sample);
+                return true;
+            case kDielectric:
+                Dielectric::Scatter(param, r_in, rec, sampler, sample);
+                return true;
+            case kLight:
+                return false;
+            default:
+                return material->Sample(r_in, rec, sampler, sample);
+            }
+        }
+
+        color Eval(const ray &r_in, const HitRecord &rec, const Vec3 &direction) const
+        {
+            switch (kind)
+            {
+            case kLambertian:
+                return DiffuseMaterial::EvalAlbedo(albedo, rec, direction);
+            case kCheckered:
+                return DiffuseMaterial::EvalAlbedo(CheckeredLambertian::Checker(param, albedo, albedo2, rec), rec,
+                                                   direction);
+            case kVirtual:
+                return material->Eval(r_in, rec, direction);
+            default:
+                return color(0, 0, 0);
+            }
+        }
+
+        double Pdf(const ray &r_in, const HitRecord &rec, const Vec3 &direction) const
+        {
+            switch (kind)
+            {
+            case kLambertian:
+            case kCheckered:
+                return DiffuseMaterial::CosinePdf(rec, direction);
+            case kVirtual:
+                return material->Pdf(r_in, rec, direction);
+            default:
+                return 0;
+            }
+        }
+
+        color Emit(const ray &r_in, const HitRecord &rec) const
+        {
+            switch (kind)
+            {
+            case kLight:
+                return albedo;
+            case kVirtual:
+                return material->Emit(r_in, rec);
+            default:
+                return color(0, 0, 0);
+            }
+        }
+    };
+
+    inline MaterialRecord Material::ToRecord() const
+    {
+        MaterialRecord record;
+        record.material = this;
+        return record;
+    }
+
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,38 @@
+#include "material_table.h"
+
+#include <typeinfo>
+
+using namespace scene;
+
+MaterialId MaterialTable::Intern(const std::shared_ptr<Material> &material)
+{
+    if (!material)
+        return kNoMaterial;
+
+    auto found = ids_.find(material.get());
+    if (found != ids_.end())
+        return found->second;
+
+    MaterialId id = MaterialId(materials_.size());
+    materials_.push_back(material);
+    records_.push_back(material->ToRecord());
+    ids_.emplace(material.get(), id);
+    return id;
+}
+
+void MaterialTable::HashContent(util::Hash &hash) const
+{
+    for (size_t id = 0; id < records_.size(); id++)
+    {
+        const MaterialRecord &record = records_[id];
+        hash.Add(record.kind);
+        if (record.kind == MaterialRecord::kVirtual)
+        {
+            hash.Add(typeid(*materials_[id]).name());
+            continue;
+        }
+        hash.Add(record.albedo);
+        hash.Add(record.albedo2);
+        hash.Add(record.param);
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef MATERIAL_TABLE_H
+#define MATERIAL_TABLE_H
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "./util/hash.h"
+#include "material.h"
+
+namespace scene
+{
+
+    /**
+     * The materials of one compiled scene, stored contiguously and indexed by MaterialId, along
+     * with their MaterialRecord. The scene fills it while it is compiled, when each object
+     * interns its material and keeps the id, and only reads it afterwards, so render threads
+     * look materials up without locking. A material shared by many objects gets a single id, and
+     * kNoMaterial stands for a light grey diffuse default.
+    */
+    class MaterialTable
+    {
+    public:
+        MaterialTable() = default;
+
+        // Ids are only meaningful to the objects that interned them; copies would outlive that.
+        MaterialTable(const MaterialTable &) = delete;
+        MaterialTable &operator=(const MaterialTable &) = delete;
+
+        // The id of material, added on first use. A null material gets kNoMaterial.
+        MaterialId Intern(const std::shared_ptr<Material> &material);
+
+        // The material with the given id, or null for kNoMaterial.
+        const Material *Get(MaterialId id) const
+        {
+            return id == kNoMaterial ? nullptr : materials_[id].get();
+        }
+
+        // The material with the given id, or the default one for kNoMaterial.
+        const Material &At(MaterialId id) const
+        {
+            if (id == kNoMaterial)
+                return default_;
+            return *materials_[id];
+        }
+
+        const MaterialRecord &Record(MaterialId id) const
+        {
+            return id == kNoMaterial ? default_record_ : records_[id];
+        }
+
+        size_t size() const { return materials_.size(); }
+
+        // Adds the parameters of every material to hash. Materials outside the closed set of
+        // MaterialRecord only add their type.
+        void HashContent(util::Hash &hash) const;
+
+        // Bytes of the records and pointers, not counting the materials themselves.
+        size_t memory_usage() const
+        {
+            return records_.size() * sizeof(MaterialRecord) + materials_.size() * sizeof(materials_[0]);
+        }
+
+    private:
+        std::vector<MaterialRecord> records_;
+        std::vector<std::shared_ptr<Material>> materials_;
+        std::unordered_map<const Material *, MaterialId> ids_;
+
+        const Lambertian default_{color(0.7, 0.7, 0.7)};
+        const MaterialRecord default_record_ = default_.ToRecord();
+    };
+
+    // The material with the given id in materials as M: its MaterialRecord, or the Material
+    // itself for scenes compiled with Dispatch::kVirtual.
+    template <typename M>
+    const M &MaterialAs(const MaterialTable &materials, MaterialId id);
+
+    template <>
+    inline const MaterialRecord &MaterialAs<MaterialRecord>(const MaterialTable &materials, MaterialId id)
+    {
+        return materials.Record(id);
+    }
+
+    template <>
+    inline const Material &MaterialAs<Material>(const MaterialTable &materials, MaterialId id)
+    {
+        return materials.At(id);
+    }
+
+}
+
+#endif
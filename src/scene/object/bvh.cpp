@@ -0,0 +1,226 @@
+#include "bvh.h"
+
+#include "./util/parallel.h"
+
+#include <algorithm>
+#include <mutex>
+
+using namespace scene;
+using namespace ptmath;
+
+namespace
+{
+    const int kSahBins = 12;
+
+    // Ranges at least this large are binned on the pool's threads, when there is one.
+    const size_t kParallelBinning = 1 << 14;
+
+    // Calls fn(begin, end) on slices of [start, end), in parallel for large ranges. Slices may
+    // finish in any order, so fn should only merge results whose merge does not depend on it.
+    template <typename F>
+    void ForRange(util::TaskPool *pool, size_t start, size_t end, F &&fn)
+    {
+        if (pool && end - start >= kParallelBinning)
+            util::ParallelFor(*pool, end - start, [&](size_t begin, size_t stop)
+                              { fn(start + begin, start + stop); });
+        else
+            fn(start, end);
+    }
+}
+
+const char *scene::BvhBuilderName(BvhBuilder builder)
+{
+    return builder == BvhBuilder::kLbvh ? "lbvh" : "sah";
+}
+
+std::vector<BvhBuildPrim> scene::MakeBuildPrims(const std::vector<aabb> &boxes)
+{
+    std::vector<BvhBuildPrim> prims(boxes.size());
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+        prims[i].box = boxes[i];
+        prims[i].centroid = boxes[i].centroid();
+        prims[i].index = static_cast<uint32_t>(i);
+    }
+    return prims;
+}
+
+BvhNode::BvhNode(const HittableGroup &group)
+{
+    const auto &objects = group.objects;
+    if (objects.empty())
+        return;
+
+    if (objects.size() == 1)
+    {
+        left_ = right_ = objects[0];
+    }
+    else
+    {
+        std::vector<aabb> boxes;
+        for (const auto &object : objects)
+            boxes.push_back(object->bounding_box());
+        auto prims = MakeBuildPrims(boxes);
+
+        bool make_leaf;
+        size_t mid = SahPartition(prims, 0, prims.size(), make_leaf);
+        left_ = Build(objects, prims, 0, mid);
+        right_ = Build(objects, prims, mid, prims.size());
+    }
+
+    bbox_ = aabb(left_->bounding_box(), right_->bounding_box());
+}
+
+shared_ptr<Hittable> BvhNode::Build(const std::vector<shared_ptr<Hittable>> &objects,
+                                    std::vector<BvhBuildPrim> &prims, size_t start, size_t end)
+{
+    if (end - start == 1)
+        return objects[prims[start].index];
+
+    bool make_leaf;
+    size_t mid = SahPartition(prims, start, end, make_leaf);
+    if (make_leaf)
+    {
+        // Small ranges that are cheaper to test directly than to split any further.
+        auto leaf = make_shared<HittableGroup>();
+        for (size_t i = start; i < end; i++)
+            leaf->add(objects[prims[i].index]);
+        return leaf;
+    }
+
+    auto node = shared_ptr<BvhNode>(new BvhNode());
+    node->left_ = Build(objects, prims, start, mid);
+    node->right_ = Build(objects, prims, mid, end);
+    node->bbox_ = aabb(node->left_->bounding_box(), node->right_->bounding_box());
+    return node;
+}
+
+size_t scene::SahPartition(std::vector<BvhBuildPrim> &prims, size_t start, size_t end, bool &make_leaf,
+                           int *split_axis, const BvhLeafOptions &leaves, util::TaskPool *pool)
+{
+    // Box unions and bin counts come out the same in any order, so binning in parallel finds
+    // exactly the split a serial pass would.
+    std::mutex mu;
+    aabb bounds;
+    aabb centroid_bounds;
+    ForRange(pool, start, end, [&](size_t begin, size_t stop)
+             {
+        aabb slice_bounds, slice_centroids;
+        for (size_t i = begin; i < stop; i++)
+        {
+            slice_bounds = aabb(slice_bounds, prims[i].box);
+            slice_centroids = aabb(slice_centroids, aabb(prims[i].centroid, prims[i].centroid));
+        }
+        std::lock_guard<std::mutex> lock(mu);
+        bounds = aabb(bounds, slice_bounds);
+        centroid_bounds = aabb(centroid_bounds, slice_centroids); });
+
+    size_t count = end - start;
+    size_t mid = start + count / 2;
+    make_leaf = false;
+
+    int axis = centroid_bounds.longest_axis();
+    if (split_axis)
+        *split_axis = axis;
+    interval extent = centroid_bounds.axis(axis);
+    if (extent.size() <= 0)
+    {
+        // All centroids coincide, so no plane can separate them.
+        make_leaf = count <= leaves.max_size;
+        return mid;
+    }
+
+    auto bin_of = [&](const BvhBuildPrim &prim)
+    {
+        auto c = prim.centroid[axis];
+        int b = static_cast<int>(kSahBins * (c - extent.min) / extent.size());
+        return std::min(b, kSahBins - 1);
+    };
+
+    size_t bin_count[kSahBins] = {};
+    aabb bin_bounds[kSahBins];
+    ForRange(pool, start, end, [&](size_t begin, size_t stop)
+             {
+        size_t slice_count[kSahBins] = {};
+        aabb slice_bounds[kSahBins];
+        for (size_t i = begin; i < stop; i++)
+        {
+            int b = bin_of(prims[i]);
+            slice_count[b]++;
+            slice_bounds[b] = aabb(slice_bounds[b], prims[i].box);
+        }
+        std::lock_guard<std::mutex> lock(mu);
+        for (int b = 0; b < kSahBins; b++)
+        {
+            bin_count[b] += slice_count[b];
+            bin_bounds[b] = aabb(bin_bounds[b], slice_bounds[b]);
+        } });
+
+    // Sweep from the right to get the area and count of every right-hand partition, then
+    // sweep from the left evaluating the cost of splitting after each bin.
+    double right_area[kSahBins];
+    size_t right_count[kSahBins];
+    aabb acc;
+    size_t n = 0;
+    for (int b = kSahBins - 1; b > 0; b--)
+    {
+        acc = aabb(acc, bin_bounds[b]);
+        n += bin_count[b];
+        right_area[b] = acc.surface_area();
+        right_count[b] = n;
+    }
+
+    double best_cost = INFINITY;
+    int best_split = -1;
+    acc = aabb();
+    n = 0;
+    for (int b = 0; b < kSahBins - 1; b++)
+    {
+        acc = aabb(acc, bin_bounds[b]);
+        n += bin_count[b];
+        if (n == 0 || right_count[b + 1] == 0)
+            continue;
+
+        double cost = BvhIntersectionCost(n, leaves.width) * acc.surface_area() +
+                      BvhIntersectionCost(right_count[b + 1], leaves.width) * right_area[b + 1];
+        if (cost < best_cost)
+        {
+            best_cost = cost;
+            best_split = b;
+        }
+    }
+
+    double leaf_cost = BvhIntersectionCost(count, leaves.width);
+    double split_cost = kBvhTraversalCost + best_cost / bounds.surface_area();
+    make_leaf = count <= leaves.max_size && leaf_cost <= split_cost;
+
+    if (best_split >= 0)
+    {
+        auto it = std::partition(prims.begin() + start, prims.begin() + end,
+                                 [&](const BvhBuildPrim &prim)
+                                 { return bin_of(prim) <= best_split; });
+        mid = it - prims.begin();
+    }
+
+    if (mid == start || mid == end)
+    {
+        // Binning could not separate the objects; fall back to an even split along the axis.
+        mid = start + count / 2;
+        std::nth_element(prims.begin() + start, prims.begin() + mid, prims.begin() + end,
+                         [axis](const BvhBuildPrim &a, const BvhBuildPrim &b)
+                         { return a.centroid[axis] < b.centroid[axis]; });
+    }
+
+    return mid;
+}
+
+bool BvhNode::hit(const ray &r, interval ray_t, HitRecord &rec) const
+{
+    if (!left_ || !bbox_.hit(r, ray_t))
+        return false;
+
+    bool hit_left = left_->hit(r, ray_t, rec);
+    bool hit_right = right_ != left_ && right_->hit(r, interval(ray_t.min, hit_left ? rec.t : ray_t.max), rec);
+
+    return hit_left || hit_right;
+}
@@ -0,0 +1,110 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <cstdint>
+
+#include "./ptmath/aabb.h"
+
+#include "object.h"
+
+namespace util
+{
+    class TaskPool;
+}
+
+namespace scene
+{
+
+    /**
+     * What the BVH builders need to know about a primitive: its bounds, their centroid, and
+     * where the primitive lives in the caller's array.
+    */
+    struct BvhBuildPrim
+    {
+        aabb box;
+        Point3 centroid;
+        uint32_t index;
+    };
+
+    std::vector<BvhBuildPrim> MakeBuildPrims(const std::vector<aabb> &boxes);
+
+    /**
+     * Leaf shape the SAH optimizes for. width primitives are assumed to be tested for the cost
+     * of one, as SIMD kernels do, so wider leaves are worth filling up to max_size.
+    */
+    struct BvhLeafOptions
+    {
+        size_t max_size = 4;
+        size_t width = 1;
+    };
+
+    // Cost of visiting one node, relative to intersecting one group of width primitives.
+    const double kBvhTraversalCost = 1.0;
+
+    // Cost of intersecting count primitives in groups of width.
+    inline double BvhIntersectionCost(size_t count, size_t width)
+    {
+        return static_cast<double>((count + width - 1) / width);
+    }
+
+    enum class BvhBuilder
+    {
+        kSah,  // Top-down, every split chosen with the binned SAH
+        kLbvh, // Primitives sorted along a Morton curve and split where their codes differ
+    };
+
+    const char *BvhBuilderName(BvhBuilder builder);
+
+    /**
+     * How a LinearBvh is built. The LBVH builds several times faster than the SAH but its trees
+     * cost more to trace, which suits previews of large meshes. With a pool both builders spread
+     * their work over its threads, and still produce the same tree whatever their number.
+     *
+     * With wide set, the binary tree is also collapsed into a WideBvh, which single rays then
+     * traverse instead; packets keep to the binary tree.
+    */
+    struct BvhBuildOptions
+    {
+        BvhBuilder builder = BvhBuilder::kSah;
+        util::TaskPool *pool = nullptr;
+        bool wide = false;
+    };
+
+    /**
+     * Reorders prims[start, end) around the cheapest binned SAH split and returns the split
+     * index. Sets make_leaf when testing the range directly is cheaper than splitting it, and
+     * split_axis, when given, to the axis the range was partitioned along. With a pool, large
+     * ranges are binned on its threads.
+    */
+    size_t SahPartition(std::vector<BvhBuildPrim> &prims, size_t start, size_t end, bool &make_leaf,
+                        int *split_axis = nullptr, const BvhLeafOptions &leaves = BvhLeafOptions(),
+                        util::TaskPool *pool = nullptr);
+
+    /**
+     * Bounding volume hierarchy over the objects of a HittableGroup.
+     * Built top-down, choosing each split with the binned surface area heuristic.
+    */
+    class BvhNode : public Hittable
+    {
+    public:
+        BvhNode(const HittableGroup &group);
+
+        bool hit(const ray &r, interval ray_t, HitRecord &rec) const override;
+
+        aabb bounding_box() const override { return bbox_; }
+
+    private:
+        shared_ptr<Hittable> left_;
+        shared_ptr<Hittable> right_;
+        aabb bbox_;
+
+        BvhNode() {}
+
+        // Returns the subtree for prims[start, end): the object itself, a leaf group, or a node.
+        static shared_ptr<Hittable> Build(const std::vector<shared_ptr<Hittable>> &objects,
+                                          std::vector<BvhBuildPrim> &prims, size_t start, size_t end);
+    };
+
+}
+
+#endif
@@ -0,0 +1,699 @@
+#include "linear_bvh.h"
+#include "bvh.h"
+#include "sphere.h"
+#include "quad.h"
+
+#include "./util/parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <typeinfo>
+
+using namespace scene;
+using namespace ptmath;
+
+namespace
+{
+    // Past this depth splits fall back to halving the range, which keeps the tree shallow enough
+    // for the fixed traversal stack no matter how the SAH or the Morton codes behave on
+    // pathological input.
+    const int kMaxSplitDepth = LinearBvh::kStackSize - 32;
+
+    // Parallel builds hand out subtrees of at least this many primitives as tasks.
+    const size_t kMinTaskSize = 4096;
+
+    // Bits of each coordinate in a Morton code, which is also the digit size of the radix sort.
+    const int kMortonBits = 10;
+
+    float RoundDown(double x)
+    {
+        float f = static_cast<float>(x);
+        return f > x ? std::nextafter(f, -INFINITY) : f;
+    }
+
+    float RoundUp(double x)
+    {
+        float f = static_cast<float>(x);
+        return f < x ? std::nextafter(f, INFINITY) : f;
+    }
+
+    /**
+     * Builds the subtree for prims[start, end) depth-first into nodes and returns its index.
+     * split(start, end, depth, make_leaf, axis, pool) returns where to split the range,
+     * reordering it if needed, and sets make_leaf when it should not be split at all.
+    */
+    template <typename Split>
+    uint32_t BuildRecursive(std::vector<LinearBvhNode> &nodes, std::vector<BvhBuildPrim> &prims,
+                            size_t start, size_t end, int depth, Split &split)
+    {
+        uint32_t index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+
+        aabb bounds;
+        for (size_t i = start; i < end; i++)
+            bounds = aabb(bounds, prims[i].box);
+
+        LinearBvhNode node = {};
+        for (int a = 0; a < 3; a++)
+        {
+            node.bounds_min[a] = RoundDown(bounds.axis(a).min);
+            node.bounds_max[a] = RoundUp(bounds.axis(a).max);
+        }
+
+        bool make_leaf = end - start == 1;
+        int axis = 0;
+        size_t mid = start;
+        if (!make_leaf)
+            mid = split(start, end, depth, make_leaf, axis, nullptr);
+
+        if (make_leaf)
+        {
+            node.offset = static_cast<uint32_t>(start);
+            node.count = static_cast<uint16_t>(end - start);
+            nodes[index] = node;
+            return index;
+        }
+
+        node.axis = static_cast<uint8_t>(axis);
+        BuildRecursive(nodes, prims, start, mid, depth + 1, split);
+        node.offset = BuildRecursive(nodes, prims, mid, end, depth + 1, split);
+        nodes[index] = node;
+        return index;
+    }
+
+    /**
+     * BuildRecursive spread over a pool. The top of the tree is split on the calling thread,
+     * with split using the pool for the large ranges there, down to subtrees of about grain
+     * primitives. Those are built as tasks, each into nodes of its own, and finally copied into
+     * place depth-first, so the result is the same as a serial build whatever the number of
+     * threads.
+    */
+    template <typename Split>
+    class ParallelBuild
+    {
+    public:
+        ParallelBuild(std::vector<BvhBuildPrim> &prims, Split &split, size_t grain)
+            : prims_(prims), split_(split), grain_(grain) {}
+
+        void Run(std::vector<LinearBvhNode> &nodes, util::TaskPool &pool)
+        {
+            SplitTop(0, prims_.size(), 0, pool);
+            pool.Run(tasks_.size(), [this](size_t i, int)
+                     {
+                Task &task = tasks_[i];
+                BuildRecursive(task.nodes, prims_, task.start, task.end, task.depth, split_); });
+            Emit(0, nodes);
+        }
+
+    private:
+        // A node of the top, either split in two or left to a task.
+        struct TopNode
+        {
+            int left, right;
+            int task;
+            uint8_t axis;
+        };
+
+        struct Task
+        {
+            size_t start, end;
+            int depth;
+            std::vector<LinearBvhNode> nodes;
+        };
+
+        std::vector<BvhBuildPrim> &prims_;
+        Split &split_;
+        size_t grain_;
+        std::vector<TopNode> top_;
+        std::vector<Task> tasks_;
+
+        // Top ranges are larger than any leaf, so split never asks for one here.
+        int SplitTop(size_t start, size_t end, int depth, util::TaskPool &pool)
+        {
+            int index = static_cast<int>(top_.size());
+            top_.push_back({-1, -1, -1, 0});
+            if (end - start <= grain_)
+            {
+                top_[index].task = static_cast<int>(tasks_.size());
+                tasks_.push_back({start, end, depth, {}});
+                return index;
+            }
+
+            bool make_leaf = false;
+            int axis = 0;
+            size_t mid = split_(start, end, depth, make_leaf, axis, &pool);
+            top_[index].axis = static_cast<uint8_t>(axis);
+            int left = SplitTop(start, mid, depth + 1, pool);
+            int right = SplitTop(mid, end, depth + 1, pool);
+            top_[index].left = left;
+            top_[index].right = right;
+            return index;
+        }
+
+        uint32_t Emit(int top, std::vector<LinearBvhNode> &nodes)
+        {
+            uint32_t index = static_cast<uint32_t>(nodes.size());
+            const TopNode &t = top_[top];
+            if (t.task >= 0)
+            {
+                // Interior offsets are relative to the task's own node array.
+                for (LinearBvhNode node : tasks_[t.task].nodes)
+                {
+                    if (!node.is_leaf())
+                        node.offset += index;
+                    nodes.push_back(node);
+                }
+                return index;
+            }
+
+            nodes.emplace_back();
+            Emit(t.left, nodes);
+            uint32_t second = Emit(t.right, nodes);
+
+            // Rounding outwards commutes with taking the union, so these match a serial build.
+            LinearBvhNode node = {};
+            const LinearBvhNode &a = nodes[index + 1];
+            const LinearBvhNode &b = nodes[second];
+            for (int k = 0; k < 3; k++)
+            {
+                node.bounds_min[k] = std::min(a.bounds_min[k], b.bounds_min[k]);
+                node.bounds_max[k] = std::max(a.bounds_max[k], b.bounds_max[k]);
+            }
+            node.offset = second;
+            node.axis = t.axis;
+            nodes[index] = node;
+            return index;
+        }
+    };
+
+    template <typename Split>
+    void BuildTree(std::vector<LinearBvhNode> &nodes, std::vector<BvhBuildPrim> &prims,
+                   const BvhLeafOptions &leaves, util::TaskPool *pool, Split &split)
+    {
+        size_t count = prims.size();
+        if (!pool || pool->size() <= 1 || count < 2 * kMinTaskSize)
+        {
+            BuildRecursive(nodes, prims, 0, count, 0, split);
+            return;
+        }
+
+        // A few tasks per thread leave something to steal when subtrees take uneven time.
+        size_t grain = std::max({kMinTaskSize, leaves.max_size, count / (size_t(pool->size()) * 8)});
+        ParallelBuild<Split>(prims, split, grain).Run(nodes, *pool);
+    }
+
+    void BuildSah(std::vector<LinearBvhNode> &nodes, std::vector<BvhBuildPrim> &prims,
+                  const BvhLeafOptions &leaves, util::TaskPool *pool)
+    {
+        auto split = [&](size_t start, size_t end, int depth, bool &make_leaf, int &axis, util::TaskPool *pool)
+        {
+            size_t mid = SahPartition(prims, start, end, make_leaf, &axis, leaves, pool);
+            if (depth >= kMaxSplitDepth)
+            {
+                make_leaf = false;
+                mid = start + (end - start) / 2;
+            }
+            return mid;
+        };
+        BuildTree(nodes, prims, leaves, pool, split);
+    }
+
+    // Spreads the low 10 bits of v out to every third bit.
+    uint32_t ExpandBits(uint32_t v)
+    {
+        v = (v * 0x00010001u) & 0xff0000ffu;
+        v = (v * 0x00000101u) & 0x0f00f00fu;
+        v = (v * 0x00000011u) & 0xc30c30c3u;
+        v = (v * 0x00000005u) & 0x49249249u;
+        return v;
+    }
+
+    // Morton code of p within bounds: bit 3i + 2 - a of the code is bit i of coordinate a.
+    uint32_t MortonCode(const Point3 &p, const aabb &bounds)
+    {
+        const uint32_t kCells = 1u << kMortonBits;
+        uint32_t code = 0;
+        for (int a = 0; a < 3; a++)
+        {
+            const interval &extent = bounds.axis(a);
+            double f = extent.size() > 0 ? (p[a] - extent.min) / extent.size() : 0;
+            uint32_t cell = std::min(static_cast<uint32_t>(std::max(f, 0.0) * kCells), kCells - 1);
+            code |= ExpandBits(cell) << (2 - a);
+        }
+        return code;
+    }
+
+    template <typename F>
+    void ForSlices(util::TaskPool *pool, size_t slices, F &&fn)
+    {
+        if (slices > 1)
+            pool->Run(slices, [&](size_t s, int)
+                      { fn(s); });
+        else
+            fn(0);
+    }
+
+    /**
+     * Stable LSD radix sort of keys by their bits 32 and up, which hold the Morton code. Every
+     * pass counts the digits of each slice of keys in parallel, then scatters the slices in
+     * parallel to the places the counts give them.
+    */
+    void SortByCode(std::vector<uint64_t> &keys, util::TaskPool *pool)
+    {
+        const size_t kBuckets = size_t(1) << kMortonBits;
+        size_t n = keys.size();
+        size_t slices = pool && n >= kMinTaskSize ? size_t(pool->size()) * 4 : 1;
+        std::vector<uint64_t> scratch(n);
+        std::vector<size_t> offsets(slices * kBuckets);
+
+        for (int shift = 32; shift < 32 + 3 * kMortonBits; shift += kMortonBits)
+        {
+            ForSlices(pool, slices, [&](size_t s)
+                      {
+                size_t *count = &offsets[s * kBuckets];
+                std::fill(count, count + kBuckets, 0);
+                for (size_t i = n * s / slices; i < n * (s + 1) / slices; i++)
+                    count[(keys[i] >> shift) & (kBuckets - 1)]++; });
+
+            // Bucket by bucket, each slice writes after the slices before it.
+            size_t sum = 0;
+            for (size_t b = 0; b < kBuckets; b++)
+            {
+                for (size_t s = 0; s < slices; s++)
+                {
+                    size_t count = offsets[s * kBuckets + b];
+                    offsets[s * kBuckets + b] = sum;
+                    sum += count;
+                }
+            }
+
+            ForSlices(pool, slices, [&](size_t s)
+                      {
+                size_t *offset = &offsets[s * kBuckets];
+                for (size_t i = n * s / slices; i < n * (s + 1) / slices; i++)
+                    scratch[offset[(keys[i] >> shift) & (kBuckets - 1)]++] = keys[i]; });
+            keys.swap(scratch);
+        }
+    }
+
+    // Calls fn(begin, end) on slices of [0, count), on the pool when there is one.
+    template <typename F>
+    void ForEachSlice(util::TaskPool *pool, size_t count, F &&fn)
+    {
+        if (pool)
+            util::ParallelFor(*pool, count, fn);
+        else
+            fn(size_t(0), count);
+    }
+
+    /**
+     * Sorts prims along a Morton curve through their centroids and splits every range where the
+     * highest bit that differs between its first and last code changes (Lauterbach et al., "Fast
+     * BVH Construction on GPUs", 2009). Ranges of one code are halved.
+    */
+    void BuildLbvh(std::vector<LinearBvhNode> &nodes, std::vector<BvhBuildPrim> &prims,
+                   const BvhLeafOptions &leaves, util::TaskPool *pool)
+    {
+        size_t n = prims.size();
+        std::mutex mu;
+        aabb centroid_bounds;
+        ForEachSlice(pool, n, [&](size_t begin, size_t end)
+                     {
+            aabb slice;
+            for (size_t i = begin; i < end; i++)
+                slice = aabb(slice, aabb(prims[i].centroid, prims[i].centroid));
+            std::lock_guard<std::mutex> lock(mu);
+            centroid_bounds = aabb(centroid_bounds, slice); });
+
+        // Primitives with equal codes stay in their original order.
+        std::vector<uint64_t> keys(n);
+        ForEachSlice(pool, n, [&](size_t begin, size_t end)
+                     {
+            for (size_t i = begin; i < end; i++)
+                keys[i] = uint64_t(MortonCode(prims[i].centroid, centroid_bounds)) << 32 | i; });
+        SortByCode(keys, pool);
+
+        std::vector<BvhBuildPrim> sorted(n);
+        std::vector<uint32_t> codes(n);
+        ForEachSlice(pool, n, [&](size_t begin, size_t end)
+                     {
+            for (size_t i = begin; i < end; i++)
+            {
+                sorted[i] = prims[uint32_t(keys[i])];
+                codes[i] = uint32_t(keys[i] >> 32);
+            } });
+        prims.swap(sorted);
+
+        auto split = [&](size_t start, size_t end, int depth, bool &make_leaf, int &axis, util::TaskPool *)
+        {
+            size_t count = end - start;
+            size_t mid = start + count / 2;
+            make_leaf = count <= leaves.max_size;
+            axis = 0;
+            uint32_t first = codes[start], last = codes[end - 1];
+            if (make_leaf || first == last || depth >= kMaxSplitDepth)
+                return mid;
+
+            int bit = 31 - __builtin_clz(first ^ last);
+            axis = 2 - bit % 3;
+
+            // The codes are sorted and agree above bit, so those with it set form a suffix.
+            auto it = std::partition_point(codes.begin() + start, codes.begin() + end, [bit](uint32_t code)
+                                           { return (code >> bit & 1) == 0; });
+            return size_t(it - codes.begin());
+        };
+        BuildTree(nodes, prims, leaves, pool, split);
+    }
+}
+
+void LinearBvh::Build(const std::vector<aabb> &boxes, const BvhLeafOptions &leaves, const BvhBuildOptions &options)
+{
+    auto start = std::chrono::steady_clock::now();
+    owned_nodes_.clear();
+    prim_order_.clear();
+    nodes_ = util::Span<LinearBvhNode>();
+    build_seconds_ = 0;
+    if (boxes.empty())
+        return;
+
+    auto prims = MakeBuildPrims(boxes);
+    owned_nodes_.reserve(2 * prims.size());
+    if (options.builder == BvhBuilder::kLbvh)
+        BuildLbvh(owned_nodes_, prims, leaves, options.pool);
+    else
+        BuildSah(owned_nodes_, prims, leaves, options.pool);
+    owned_nodes_.shrink_to_fit();
+    nodes_ = owned_nodes_;
+
+    prim_order_.resize(prims.size());
+    for (size_t i = 0; i < prims.size(); i++)
+        prim_order_[i] = prims[i].index;
+    build_seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void LinearBvh::Adopt(util::Span<LinearBvhNode> nodes)
+{
+    owned_nodes_.clear();
+    prim_order_.clear();
+    nodes_ = nodes;
+}
+
+double LinearBvh::SahCost(const BvhLeafOptions &leaves) const
+{
+    auto area = [](const LinearBvhNode &node)
+    {
+        double dx = node.bounds_max[0] - node.bounds_min[0];
+        double dy = node.bounds_max[1] - node.bounds_min[1];
+        double dz = node.bounds_max[2] - node.bounds_min[2];
+        return 2 * (dx * dy + dy * dz + dz * dx);
+    };
+
+    if (nodes_.empty() || area(nodes_[0]) <= 0)
+        return 0;
+
+    double cost = 0;
+    for (const LinearBvhNode &node : nodes_)
+    {
+        double node_cost = node.is_leaf() ? BvhIntersectionCost(node.count, leaves.width) : kBvhTraversalCost;
+        cost += area(node) * node_cost;
+    }
+    return cost / area(nodes_[0]);
+}
+
+aabb LinearBvh::bounds() const
+{
+    if (nodes_.empty())
+        return aabb();
+
+    const LinearBvhNode &root = nodes_[0];
+    return aabb(Point3(root.bounds_min[0], root.bounds_min[1], root.bounds_min[2]),
+                Point3(root.bounds_max[0], root.bounds_max[1], root.bounds_max[2]));
+}
+
+namespace
+{
+    enum ObjectKind
+    {
+        kSphereKind,
+        kQuadKind,
+        kOtherKind
+    };
+
+    // Only exact types qualify for the kernels: a subclass could change the shape.
+    ObjectKind KindOf(const Hittable &object)
+    {
+        if (typeid(object) == typeid(sphere))
+            return kSphereKind;
+        if (typeid(object) == typeid(quad))
+            return kQuadKind;
+        return kOtherKind;
+    }
+
+    void Flatten(const std::vector<shared_ptr<Hittable>> &objects, std::vector<shared_ptr<Hittable>> &flat)
+    {
+        for (const auto &object : objects)
+        {
+            // None of the groups override hit, so their members can join the BVH directly.
+            if (auto group = std::dynamic_pointer_cast<HittableGroup>(object))
+                Flatten(group->objects, flat);
+            else
+                flat.push_back(object);
+        }
+    }
+}
+
+LinearBvhGroup::LinearBvhGroup(const HittableGroup &group, Dispatch dispatch, const BvhBuildOptions &build)
+    : dispatch_(dispatch), bbox_(group.bounding_box())
+{
+    Flatten(group.objects, objects_);
+
+    std::vector<aabb> boxes;
+    boxes.reserve(objects_.size());
+    for (const auto &object : objects_)
+        boxes.push_back(object->bounding_box());
+
+    bvh_.Build(boxes, LinearBvh::kSimdLeaves, build);
+    if (build.wide)
+        wide_.Build(bvh_);
+
+    ordered_.reserve(objects_.size());
+    for (uint32_t index : bvh_.prim_order())
+        ordered_.push_back(objects_[index].get());
+
+    leaf_layout_.resize(ordered_.size());
+    spheres_ = simd::SphereSoA(ordered_.size());
+    quads_ = simd::QuadSoA(ordered_.size());
+    for (const LinearBvhNode &node : bvh_.nodes())
+    {
+        if (!node.is_leaf())
+            continue;
+
+        auto begin = ordered_.begin() + node.offset;
+        auto end = begin + node.count;
+        std::stable_sort(begin, end, [](const Hittable *a, const Hittable *b)
+                         { return KindOf(*a) < KindOf(*b); });
+
+        LeafLayout &layout = leaf_layout_[node.offset];
+        layout = {};
+        for (uint32_t i = node.offset; i < node.offset + node.count; i++)
+        {
+            ObjectKind kind = KindOf(*ordered_[i]);
+            if (kind == kSphereKind)
+            {
+                auto s = static_cast<const sphere *>(ordered_[i]);
+                spheres_.Set(i, s->get_center(), s->get_radius());
+                layout.spheres++;
+            }
+            else if (kind == kQuadKind)
+            {
+                auto q = static_cast<const quad *>(ordered_[i]);
+                quads_.Set(i, q->get_q(), q->get_u(), q->get_v());
+                layout.quads++;
+            }
+        }
+    }
+
+    // Copies of the spheres and quads, in leaf order, for HitPrimitive.
+    primitives_.resize(ordered_.size());
+    for (size_t i = 0; i < ordered_.size(); i++)
+    {
+        PrimitiveRef &prim = primitives_[i];
+        prim.kind = KindOf(*ordered_[i]);
+        if (prim.kind == kSphereKind)
+        {
+            prim.index = uint32_t(sphere_store_.size());
+            sphere_store_.push_back(*static_cast<const sphere *>(ordered_[i]));
+        }
+        else if (prim.kind == kQuadKind)
+        {
+            prim.index = uint32_t(quad_store_.size());
+            quad_store_.push_back(*static_cast<const quad *>(ordered_[i]));
+        }
+        else
+        {
+            prim.index = uint32_t(i);
+        }
+    }
+}
+
+size_t LinearBvhGroup::memory_usage() const
+{
+    return bvh_.nodes().size() * sizeof(LinearBvhNode) + bvh_.prim_order().size() * sizeof(uint32_t) +
+           wide_.memory_usage() +
+           objects_.size() * sizeof(shared_ptr<Hittable>) + ordered_.size() * sizeof(const Hittable *) +
+           leaf_layout_.size() * sizeof(LeafLayout) + spheres_.memory_usage() + quads_.memory_usage() +
+           primitives_.size() * sizeof(PrimitiveRef) + sphere_store_.size() * sizeof(sphere) +
+           quad_store_.size() * sizeof(quad);
+}
+
+bool LinearBvhGroup::hit(const ray &r, interval ray_t, HitRecord &rec) const
+{
+    simd::RayData ray_data = simd::MakeRayData(r);
+
+    auto hit_leaf = [&](uint32_t first, uint32_t count, const ray &r, interval ray_t, HitRecord &rec)
+    {
+        const LeafLayout &layout = leaf_layout_[first];
+        bool hit_anything = HitKernels(first, r, ray_data, ray_t, rec);
+        if (hit_anything)
+            ray_t.max = rec.t;
+
+        uint32_t others_first = first + layout.spheres + layout.quads;
+        if (HitRange(others_first, first + count - others_first, r, ray_t, rec))
+            hit_anything = true;
+
+        return hit_anything;
+    };
+    if (!wide_.empty())
+        return wide_.TraverseLeaves(r, ray_t, rec, hit_leaf);
+    return bvh_.TraverseLeaves(r, ray_t, rec, hit_leaf);
+}
+
+void LinearBvhGroup::hit_packet(RayPacket &packet) const
+{
+    simd::RayData ray_data[RayPacket::kMaxSize];
+    for (int i = 0; i < packet.size; i++)
+        ray_data[i] = simd::MakeRayData(packet.rays[i]);
+
+    bvh_.TraversePacket(
+        packet,
+        [&](uint32_t first, uint32_t count, const uint8_t *lanes, int lane_count)
+        {
+            for (int k = 0; k < lane_count; k++)
+            {
+                int i = lanes[k];
+                if (HitKernels(first, packet.rays[i], ray_data[i], packet.ray_t(i), packet.rec[i]))
+                    packet.Record(i);
+            }
+
+            const LeafLayout &layout = leaf_layout_[first];
+            for (uint32_t i = first + layout.spheres + layout.quads; i < first + count; i++)
+                HitLanes(*ordered_[i], packet, lanes, lane_count);
+        });
+}
+
+bool LinearBvhGroup::HitKernels(uint32_t first, const ray &r, const simd::RayData &ray_data, interval ray_t,
+                                HitRecord &rec) const
+{
+    const LeafLayout &layout = leaf_layout_[first];
+    bool hit_anything = false;
+
+    if (layout.spheres > 0)
+    {
+        float t_max = static_cast<float>(ray_t.max);
+        int candidate = simd::ClosestSphere(spheres_.arrays(), first, layout.spheres, ray_data,
+                                            static_cast<float>(ray_t.min), t_max);
+        if (HitCandidate(candidate, first, layout.spheres, r, ray_t, rec))
+        {
+            hit_anything = true;
+            ray_t.max = rec.t;
+        }
+    }
+
+    uint32_t quads_first = first + layout.spheres;
+    if (layout.quads > 0)
+    {
+        float t_max = static_cast<float>(ray_t.max);
+        int candidate = simd::ClosestQuad(quads_.arrays(), quads_first, layout.quads, ray_data,
+                                          static_cast<float>(ray_t.min), t_max);
+        if (HitCandidate(candidate, quads_first, layout.quads, r, ray_t, rec))
+            hit_anything = true;
+    }
+
+    return hit_anything;
+}
+
+void LinearBvhGroup::HitLanes(const Hittable &object, RayPacket &packet, const uint8_t *lanes, int lane_count)
+{
+    if (lane_count == packet.size)
+    {
+        object.hit_packet(packet);
+        return;
+    }
+
+    // Trace the selected rays as a packet of their own and copy their hits back.
+    RayPacket selected;
+    selected.t_min = packet.t_min;
+    for (int k = 0; k < lane_count; k++)
+    {
+        selected.add(packet.rays[lanes[k]]);
+        selected.t_max[k] = packet.t_max[lanes[k]];
+    }
+
+    object.hit_packet(selected);
+
+    for (int k = 0; k < lane_count; k++)
+    {
+        if (selected.hit[k])
+        {
+            packet.rec[lanes[k]] = selected.rec[k];
+            packet.Record(lanes[k]);
+        }
+    }
+}
+
+bool LinearBvhGroup::HitPrimitive(uint32_t i, const ray &r, interval ray_t, HitRecord &rec) const
+{
+    if (dispatch_ == Dispatch::kVirtual)
+        return ordered_[i]->hit(r, ray_t, rec);
+
+    // Qualified calls, so that the exact tests inline rather than go through the vtable.
+    const PrimitiveRef &prim = primitives_[i];
+    switch (prim.kind)
+    {
+    case kSphereKind:
+        return sphere_store_[prim.index].sphere::hit(r, ray_t, rec);
+    case kQuadKind:
+        return quad_store_[prim.index].hit_exact(r, ray_t, rec);
+    default:
+        return ordered_[prim.index]->hit(r, ray_t, rec);
+    }
+}
+
+bool LinearBvhGroup::HitRange(uint32_t first, uint32_t count, const ray &r, interval ray_t, HitRecord &rec) const
+{
+    bool hit_anything = false;
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        if (HitPrimitive(i, r, ray_t, rec))
+        {
+            hit_anything = true;
+            ray_t.max = rec.t;
+        }
+    }
+    return hit_anything;
+}
+
+bool LinearBvhGroup::HitCandidate(int candidate, uint32_t first, uint32_t count, const ray &r, interval ray_t,
+                                  HitRecord &rec) const
+{
+    if (candidate < 0)
+        return false;
+    if (HitPrimitive(uint32_t(candidate), r, ray_t, rec))
+        return true;
+
+    // Rounding made the float kernel accept a primitive the exact test rejects, e.g. at a
+    // silhouette. Test the range exactly instead.
+    return HitRange(first, count, r, ray_t, rec);
+}
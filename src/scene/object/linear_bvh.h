@@ -0,0 +1,358 @@
+#ifndef LINEAR_BVH_H
+#define LINEAR_BVH_H
+
+#include <cstdint>
+#include <vector>
+
+#include "./ptmath/aabb.h"
+#include "./ptmath/simd.h"
+#include "./util/span.h"
+
+#include "object.h"
+#include "bvh.h"
+#include "sphere.h"
+#include "quad.h"
+#include "wide_bvh.h"
+
+namespace scene
+{
+
+    /**
+     * One node of a flattened BVH. Nodes are laid out depth-first, so an interior node's first
+     * child always directly follows it and only the second child's index is stored.
+    */
+    struct LinearBvhNode
+    {
+        float bounds_min[3];
+        float bounds_max[3];
+        uint32_t offset;  // Leaf: first primitive. Interior: index of the second child.
+        uint16_t count;   // Number of primitives in a leaf, 0 for interior nodes.
+        uint8_t axis;     // Split axis of interior nodes, used to pick the near child.
+        uint8_t pad;
+
+        bool is_leaf() const { return count > 0; }
+    };
+
+    static_assert(sizeof(LinearBvhNode) == 32, "LinearBvhNode should fill half a cache line");
+
+    /**
+     * Flattened BVH over a set of primitive bounds. It does not own any primitives: after
+     * Build, leaves refer to contiguous ranges of the primitives reordered by prim_order(),
+     * and callers store their primitives in that order so leaves can be tested by index.
+    */
+    class LinearBvh
+    {
+    public:
+        static const int kStackSize = 64;
+
+        // Leaf shape for primitives tested with the ptmath::simd kernels.
+        static constexpr BvhLeafOptions kSimdLeaves = {8, 4};
+
+        LinearBvh() {}
+
+        // nodes() may point into owned storage, so copies would dangle.
+        LinearBvh(const LinearBvh &) = delete;
+        LinearBvh &operator=(const LinearBvh &) = delete;
+
+        void Build(const std::vector<aabb> &boxes, const BvhLeafOptions &leaves = BvhLeafOptions(),
+                   const BvhBuildOptions &options = BvhBuildOptions());
+
+        // Uses nodes owned by someone else, e.g. a mapped cache file, instead of building them.
+        // The primitives must already be stored in the leaf order of those nodes.
+        void Adopt(util::Span<LinearBvhNode> nodes);
+
+        util::Span<LinearBvhNode> nodes() const { return nodes_; }
+
+        // prim_order()[i] is the original index of the primitive stored at position i.
+        const std::vector<uint32_t> &prim_order() const { return prim_order_; }
+
+        aabb bounds() const;
+
+        // Wall time of the last Build; 0 for adopted nodes.
+        double build_seconds() const { return build_seconds_; }
+
+        // Expected cost of tracing a ray through the tree, in primitive intersections: every node
+        // weighted by the chance that a ray through the root also crosses its bounds.
+        double SahCost(const BvhLeafOptions &leaves = BvhLeafOptions()) const;
+
+        /**
+         * Visits leaves front to back along the ray, calling hit_prim(i, r, ray_t, rec) for every
+         * primitive position i in them. ray_t shrinks to the closest hit found so far.
+        */
+        template <typename PrimHit>
+        bool Traverse(const ray &r, interval ray_t, HitRecord &rec, PrimHit &&hit_prim) const
+        {
+            return TraverseLeaves(r, ray_t, rec,
+                                  [&hit_prim](uint32_t first, uint32_t count, const ray &r, interval ray_t,
+                                              HitRecord &rec)
+                                  {
+                                      bool hit_anything = false;
+                                      for (uint32_t i = first; i < first + count; i++)
+                                      {
+                                          if (hit_prim(i, r, ray_t, rec))
+                                          {
+                                              hit_anything = true;
+                                              ray_t.max = rec.t;
+                                          }
+                                      }
+                                      return hit_anything;
+                                  });
+        }
+
+        /**
+         * Like Traverse, but calls hit_leaf(first, count, r, ray_t, rec) once per leaf so that
+         * its primitives can be tested together. Counts the nodes it reads in node_fetches, when
+         * given.
+        */
+        template <typename LeafHit>
+        bool TraverseLeaves(const ray &r, interval ray_t, HitRecord &rec, LeafHit &&hit_leaf,
+                            size_t *node_fetches = nullptr) const
+        {
+            if (nodes_.empty())
+                return false;
+
+            Vec3 dir = r.direction();
+            Point3 orig = r.origin();
+            double inv_dir[3] = {1 / dir[0], 1 / dir[1], 1 / dir[2]};
+            double org[3] = {orig[0], orig[1], orig[2]};
+            bool dir_is_neg[3] = {inv_dir[0] < 0, inv_dir[1] < 0, inv_dir[2] < 0};
+
+            bool hit_anything = false;
+            uint32_t stack[kStackSize];
+            int stack_size = 0;
+            uint32_t current = 0;
+
+            while (true)
+            {
+                const LinearBvhNode &node = nodes_[current];
+                if (node_fetches)
+                    ++*node_fetches;
+                if (IntersectNode(node, org, inv_dir, dir_is_neg, ray_t))
+                {
+                    if (node.is_leaf())
+                    {
+                        if (hit_leaf(node.offset, node.count, r, ray_t, rec))
+                        {
+                            hit_anything = true;
+                            ray_t.max = rec.t;
+                        }
+                    }
+                    else if (dir_is_neg[node.axis])
+                    {
+                        // The second child lies nearer along this axis; visit it first.
+                        stack[stack_size++] = current + 1;
+                        current = node.offset;
+                        continue;
+                    }
+                    else
+                    {
+                        stack[stack_size++] = node.offset;
+                        current = current + 1;
+                        continue;
+                    }
+                }
+
+                if (stack_size == 0)
+                    break;
+                current = stack[--stack_size];
+            }
+
+            return hit_anything;
+        }
+
+        /**
+         * Packet version of TraverseLeaves. Nodes are culled for the whole packet: a node is
+         * skipped once no ray reaches it, and rays before the first one that does are not tested
+         * again below it. hit_leaf(first, count, lanes, lane_count) receives the indices of the
+         * rays that reach the leaf and must Record their hits in the packet.
+        */
+        template <typename LeafHit>
+        void TraversePacket(RayPacket &packet, LeafHit &&hit_leaf) const
+        {
+            if (nodes_.empty() || packet.size == 0)
+                return;
+
+            double inv_dir[RayPacket::kMaxSize][3];
+            double org[RayPacket::kMaxSize][3];
+            bool dir_is_neg[RayPacket::kMaxSize][3];
+            for (int i = 0; i < packet.size; i++)
+            {
+                Vec3 dir = packet.rays[i].direction();
+                Point3 orig = packet.rays[i].origin();
+                for (int a = 0; a < 3; a++)
+                {
+                    inv_dir[i][a] = 1 / dir[a];
+                    org[i][a] = orig[a];
+                    dir_is_neg[i][a] = inv_dir[i][a] < 0;
+                }
+            }
+
+            auto reaches = [&](const LinearBvhNode &node, int i)
+            { return IntersectNode(node, org[i], inv_dir[i], dir_is_neg[i], packet.ray_t(i)); };
+
+            // Coherent rays mostly agree on direction signs, so the first ray orders the children.
+            const bool *order = dir_is_neg[0];
+
+            struct Entry
+            {
+                uint32_t node;
+                int first_ray;
+            };
+            Entry stack[kStackSize];
+            int stack_size = 0;
+            Entry current = {0, 0};
+            uint8_t lanes[RayPacket::kMaxSize];
+
+            while (true)
+            {
+                const LinearBvhNode &node = nodes_[current.node];
+                int first = current.first_ray;
+                while (first < packet.size && !reaches(node, first))
+                    first++;
+
+                if (first < packet.size)
+                {
+                    if (node.is_leaf())
+                    {
+                        int lane_count = 0;
+                        lanes[lane_count++] = static_cast<uint8_t>(first);
+                        for (int i = first + 1; i < packet.size; i++)
+                        {
+                            if (reaches(node, i))
+                                lanes[lane_count++] = static_cast<uint8_t>(i);
+                        }
+                        hit_leaf(node.offset, node.count, lanes, lane_count);
+                    }
+                    else if (order[node.axis])
+                    {
+                        stack[stack_size++] = {current.node + 1, first};
+                        current = {node.offset, first};
+                        continue;
+                    }
+                    else
+                    {
+                        stack[stack_size++] = {node.offset, first};
+                        current = {current.node + 1, first};
+                        continue;
+                    }
+                }
+
+                if (stack_size == 0)
+                    break;
+                current = stack[--stack_size];
+            }
+        }
+
+    private:
+        std::vector<LinearBvhNode> owned_nodes_;
+        util::Span<LinearBvhNode> nodes_;
+        std::vector<uint32_t> prim_order_;
+        double build_seconds_ = 0;
+
+        static bool IntersectNode(const LinearBvhNode &node, const double org[3], const double inv_dir[3],
+                                  const bool dir_is_neg[3], const interval &ray_t)
+        {
+            // Bounds are stored as floats rounded outwards, but the slab test runs in double so
+            // the ray origin is not rounded.
+            double t_min = ray_t.min;
+            double t_max = ray_t.max;
+            for (int a = 0; a < 3; a++)
+            {
+                double near = dir_is_neg[a] ? node.bounds_max[a] : node.bounds_min[a];
+                double far = dir_is_neg[a] ? node.bounds_min[a] : node.bounds_max[a];
+                double t0 = (near - org[a]) * inv_dir[a];
+                double t1 = (far - org[a]) * inv_dir[a];
+                // Written so that a NaN from 0 * inf on a slab boundary leaves the interval alone.
+                t_min = t0 > t_min ? t0 : t_min;
+                t_max = t1 < t_max ? t1 : t_max;
+            }
+            return t_min <= t_max;
+        }
+    };
+
+    /**
+     * Hittable that stores the objects of a HittableGroup in LinearBvh leaf order, replacing the
+     * pointer tree of BvhNode with one contiguous node array and a flat object array. Nested
+     * groups are flattened into it.
+     *
+     * Each leaf lists its spheres first, then its quads, then everything else. Spheres and quads
+     * are also copied into float arrays and tested with the ptmath::simd kernels; only the
+     * closest candidate is then intersected in double to fill in the hit record, on a copy kept
+     * in a store of its type and called without virtual dispatch (see Dispatch).
+    */
+    class LinearBvhGroup : public Hittable
+    {
+    public:
+        LinearBvhGroup(const HittableGroup &group, Dispatch dispatch = Dispatch::kClosedSet,
+                       const BvhBuildOptions &build = BvhBuildOptions());
+
+        bool hit(const ray &r, interval ray_t, HitRecord &rec) const override;
+
+        void hit_packet(RayPacket &packet) const override;
+
+        aabb bounding_box() const override { return bbox_; }
+
+        // Hashes the objects in the order they were added, not the tree built over them.
+        void HashContent(util::Hash &hash) const override
+        {
+            for (const auto &object : objects_)
+                object->HashContent(hash);
+        }
+
+        const LinearBvh &bvh() const { return bvh_; }
+        const WideBvh &wide_bvh() const { return wide_; }
+
+        // The flattened objects, in the order they were added.
+        const std::vector<shared_ptr<Hittable>> &objects() const { return objects_; }
+
+        // Bytes of the nodes and of the object and kernel arrays, not counting the objects.
+        size_t memory_usage() const;
+
+    private:
+        struct LeafLayout
+        {
+            uint16_t spheres;
+            uint16_t quads;
+        };
+
+        // Where the primitive at a leaf position lives: kind says which store index is into,
+        // sphere_store_, quad_store_, or ordered_ for every other type.
+        struct PrimitiveRef
+        {
+            uint32_t kind;
+            uint32_t index;
+        };
+
+        Dispatch dispatch_;
+        LinearBvh bvh_;
+        WideBvh wide_; // Traversed by single rays instead of bvh_ when built
+        std::vector<shared_ptr<Hittable>> objects_; // Keeps the objects alive
+        std::vector<const Hittable *> ordered_;     // Leaf order, indexed by the BVH
+        std::vector<LeafLayout> leaf_layout_;       // Indexed by the first position of each leaf
+        simd::SphereSoA spheres_;
+        simd::QuadSoA quads_;
+        std::vector<PrimitiveRef> primitives_; // Leaf order
+        std::vector<sphere> sphere_store_;
+        std::vector<quad> quad_store_;
+        aabb bbox_;
+
+        // Exact test of the primitive at leaf position i, through a switch over its kind unless
+        // dispatch_ is kVirtual.
+        bool HitPrimitive(uint32_t i, const ray &r, interval ray_t, HitRecord &rec) const;
+
+        // Tests the spheres and quads of the leaf starting at first with the SIMD kernels.
+        bool HitKernels(uint32_t first, const ray &r, const simd::RayData &ray_data, interval ray_t,
+                        HitRecord &rec) const;
+
+        bool HitRange(uint32_t first, uint32_t count, const ray &r, interval ray_t, HitRecord &rec) const;
+
+        // Traces the rays lanes[0, lane_count) of packet against object.
+        static void HitLanes(const Hittable &object, RayPacket &packet, const uint8_t *lanes, int lane_count);
+
+        bool HitCandidate(int candidate, uint32_t first, uint32_t count, const ray &r, interval ray_t,
+                          HitRecord &rec) const;
+    };
+
+}
+
+#endif
@@ -0,0 +1,499 @@
+#include "mesh.h"
+
+#include "./ptmath/tri3.h"
+#include "material.h"
+#include "material_table.h"
+
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+#include <unordered_map>
+
+using namespace scene;
+using namespace ptmath;
+
+// Mesh
+
+namespace
+{
+    // Widens the t interval of the triangle kernel, whose t can differ from the exact test's by
+    // a few ulps since it divides by the determinant rather than multiplying by its inverse.
+    [[maybe_unused]] const float kKernelTPad = 1.000001f;
+}
+
+void Mesh::Finalize(Data &&data, const BvhBuildOptions &build)
+{
+    owned_ = std::move(data);
+    mapping_ = nullptr;
+
+    std::vector<aabb> boxes;
+    boxes.reserve(owned_.triangles.size());
+    for (const Triangle &tri : owned_.triangles)
+    {
+        const Point3 &p0 = owned_.vertices[tri.vertex[0]];
+        const Point3 &p1 = owned_.vertices[tri.vertex[1]];
+        const Point3 &p2 = owned_.vertices[tri.vertex[2]];
+        boxes.push_back(aabb(aabb(p0, p1), aabb(p2, p2)).pad());
+    }
+
+    bvh_.Build(boxes, LinearBvh::kSimdLeaves, build);
+    bvh_builder_ = build.builder;
+    if (build.wide)
+        wide_bvh_.Build(bvh_);
+    else
+        wide_bvh_.Clear();
+    bbox_ = bvh_.bounds();
+
+    std::vector<Triangle> ordered;
+    ordered.reserve(owned_.triangles.size());
+    for (uint32_t index : bvh_.prim_order())
+        ordered.push_back(owned_.triangles[index]);
+    owned_.triangles.swap(ordered);
+
+    vertices_ = owned_.vertices;
+    normals_ = owned_.normals;
+    uvs_ = owned_.uvs;
+    triangles_ = owned_.triangles;
+    material_descs_ = owned_.materials;
+    CreateMaterials();
+    CreateVertexArrays();
+}
+
+void Mesh::CreateMaterials()
+{
+    materials_.clear();
+    for (const MaterialDesc &desc : material_descs_)
+    {
+        if (desc.emission.length_squared() > 0)
+            materials_.push_back(make_shared<Light>(desc.emission));
+        else
+            materials_.push_back(make_shared<Lambertian>(desc.diffuse));
+    }
+    material_ids_.assign(materials_.size(), kNoMaterial);
+}
+
+void Mesh::InternMaterials(MaterialTable &materials)
+{
+    for (size_t i = 0; i < materials_.size(); i++)
+        material_ids_[i] = materials.Intern(materials_[i]);
+}
+
+void Mesh::CreateVertexArrays()
+{
+#ifdef PTMATH_FLOAT
+    vertex_arrays_ = simd::TriangleSoA(triangles_.size());
+    for (size_t i = 0; i < triangles_.size(); i++)
+    {
+        const Triangle &tri = triangles_[i];
+        vertex_arrays_.Set(i, vertices_[tri.vertex[0]], vertices_[tri.vertex[1]], vertices_[tri.vertex[2]]);
+    }
+#endif
+}
+
+void Mesh::HashContent(util::Hash &hash) const
+{
+    hash.Add(typeid(*this).name());
+    hash.Add(vertices_.data(), vertices_.size() * sizeof(Point3));
+    hash.Add(normals_.data(), normals_.size() * sizeof(Vec3));
+    hash.Add(uvs_.data(), uvs_.size() * sizeof(Uv));
+    hash.Add(triangles_.data(), triangles_.size() * sizeof(Triangle));
+    hash.Add(material_descs_.data(), material_descs_.size() * sizeof(MaterialDesc));
+    hash.Add(bvh_.nodes().data(), bvh_.nodes().size() * sizeof(LinearBvhNode));
+    hash.Add(uint32_t(bvh_builder_));
+    hash.Add(material_ids_.data(), material_ids_.size() * sizeof(MaterialId));
+}
+
+size_t Mesh::memory_usage() const
+{
+    // Mapped arrays are counted too, although they live in the page cache rather than the heap.
+    return vertices_.size() * sizeof(Point3) + normals_.size() * sizeof(Vec3) + uvs_.size() * sizeof(Uv) +
+           triangles_.size() * sizeof(Triangle) + bvh_.nodes().size() * sizeof(LinearBvhNode) +
+           bvh_.prim_order().size() * sizeof(uint32_t) + wide_bvh_.memory_usage() + vertex_arrays_.memory_usage();
+}
+
+bool Mesh::hit(const ray &r, interval ray_t, HitRecord &rec) const
+{
+    TriangleRay tri_ray(r);
+    simd::RayData ray_data = simd::MakeRayData(r, tri_ray);
+
+    auto hit_leaf = [&](uint32_t first, uint32_t count, const ray &r, interval ray_t, HitRecord &rec)
+    { return HitLeaf(first, count, r, tri_ray, ray_data, ray_t, rec); };
+    if (!wide_bvh_.empty())
+        return wide_bvh_.TraverseLeaves(r, ray_t, rec, hit_leaf);
+    return bvh_.TraverseLeaves(r, ray_t, rec, hit_leaf);
+}
+
+void Mesh::hit_packet(RayPacket &packet) const
+{
+    TriangleRay tri_rays[RayPacket::kMaxSize];
+    simd::RayData ray_data[RayPacket::kMaxSize];
+    for (int i = 0; i < packet.size; i++)
+    {
+        tri_rays[i] = TriangleRay(packet.rays[i]);
+        ray_data[i] = simd::MakeRayData(packet.rays[i], tri_rays[i]);
+    }
+
+    bvh_.TraversePacket(packet,
+                        [&](uint32_t first, uint32_t count, const uint8_t *lanes, int lane_count)
+                        {
+                            for (int k = 0; k < lane_count; k++)
+                            {
+                                int i = lanes[k];
+                                if (HitLeaf(first, count, packet.rays[i], tri_rays[i], ray_data[i],
+                                            packet.ray_t(i), packet.rec[i]))
+                                    packet.Record(i);
+                            }
+                        });
+}
+
+bool Mesh::HitLeaf(uint32_t first, uint32_t count, const ray &r, const TriangleRay &tri_ray,
+                   const simd::RayData &ray_data, interval ray_t, HitRecord &rec) const
+{
+#ifdef PTMATH_FLOAT
+    // With float vertices the kernel's edge functions are those of the exact test, and it counts
+    // zero ones as inside, so it misses only where the exact test does and most leaves are
+    // rejected by it alone. Its t is rounded differently, though, so the interval is widened and
+    // a leaf it hits is settled by the exact test: at a shared edge the two triangles can be one
+    // ulp apart. Its candidate goes first, which usually leaves the others nothing to beat.
+    float t_max = static_cast<float>(ray_t.max) * kKernelTPad;
+    int candidate = simd::ClosestTriangle(vertex_arrays_.arrays(), first, count, ray_data,
+                                          static_cast<float>(ray_t.min) / kKernelTPad, t_max);
+    if (candidate < 0)
+        return false;
+
+    bool hit_anything = HitTriangle(triangles_[candidate], r, tri_ray, ray_t, rec);
+    if (hit_anything)
+        ray_t.max = rec.t;
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        if (i != uint32_t(candidate) && HitTriangle(triangles_[i], r, tri_ray, ray_t, rec))
+        {
+            hit_anything = true;
+            ray_t.max = rec.t;
+        }
+    }
+    return hit_anything;
+#else
+    // Double vertices are rounded to float before the kernel's subtractions but after the exact
+    // test's, so near an edge the kernel can miss a triangle the exact test hits; every triangle
+    // of the leaf gets the exact test instead.
+    (void)ray_data;
+    bool hit_anything = false;
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        if (HitTriangle(triangles_[i], r, tri_ray, ray_t, rec))
+        {
+            hit_anything = true;
+            ray_t.max = rec.t;
+        }
+    }
+    return hit_anything;
+#endif
+}
+
+bool Mesh::HitTriangle(const Triangle &tri, const ray &r, const TriangleRay &tri_ray, interval ray_t,
+                       HitRecord &rec) const
+{
+    const Point3 &p0 = vertices_[tri.vertex[0]];
+    const Point3 &p1 = vertices_[tri.vertex[1]];
+    const Point3 &p2 = vertices_[tri.vertex[2]];
+
+    Real t, b1, b2;
+    if (!IntersectTriangle(p0, p1, p2, tri_ray, t, b1, b2) || !ray_t.surrounds(t))
+        return false;
+    Real b0 = 1 - b1 - b2;
+
+    rec.t = t;
+    rec.p = r.at(t);
+    rec.mat = tri.material == kNoIndex ? kNoMaterial : material_ids_[tri.material];
+
+    if (tri.uv[0] != kNoIndex)
+    {
+        const Uv &t0 = uvs_[tri.uv[0]], &t1 = uvs_[tri.uv[1]], &t2 = uvs_[tri.uv[2]];
+        rec.u = b0 * t0.u + b1 * t1.u + b2 * t2.u;
+        rec.v = b0 * t0.v + b1 * t1.v + b2 * t2.v;
+    }
+    else
+    {
+        rec.u = b1;
+        rec.v = b2;
+    }
+
+    // The face orientation comes from the geometric normal; vertex normals only shade.
+    rec.set_face_normal(r, unit_vector(cross(p1 - p0, p2 - p0)));
+    if (tri.normal[0] != kNoIndex)
+    {
+        Vec3 shading = unit_vector(b0 * normals_[tri.normal[0]] + b1 * normals_[tri.normal[1]] +
+                                   b2 * normals_[tri.normal[2]]);
+        rec.normal = rec.front_face ? shading : -shading;
+    }
+
+    return true;
+}
+
+// OBJ loading
+
+namespace
+{
+    bool ReadFile(const std::string &path, std::string &contents)
+    {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (!file)
+            return false;
+
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+
+        contents.resize(size > 0 ? size : 0);
+        size_t read = fread(contents.data(), 1, contents.size(), file);
+        fclose(file);
+        return read == contents.size();
+    }
+
+    std::string Directory(const std::string &path)
+    {
+        auto slash = path.find_last_of('/');
+        return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+    }
+
+    /**
+     * Minimal tokenizer over one line of an OBJ or MTL file.
+    */
+    class LineReader
+    {
+    public:
+        LineReader(const char *begin, const char *end) : p_(begin), end_(end) {}
+
+        std::string_view Token()
+        {
+            SkipSpaces();
+            const char *start = p_;
+            while (p_ < end_ && *p_ != ' ' && *p_ != '\t' && *p_ != '\r')
+                p_++;
+            return std::string_view(start, p_ - start);
+        }
+
+        // Everything left on the line, without surrounding whitespace.
+        std::string_view Rest()
+        {
+            SkipSpaces();
+            const char *last = end_;
+            while (last > p_ && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r'))
+                last--;
+            return std::string_view(p_, last - p_);
+        }
+
+        double Double()
+        {
+            SkipSpaces();
+            double x = 0;
+            auto result = std::from_chars(p_, end_, x);
+            p_ = result.ptr;
+            return x;
+        }
+
+        Vec3 Vector()
+        {
+            double x = Double();
+            double y = Double();
+            double z = Double();
+            return Vec3(x, y, z);
+        }
+
+        // Parses one "v", "v/t", "v//n" or "v/t/n" face vertex. Missing parts are left at 0.
+        bool FaceVertex(long &v, long &t, long &n)
+        {
+            SkipSpaces();
+            v = t = n = 0;
+            if (p_ >= end_ || *p_ == '\r')
+                return false;
+
+            p_ = std::from_chars(p_, end_, v).ptr;
+            if (p_ < end_ && *p_ == '/')
+            {
+                p_++;
+                if (p_ < end_ && *p_ != '/')
+                    p_ = std::from_chars(p_, end_, t).ptr;
+                if (p_ < end_ && *p_ == '/')
+                    p_ = std::from_chars(p_ + 1, end_, n).ptr;
+            }
+
+            // Skip anything unexpected so a malformed vertex cannot stall the parser.
+            while (p_ < end_ && *p_ != ' ' && *p_ != '\t')
+                p_++;
+            return v != 0;
+        }
+
+    private:
+        const char *p_;
+        const char *end_;
+
+        void SkipSpaces()
+        {
+            while (p_ < end_ && (*p_ == ' ' || *p_ == '\t'))
+                p_++;
+        }
+    };
+
+    template <typename F>
+    void ForEachLine(const std::string &contents, F &&fn)
+    {
+        const char *p = contents.data();
+        const char *end = p + contents.size();
+        while (p < end)
+        {
+            const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+            if (!eol)
+                eol = end;
+            LineReader line(p, eol);
+            fn(line);
+            p = eol + 1;
+        }
+    }
+
+    // Converts a 1-based (or negative, relative) OBJ index to a 0-based one.
+    uint32_t ResolveIndex(long index, size_t count)
+    {
+        if (index > 0 && static_cast<size_t>(index) <= count)
+            return static_cast<uint32_t>(index - 1);
+        if (index < 0 && static_cast<size_t>(-index) <= count)
+            return static_cast<uint32_t>(count + index);
+        return Mesh::kNoIndex;
+    }
+
+    void LoadMtl(const std::string &path, std::unordered_map<std::string, uint32_t> &material_ids,
+                 std::vector<Mesh::MaterialDesc> &materials)
+    {
+        std::string contents;
+        if (!ReadFile(path, contents))
+        {
+            std::clog << "Could not read material library " << path << "\n";
+            return;
+        }
+
+        Mesh::MaterialDesc *current = nullptr;
+        ForEachLine(contents, [&](LineReader &line)
+                    {
+            std::string_view keyword = line.Token();
+            if (keyword == "newmtl")
+            {
+                material_ids[std::string(line.Rest())] = static_cast<uint32_t>(materials.size());
+                materials.push_back({color(0.5, 0.5, 0.5), color(0, 0, 0)});
+                current = &materials.back();
+            }
+            else if (keyword == "Kd" && current)
+                current->diffuse = line.Vector();
+            else if (keyword == "Ke" && current)
+                current->emission = line.Vector(); });
+    }
+}
+
+ObjMesh::ObjMesh(const std::string &path, bool use_cache, const BvhBuildOptions &build)
+{
+    std::string cache_path = path + ".ptcache";
+    util::FileStamp stamp;
+    bool have_stamp = util::GetFileStamp(path, stamp);
+    if (use_cache && have_stamp && LoadCache(cache_path, stamp, build))
+        return;
+
+    std::string contents;
+    if (!ReadFile(path, contents))
+    {
+        std::clog << "Could not read mesh " << path << "\n";
+        return;
+    }
+
+    Data data;
+
+    std::string dir = Directory(path);
+    std::vector<Dependency> libraries;
+    std::unordered_map<std::string, uint32_t> material_ids;
+    uint32_t current_material = kNoIndex;
+
+    // Scratch for the vertices of the current polygon.
+    std::vector<uint32_t> face_v, face_t, face_n;
+
+    ForEachLine(contents, [&](LineReader &line)
+                {
+        std::string_view keyword = line.Token();
+        if (keyword == "v")
+        {
+            data.vertices.push_back(line.Vector());
+        }
+        else if (keyword == "vn")
+        {
+            data.normals.push_back(line.Vector());
+        }
+        else if (keyword == "vt")
+        {
+            double u = line.Double();
+            double v = line.Double();
+            data.uvs.push_back({u, v});
+        }
+        else if (keyword == "f")
+        {
+            face_v.clear();
+            face_t.clear();
+            face_n.clear();
+
+            long v, t, n;
+            while (line.FaceVertex(v, t, n))
+            {
+                face_v.push_back(ResolveIndex(v, data.vertices.size()));
+                face_t.push_back(ResolveIndex(t, data.uvs.size()));
+                face_n.push_back(ResolveIndex(n, data.normals.size()));
+            }
+
+            // Fan-triangulate the polygon around its first vertex.
+            for (size_t k = 1; k + 1 < face_v.size(); k++)
+            {
+                size_t corners[3] = {0, k, k + 1};
+                Triangle tri;
+                bool valid = true;
+                bool has_uv = true, has_normal = true;
+                for (int c = 0; c < 3; c++)
+                {
+                    tri.vertex[c] = face_v[corners[c]];
+                    tri.uv[c] = face_t[corners[c]];
+                    tri.normal[c] = face_n[corners[c]];
+                    valid &= tri.vertex[c] != kNoIndex;
+                    has_uv &= tri.uv[c] != kNoIndex;
+                    has_normal &= tri.normal[c] != kNoIndex;
+                }
+                if (!valid)
+                    continue;
+                if (!has_uv)
+                    tri.uv[0] = tri.uv[1] = tri.uv[2] = kNoIndex;
+                if (!has_normal)
+                    tri.normal[0] = tri.normal[1] = tri.normal[2] = kNoIndex;
+                tri.material = current_material;
+                data.triangles.push_back(tri);
+            }
+        }
+        else if (keyword == "usemtl")
+        {
+            auto it = material_ids.find(std::string(line.Rest()));
+            current_material = it == material_ids.end() ? kNoIndex : it->second;
+        }
+        else if (keyword == "mtllib")
+        {
+            Dependency library;
+            library.path = dir + std::string(line.Rest());
+            library.exists = util::GetFileStamp(library.path, library.stamp);
+            LoadMtl(library.path, material_ids, data.materials);
+            libraries.push_back(library);
+        } });
+
+    data.vertices.shrink_to_fit();
+    data.normals.shrink_to_fit();
+    data.uvs.shrink_to_fit();
+    data.triangles.shrink_to_fit();
+
+    Finalize(std::move(data), build);
+
+    if (use_cache && have_stamp)
+        WriteCache(cache_path, stamp, libraries);
+}
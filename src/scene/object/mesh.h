@@ -1,24 +1,163 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "./ptmath/vec3.h"
+#include "./ptmath/tri3.h"
+#include "./ptmath/simd.h"
+#include "./graphics/color.h"
+#include "./util/span.h"
+#include "./util/mapped_file.h"
+
 #include "object.h"
-#include "string.h"
+#include "linear_bvh.h"
+#include "wide_bvh.h"
 
 namespace scene
 {
 
-    class Mesh: public HittableGroup
+    class Material;
+
+    /**
+     * Indexed triangle mesh. Positions, normals and texture coordinates are stored once in
+     * shared arrays; each triangle only holds indices into them and into the material table.
+     * Triangles are kept in the leaf order of the mesh's own LinearBvh. In float builds its leaves
+     * are tested with the ptmath::simd triangle kernel, in double builds with the exact test alone.
+     * Single rays traverse its WideBvh instead when it was built with BvhBuildOptions::wide.
+     *
+     * The arrays are either owned by the mesh or borrowed from a memory-mapped cache file.
+    */
+    class Mesh : public Hittable
     {
-        public:
+    public:
+        static const uint32_t kNoIndex = UINT32_MAX;
+
+        struct Uv
+        {
+            double u, v;
+        };
+
+        struct Triangle
+        {
+            uint32_t vertex[3];
+            uint32_t normal[3];   // kNoIndex when the face has no vertex normals
+            uint32_t uv[3];       // kNoIndex when the face has no texture coordinates
+            uint32_t material;    // kNoIndex for the default material
+        };
+
+        // Plain description of a material, so that it can be cached alongside the geometry.
+        struct MaterialDesc
+        {
+            color diffuse;
+            color emission;
+        };
+
+        struct Data
+        {
+            std::vector<Point3> vertices;
+            std::vector<Vec3> normals;
+            std::vector<Uv> uvs;
+            std::vector<Triangle> triangles;
+            std::vector<MaterialDesc> materials;
+        };
+
         virtual ~Mesh() = default;
 
+        bool hit(const ray &r, interval ray_t, HitRecord &rec) const override;
+
+        void hit_packet(RayPacket &packet) const override;
+
+        aabb bounding_box() const override { return bbox_; }
+
+        void InternMaterials(MaterialTable &materials) override;
+
+        // Hashes the arrays a cache file holds, which include the BVH, and the material ids.
+        void HashContent(util::Hash &hash) const override;
+
+        size_t vertex_count() const { return vertices_.size(); }
+        size_t triangle_count() const { return triangles_.size(); }
+
+        util::Span<Point3> vertices() const { return vertices_; }
+        util::Span<Triangle> triangles() const { return triangles_; }
+        size_t memory_usage() const;
+
+        const LinearBvh &bvh() const { return bvh_; }
+        const WideBvh &wide_bvh() const { return wide_bvh_; }
+        BvhBuilder bvh_builder() const { return bvh_builder_; }
+
+        // True when the geometry is borrowed from a mapped cache file rather than parsed.
+        bool from_cache() const { return mapping_ != nullptr; }
+
+    protected:
+        // Takes ownership of data, builds the BVH and reorders the triangles into its leaf order.
+        void Finalize(Data &&data, const BvhBuildOptions &build = BvhBuildOptions());
+
+        // A file besides the source that the mesh was read from, such as a material library,
+        // stamped before it was read. exists is false if it could not be read.
+        struct Dependency
+        {
+            std::string path;
+            bool exists = false;
+            util::FileStamp stamp;
+        };
+
+        // Loads the mesh from a cache file written by WriteCache for a source with this stamp.
+        // Returns false, leaving the mesh untouched, if the file is missing or stale, if one of
+        // its dependencies changed, or if its BVHs came from a build other than build's.
+        bool LoadCache(const std::string &cache_path, const util::FileStamp &source, const BvhBuildOptions &build);
+
+        // Writes the mesh, including its BVHs and float triangles, to a cache file. Failures are
+        // only logged.
+        void WriteCache(const std::string &cache_path, const util::FileStamp &source,
+                        const std::vector<Dependency> &dependencies) const;
+
+    private:
+        Data owned_;
+        std::shared_ptr<util::MappedFile> mapping_;
+
+        util::Span<Point3> vertices_;
+        util::Span<Vec3> normals_;
+        util::Span<Uv> uvs_;
+        util::Span<Triangle> triangles_;
+        util::Span<MaterialDesc> material_descs_;
+        std::vector<shared_ptr<Material>> materials_; // Made from material_descs_
+        std::vector<MaterialId> material_ids_;        // Of materials_, in the scene compiled last
+
+        LinearBvh bvh_;
+        BvhBuilder bvh_builder_ = BvhBuilder::kSah;
+        WideBvh wide_bvh_;
+        simd::TriangleSoA vertex_arrays_; // Float copies of each triangle's vertices, in leaf order; float builds only
+        aabb bbox_;
+
+        void CreateMaterials();
+        void CreateVertexArrays();
+
+        // Closest hit among the triangles of one BVH leaf.
+        bool HitLeaf(uint32_t first, uint32_t count, const ray &r, const TriangleRay &tri_ray,
+                     const simd::RayData &ray_data, interval ray_t, HitRecord &rec) const;
+
+        bool HitTriangle(const Triangle &tri, const ray &r, const TriangleRay &tri_ray, interval ray_t,
+                         HitRecord &rec) const;
     };
 
-    class ObjMesh: public Mesh {
-        public:
-        ObjMesh(char* dir) {}
+    /**
+     * Mesh loaded from a Wavefront OBJ file. Polygons are fan-triangulated, and materials
+     * come from the MTL libraries it references: Kd becomes a Lambertian and a non-black Ke
+     * a Light. Faces without a material use the default material.
+     *
+     * Unless use_cache is false, the parsed mesh is saved next to the OBJ file as
+     * "<path>.ptcache" and memory-mapped on later runs while the OBJ's size and mtime match.
+     * build picks how the BVH of a freshly parsed mesh is built.
+    */
+    class ObjMesh : public Mesh
+    {
+    public:
+        ObjMesh(const std::string &path, bool use_cache = true, const BvhBuildOptions &build = BvhBuildOptions());
     };
 
 }
 
-#endif
\ No newline at end of file
+#endif
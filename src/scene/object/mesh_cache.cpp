@@ -0,0 +1,345 @@
+#include "mesh.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace scene;
+using namespace ptmath;
+
+// Binary mesh cache. The file is a fixed header followed by the mesh arrays exactly as they are
+// laid out in memory, each starting on a 64-byte boundary, so a mapped file can be used in place.
+// That includes the structures derived from the geometry, the wide BVH and the float triangles,
+// so a cached load does no work proportional to the mesh beyond checking its indices.
+
+namespace
+{
+    const char kCacheMagic[8] = {'P', 'T', 'M', 'E', 'S', 'H', 0, 0};
+    const uint32_t kCacheVersion = 4;
+    const uint64_t kSectionAlignment = 64;
+
+    enum Section
+    {
+        kVertices,
+        kNormals,
+        kUvs,
+        kTriangles,
+        kMaterials,
+        kBvhNodes,
+        kWideNodes,
+        kWideLeaves,
+        kVertexArrays, // TriangleSoA block, float builds only
+        kDependencies,
+        kDependencyPaths,
+        kSectionCount
+    };
+
+    // Stamp of a Mesh::Dependency, whose path is bytes [path_offset, path_offset + path_length)
+    // of kDependencyPaths.
+    struct DependencyRecord
+    {
+        static const uint64_t kMissing = UINT64_MAX; // size of a dependency that did not exist
+
+        uint64_t size;
+        int64_t mtime_ns;
+        uint64_t path_offset;
+        uint64_t path_length;
+    };
+
+    struct CacheHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t point_size;         // sizeof(Point3), so caches from builds with another Vec3 are rejected
+        uint32_t bvh_builder;        // BvhBuilder of the cached nodes
+        uint32_t wide_bvh;           // Whether the wide BVH sections are filled in
+        uint64_t source_size;
+        int64_t source_mtime_ns;
+        uint64_t count[kSectionCount];
+        uint64_t offset[kSectionCount];
+    };
+
+    const size_t kElementSize[kSectionCount] = {
+        sizeof(Point3), sizeof(Vec3), sizeof(Mesh::Uv), sizeof(Mesh::Triangle),
+        sizeof(Mesh::MaterialDesc), sizeof(LinearBvhNode), sizeof(WideBvhNode), sizeof(WideBvhLeaf),
+        sizeof(float), sizeof(DependencyRecord), sizeof(char)};
+
+    uint64_t AlignUp(uint64_t x)
+    {
+        return (x + kSectionAlignment - 1) / kSectionAlignment * kSectionAlignment;
+    }
+
+    template <typename T>
+    util::Span<T> SectionSpan(const util::MappedFile &file, const CacheHeader &header, Section s)
+    {
+        return util::Span<T>(reinterpret_cast<const T *>(file.data() + header.offset[s]), header.count[s]);
+    }
+
+    bool ValidCorners(const uint32_t (&index)[3], uint64_t count, bool optional)
+    {
+        if (optional && index[0] == Mesh::kNoIndex)
+            return true;
+        return index[0] < count && index[1] < count && index[2] < count;
+    }
+
+    /**
+     * Checks the cached wide BVH the way ValidPayload checks the binary one. Interior children
+     * must come after their parent, which keeps the walk finite, and the depth must fit what
+     * WideBvh::kStackSize was sized for.
+    */
+    bool ValidWideBvh(const util::MappedFile &file, const CacheHeader &header)
+    {
+        util::Span<WideBvhNode> nodes = SectionSpan<WideBvhNode>(file, header, kWideNodes);
+        util::Span<WideBvhLeaf> leaves = SectionSpan<WideBvhLeaf>(file, header, kWideLeaves);
+        if (!header.wide_bvh)
+            return nodes.empty() && leaves.empty();
+        if (nodes.empty() || header.count[kBvhNodes] == 0)
+            return false;
+
+        for (const WideBvhLeaf &leaf : leaves)
+        {
+            if (uint64_t(leaf.offset) + leaf.count > header.count[kTriangles])
+                return false;
+        }
+
+        struct Entry
+        {
+            uint64_t node;
+            int depth;
+        };
+        std::vector<Entry> stack = {{0, 1}};
+        uint64_t visited = 0;
+        while (!stack.empty())
+        {
+            Entry entry = stack.back();
+            stack.pop_back();
+            if (++visited > nodes.size() || entry.depth > LinearBvh::kStackSize)
+                return false;
+
+            const WideBvhNode &node = nodes[entry.node];
+            if (node.boxes.child_count > simd::kWideBvhWidth)
+                return false;
+            for (int i = 0; i < node.boxes.child_count; i++)
+            {
+                uint8_t meta = node.child_meta[i];
+                if (meta & WideBvhNode::kLeafBit)
+                {
+                    if (uint64_t(node.leaf_base) + (meta & ~WideBvhNode::kLeafBit) >= leaves.size())
+                        return false;
+                    continue;
+                }
+                uint64_t child = uint64_t(node.child_base) + meta;
+                if (child <= entry.node || child >= nodes.size())
+                    return false;
+                stack.push_back({child, entry.depth + 1});
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Checks that every index in the cached triangles and BVH nodes is in range, so a corrupt or
+     * truncated payload is rebuilt from the source rather than read out of bounds when rendering.
+     */
+    bool ValidPayload(const util::MappedFile &file, const CacheHeader &header)
+    {
+        for (const Mesh::Triangle &tri : SectionSpan<Mesh::Triangle>(file, header, kTriangles))
+        {
+            if (!ValidCorners(tri.vertex, header.count[kVertices], false) ||
+                !ValidCorners(tri.normal, header.count[kNormals], true) ||
+                !ValidCorners(tri.uv, header.count[kUvs], true) ||
+                (tri.material != Mesh::kNoIndex && tri.material >= header.count[kMaterials]))
+                return false;
+        }
+
+        // Walk the tree the way traversal does: each node must be reached once, leaves must stay
+        // inside the triangles and the depth must fit the traversal stack.
+        util::Span<LinearBvhNode> nodes = SectionSpan<LinearBvhNode>(file, header, kBvhNodes);
+        if (nodes.size() == 0)
+            return header.count[kTriangles] == 0 && ValidWideBvh(file, header);
+
+        struct Entry
+        {
+            uint64_t node;
+            int depth;
+        };
+        std::vector<Entry> stack = {{0, 1}};
+        uint64_t visited = 0;
+        while (!stack.empty())
+        {
+            Entry entry = stack.back();
+            stack.pop_back();
+            if (++visited > nodes.size() || entry.depth > LinearBvh::kStackSize)
+                return false;
+
+            const LinearBvhNode &node = nodes[entry.node];
+            if (node.is_leaf())
+            {
+                if (uint64_t(node.offset) + node.count > header.count[kTriangles])
+                    return false;
+                continue;
+            }
+            if (node.offset <= entry.node + 1 || node.offset >= nodes.size())
+                return false;
+            stack.push_back({entry.node + 1, entry.depth + 1});
+            stack.push_back({node.offset, entry.depth + 1});
+        }
+        return ValidWideBvh(file, header);
+    }
+
+    // Whether every dependency recorded in the cache still has the stamp it had when written.
+    bool DependenciesUnchanged(const util::MappedFile &file, const CacheHeader &header)
+    {
+        util::Span<char> paths = SectionSpan<char>(file, header, kDependencyPaths);
+        for (const DependencyRecord &record : SectionSpan<DependencyRecord>(file, header, kDependencies))
+        {
+            if (record.path_offset > paths.size() || record.path_length > paths.size() - record.path_offset)
+                return false;
+
+            util::FileStamp stamp;
+            bool exists = util::GetFileStamp(std::string(paths.data() + record.path_offset, record.path_length), stamp);
+            if (exists != (record.size != DependencyRecord::kMissing) ||
+                (exists && (stamp.size != record.size || stamp.mtime_ns != record.mtime_ns)))
+                return false;
+        }
+        return true;
+    }
+}
+
+bool Mesh::LoadCache(const std::string &cache_path, const util::FileStamp &source, const BvhBuildOptions &build)
+{
+    auto file = util::MappedFile::Open(cache_path);
+    if (!file || file->size() < sizeof(CacheHeader))
+        return false;
+
+    CacheHeader header;
+    memcpy(&header, file->data(), sizeof(header));
+    if (memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic)) != 0 || header.version != kCacheVersion ||
+        header.point_size != sizeof(Point3) || header.bvh_builder != uint32_t(build.builder))
+        return false;
+
+    // Finalize only builds a wide BVH over a non-empty binary one.
+    if (header.wide_bvh != uint32_t(build.wide && header.count[kBvhNodes] != 0))
+        return false;
+
+    if (header.source_size != source.size || header.source_mtime_ns != source.mtime_ns)
+        return false;
+
+    for (int s = 0; s < kSectionCount; s++)
+    {
+        if (header.offset[s] % kSectionAlignment != 0 || header.offset[s] > file->size() ||
+            header.count[s] > (file->size() - header.offset[s]) / kElementSize[s])
+            return false;
+    }
+
+#ifdef PTMATH_FLOAT
+    uint64_t vertex_floats = simd::TriangleSoA::FloatCount(header.count[kTriangles]);
+#else
+    uint64_t vertex_floats = 0;
+#endif
+    if (header.count[kVertexArrays] != vertex_floats)
+        return false;
+
+    if (!DependenciesUnchanged(*file, header))
+        return false;
+
+    if (!ValidPayload(*file, header))
+    {
+        std::clog << "Ignoring corrupt mesh cache " << cache_path << "\n";
+        return false;
+    }
+
+    owned_ = Data();
+    mapping_ = file;
+    vertices_ = SectionSpan<Point3>(*file, header, kVertices);
+    normals_ = SectionSpan<Vec3>(*file, header, kNormals);
+    uvs_ = SectionSpan<Uv>(*file, header, kUvs);
+    triangles_ = SectionSpan<Triangle>(*file, header, kTriangles);
+    material_descs_ = SectionSpan<MaterialDesc>(*file, header, kMaterials);
+    bvh_.Adopt(SectionSpan<LinearBvhNode>(*file, header, kBvhNodes));
+    bvh_builder_ = build.builder;
+    wide_bvh_.Adopt(SectionSpan<WideBvhNode>(*file, header, kWideNodes),
+                    SectionSpan<WideBvhLeaf>(*file, header, kWideLeaves));
+#ifdef PTMATH_FLOAT
+    vertex_arrays_.Adopt(SectionSpan<float>(*file, header, kVertexArrays).data(), triangles_.size());
+#endif
+    bbox_ = bvh_.bounds();
+    CreateMaterials();
+    return true;
+}
+
+void Mesh::WriteCache(const std::string &cache_path, const util::FileStamp &source,
+                      const std::vector<Dependency> &dependencies) const
+{
+    std::vector<DependencyRecord> records;
+    std::string paths;
+    for (const Dependency &dependency : dependencies)
+    {
+        records.push_back({dependency.exists ? dependency.stamp.size : DependencyRecord::kMissing,
+                           dependency.exists ? dependency.stamp.mtime_ns : 0, paths.size(), dependency.path.size()});
+        paths += dependency.path;
+    }
+
+    const void *data[kSectionCount] = {vertices_.data(), normals_.data(), uvs_.data(), triangles_.data(),
+                                       material_descs_.data(), bvh_.nodes().data(), wide_bvh_.nodes().data(),
+                                       wide_bvh_.leaves().data(), vertex_arrays_.data(), records.data(),
+                                       paths.data()};
+
+    CacheHeader header = {};
+    memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+    header.version = kCacheVersion;
+    header.point_size = sizeof(Point3);
+    header.bvh_builder = uint32_t(bvh_builder_);
+    header.wide_bvh = !wide_bvh_.empty();
+    header.source_size = source.size;
+    header.source_mtime_ns = source.mtime_ns;
+    header.count[kVertices] = vertices_.size();
+    header.count[kNormals] = normals_.size();
+    header.count[kUvs] = uvs_.size();
+    header.count[kTriangles] = triangles_.size();
+    header.count[kMaterials] = material_descs_.size();
+    header.count[kBvhNodes] = bvh_.nodes().size();
+    header.count[kWideNodes] = wide_bvh_.node_count();
+    header.count[kWideLeaves] = wide_bvh_.leaf_count();
+#ifdef PTMATH_FLOAT
+    header.count[kVertexArrays] = simd::TriangleSoA::FloatCount(vertex_arrays_.size());
+#endif
+    header.count[kDependencies] = records.size();
+    header.count[kDependencyPaths] = paths.size();
+
+    uint64_t offset = AlignUp(sizeof(CacheHeader));
+    for (int s = 0; s < kSectionCount; s++)
+    {
+        header.offset[s] = offset;
+        offset = AlignUp(offset + header.count[s] * kElementSize[s]);
+    }
+
+    // Write to a temporary file and rename it into place, so that a concurrent reader never
+    // maps a half-written cache.
+    std::string tmp_path = cache_path + ".tmp";
+    FILE *file = fopen(tmp_path.c_str(), "wb");
+    if (!file)
+    {
+        std::clog << "Could not write mesh cache " << cache_path << "\n";
+        return;
+    }
+
+    static const char kZeros[kSectionAlignment] = {};
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    uint64_t written = sizeof(header);
+    for (int s = 0; s < kSectionCount && ok; s++)
+    {
+        ok &= fwrite(kZeros, 1, header.offset[s] - written, file) == header.offset[s] - written;
+        size_t bytes = header.count[s] * kElementSize[s];
+        ok &= bytes == 0 || fwrite(data[s], 1, bytes, file) == bytes;
+        written = header.offset[s] + bytes;
+    }
+    ok &= fclose(file) == 0;
+
+    if (!ok || rename(tmp_path.c_str(), cache_path.c_str()) != 0)
+    {
+        std::clog << "Could not write mesh cache " << cache_path << "\n";
+        remove(tmp_path.c_str());
+    }
+}
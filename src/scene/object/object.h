@@ -11,19 +11,41 @@ using namespace ptmath;
 
 #include "./ptmath/ray.h"
 #include "./ptmath/interval.h"
+#include "./ptmath/aabb.h"
+#include "./util/hash.h"
+
+#include <cstdint>
+#include <typeinfo>
 
 namespace scene
 {
 
-    class Material;
+    class MaterialTable;
+
+    // Index of a material in the MaterialTable of the scene being rendered. Hit records carry one
+    // instead of a shared_ptr, so that recording a hit copies four bytes instead of touching a
+    // reference count that every render thread shares.
+    using MaterialId = uint32_t;
+    const MaterialId kNoMaterial = UINT32_MAX;
+
+    // How a compiled scene reaches its primitives and materials: with a switch over the built-in
+    // types, which inlines into the traversal and path loops, or through the virtual Hittable and
+    // Material interfaces. Both give the same image.
+    enum class Dispatch
+    {
+        kClosedSet,
+        kVirtual
+    };
 
+    // Plain data, so that keeping the closest hit is a copy of a few words.
     class HitRecord
     {
     public:
         Point3 p;
         Vec3 normal;
-        double t;
-        shared_ptr<Material> mat;
+        Real t;
+        Real u, v; // Surface coordinates of the hit point
+        MaterialId mat;
         bool front_face;
 
         void set_face_normal(const ray &r, const Vec3 &outward_normal)
@@ -33,12 +55,78 @@ namespace scene
         }
     };
 
+    /**
+     * Up to kMaxSize coherent rays traced together, e.g. the primary rays of a pixel tile.
+     * Each ray keeps its own closest hit so far: hit_packet only reports hits of ray i with
+     * t in ray_t(i), and Record(i) shrinks that interval.
+    */
+    class RayPacket
+    {
+    public:
+        static const int kMaxSize = 64;
+
+        int size = 0;
+        double t_min = 0.001;
+        ray rays[kMaxSize];
+        double t_max[kMaxSize];
+        bool hit[kMaxSize];
+        HitRecord rec[kMaxSize];
+
+        void add(const ray &r)
+        {
+            rays[size] = r;
+            t_max[size] = INFINITY;
+            hit[size] = false;
+            size++;
+        }
+
+        interval ray_t(int i) const { return interval(t_min, t_max[i]); }
+
+        // Marks rec[i] as the closest hit of ray i so far.
+        void Record(int i)
+        {
+            hit[i] = true;
+            t_max[i] = rec[i].t;
+        }
+    };
+
     class Hittable
     {
     public:
         virtual ~Hittable() = default;
 
         virtual bool hit(const ray &r, interval ray_t, HitRecord &rec) const = 0;
+
+        // Intersects every ray of the packet. Acceleration structures override this to share
+        // work between the rays; the default traces them one at a time.
+        virtual void hit_packet(RayPacket &packet) const
+        {
+            for (int i = 0; i < packet.size; i++)
+            {
+                if (hit(packet.rays[i], packet.ray_t(i), packet.rec[i]))
+                    packet.Record(i);
+            }
+        }
+
+        virtual aabb bounding_box() const = 0;
+
+        // Adds the materials of the object to materials and keeps their ids for its hit records.
+        // A scene calls it while it is compiled, so the ids are those of the scene compiled last.
+        virtual void InternMaterials(MaterialTable &materials) { (void)materials; }
+
+        // Adds what the object holds to hash, so that a checkpoint is only resumed with the scene
+        // it was rendered from. The default only knows the type and the bounds; objects with
+        // more to tell override it.
+        virtual void HashContent(util::Hash &hash) const
+        {
+            hash.Add(typeid(*this).name());
+            aabb box = bounding_box();
+            for (const interval &axis : {box.x, box.y, box.z})
+            {
+                hash.Add(axis.min);
+                hash.Add(axis.max);
+            }
+        }
     };
 
     class HittableGroup : public Hittable
@@ -49,11 +137,16 @@ namespace scene
         HittableGroup() {}
         HittableGroup(shared_ptr<Hittable> object) { add(object); }
 
-        void clear() { objects.clear(); }
+        void clear()
+        {
+            objects.clear();
+            bbox = aabb();
+        }
 
         void add(shared_ptr<Hittable> object)
         {
             objects.push_back(object);
+            bbox = aabb(bbox, object->bounding_box());
         }
 
         bool hit(const ray &r, interval ray_t, HitRecord &rec) const override
@@ -73,6 +166,29 @@ namespace scene
             }
             return hit_anything;
         }
+
+        void hit_packet(RayPacket &packet) const override
+        {
+            for (const auto &object : objects)
+                object->hit_packet(packet);
+        }
+
+        aabb bounding_box() const override { return bbox; }
+
+        void InternMaterials(MaterialTable &materials) override
+        {
+            for (const auto &object : objects)
+                object->InternMaterials(materials);
+        }
+
+        void HashContent(util::Hash &hash) const override
+        {
+            for (const auto &object : objects)
+                object->HashContent(hash);
+        }
+
+    private:
+        aabb bbox;
     };
 
 }
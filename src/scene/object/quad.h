@@ -2,6 +2,7 @@
 #define QUAD_H
 
 #include "object.h"
+#include "./scene/material_table.h"
 
 using namespace ptmath;
 
@@ -12,15 +13,80 @@ namespace scene
     {
     public:
         quad(const Point3 &_Q, const Vec3 &_u, const Vec3 &_v, shared_ptr<Material> m)
-            : Q(_Q), u(_u), v(_v), mat(m)
+            : Q(_Q), u(_u), v(_v), material(m)
         {
             auto n = cross(u, v);
             normal = unit_vector(n);
             D = dot(normal, Q);
             w = n / dot(n, n);
+
+            set_bounding_box();
+        }
+
+        virtual void set_bounding_box()
+        {
+            // Compute the bounding box of all four vertices.
+            auto bbox_diagonal1 = aabb(Q, Q + u + v);
+            auto bbox_diagonal2 = aabb(Q + u, Q + v);
+            bbox = aabb(bbox_diagonal1, bbox_diagonal2).pad();
+        }
+
+        aabb bounding_box() const override { return bbox; }
+
+        Point3 get_q() const { return Q; }
+        Vec3 get_u() const { return u; }
+        Vec3 get_v() const { return v; }
+        MaterialId get_material() const { return mat; }
+
+        void InternMaterials(MaterialTable &materials) override { mat = materials.Intern(material); }
+
+        // Subclasses only change is_interior, so their type and the plane say it all.
+        void HashContent(util::Hash &hash) const override
+        {
+            hash.Add(typeid(*this).name());
+            hash.Add(Q);
+            hash.Add(u);
+            hash.Add(v);
+            hash.Add(mat);
         }
 
         bool hit(const ray &r, interval ray_t, HitRecord &rec) const override
+        {
+            return HitPlane<true>(r, ray_t, rec);
+        }
+
+        // hit for callers that know the object is exactly a quad: is_interior is called without
+        // virtual dispatch, so the whole test can inline.
+        bool hit_exact(const ray &r, interval ray_t, HitRecord &rec) const
+        {
+            return HitPlane<false>(r, ray_t, rec);
+        }
+
+        virtual bool is_interior(double a, double b, HitRecord &rec) const
+        {
+            // Given the hit point in plane coordinates, return false if it is outside the
+            // primitive, otherwise set the hit record UV coordinates and return true.
+
+            if ((a < 0) || (1 < a) || (b < 0) || (1 < b))
+                return false;
+
+            //rec.u = a;
+            //rec.v = b;
+            return true;
+        }
+
+    private:
+        Point3 Q;
+        Vec3 u, v;
+        shared_ptr<Material> material;
+        MaterialId mat = kNoMaterial;
+        Vec3 normal;
+        double D;
+        Vec3 w;
+        aabb bbox;
+
+        template <bool kVirtualInterior>
+        bool HitPlane(const ray &r, interval ray_t, HitRecord &rec) const
         {
             auto denom = dot(normal, r.direction());
 
@@ -39,7 +105,8 @@ namespace scene
             auto alpha = dot(w, cross(planar_hitpt_vector, v));
             auto beta = dot(w, cross(u, planar_hitpt_vector));
 
-            if (!is_interior(alpha, beta, rec))
+            bool interior = kVirtualInterior ? is_interior(alpha, beta, rec) : quad::is_interior(alpha, beta, rec);
+            if (!interior)
                 return false;
 
             // Ray hits the 2D shape; set the rest of the hit record and return true.
@@ -50,27 +117,6 @@ namespace scene
 
             return true;
         }
-
-        virtual bool is_interior(double a, double b, HitRecord &rec) const
-        {
-            // Given the hit point in plane coordinates, return false if it is outside the
-            // primitive, otherwise set the hit record UV coordinates and return true.
-
-            if ((a < 0) || (1 < a) || (b < 0) || (1 < b))
-                return false;
-
-            //rec.u = a;
-            //rec.v = b;
-            return true;
-        }
-
-    private:
-        Point3 Q;
-        Vec3 u, v;
-        shared_ptr<Material> mat;
-        Vec3 normal;
-        double D;
-        Vec3 w;
     };
 
 }
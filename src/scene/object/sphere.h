@@ -5,6 +5,7 @@
 #include "./ptmath/interval.h"
 
 #include "object.h"
+#include "./scene/material_table.h"
 
 namespace scene
 {
@@ -15,7 +16,11 @@ namespace scene
     {
     public:
         sphere(Point3 _center, double _radius, shared_ptr<Material> _material)
-            : center(_center), radius(_radius), mat(_material) {}
+            : center(_center), radius(_radius), material(_material)
+        {
+            auto rvec = Vec3(radius, radius, radius);
+            bbox = aabb(center - rvec, center + rvec);
+        }
 
         bool hit(const ray &r, interval ray_t, HitRecord &rec) const override
         {
@@ -47,10 +52,28 @@ namespace scene
             return true;
         }
 
+        aabb bounding_box() const override { return bbox; }
+
+        Point3 get_center() const { return center; }
+        double get_radius() const { return radius; }
+        MaterialId get_material() const { return mat; }
+
+        void InternMaterials(MaterialTable &materials) override { mat = materials.Intern(material); }
+
+        void HashContent(util::Hash &hash) const override
+        {
+            hash.Add(typeid(*this).name());
+            hash.Add(center);
+            hash.Add(radius);
+            hash.Add(mat);
+        }
+
     private:
         Point3 center;
         double radius;
-        shared_ptr<Material> mat;
+        shared_ptr<Material> material;
+        MaterialId mat = kNoMaterial;
+        aabb bbox;
     };
 
 }
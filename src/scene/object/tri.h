@@ -6,6 +6,7 @@
 #include "./ptmath/interval.h"
 
 #include "object.h"
+#include "./scene/material_table.h"
 
 namespace scene
 {
@@ -16,27 +17,46 @@ namespace scene
     {
     public:
         Tri(Tri3 tri, shared_ptr<Material> _material)
-            : tri_(tri), mat(_material) {}
+            : tri_(tri), material_(_material)
+        {
+            bbox_ = aabb(aabb(tri_.p1(), tri_.p2()), aabb(tri_.p3(), tri_.p3())).pad();
+        }
 
         bool hit(const ray &r, interval ray_t, HitRecord &rec) const override
         {
-            int t;
-            if (!tri_.intersect(r, t) || !ray_t.contains(t)) {
+            Real t, b1, b2;
+            if (!tri_.intersect(r, t, b1, b2) || !ray_t.surrounds(t)) {
                 return false;
             }
 
             rec.t = t;
             rec.p = r.at(rec.t);
-            rec.normal = tri_.normal();
+            rec.u = b1;
+            rec.v = b2;
             rec.mat = mat;
-            rec.set_face_normal(r, rec.normal);
+            rec.set_face_normal(r, unit_vector(tri_.normal()));
 
             return true;
         }
 
+        aabb bounding_box() const override { return bbox_; }
+
+        void InternMaterials(MaterialTable &materials) override { mat = materials.Intern(material_); }
+
+        void HashContent(util::Hash &hash) const override
+        {
+            hash.Add(typeid(*this).name());
+            hash.Add(tri_.p1());
+            hash.Add(tri_.p2());
+            hash.Add(tri_.p3());
+            hash.Add(mat);
+        }
+
     private:
         Tri3 tri_;
-        shared_ptr<Material> mat;
+        shared_ptr<Material> material_;
+        MaterialId mat = kNoMaterial;
+        aabb bbox_;
     };
 
 }
@@ -0,0 +1,194 @@
+#include "wide_bvh.h"
+#include "linear_bvh.h"
+
+#include <algorithm>
+
+using namespace scene;
+using namespace ptmath;
+
+static_assert(WideBvh::kStackSize >= (simd::kWideBvhWidth - 1) * LinearBvh::kStackSize + 1,
+              "WideBvh::kStackSize is too small for the trees LinearBvh builds");
+
+namespace
+{
+    struct Box
+    {
+        float lo[3], hi[3];
+
+        float SurfaceArea() const
+        {
+            float dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+            return 2 * (dx * dy + dy * dz + dz * dx);
+        }
+    };
+
+    Box BoxOf(const LinearBvhNode &node)
+    {
+        Box box;
+        for (int a = 0; a < 3; a++)
+        {
+            box.lo[a] = node.bounds_min[a];
+            box.hi[a] = node.bounds_max[a];
+        }
+        return box;
+    }
+
+    // Grid plane q of an axis, computed as the traversal does.
+    double Plane(float origin, int exponent, int q)
+    {
+        return origin + std::ldexp(double(q), exponent);
+    }
+
+    /**
+     * Quantizes the children's extents along axis a to 8-bit planes, each rounded outwards, on
+     * the finest power-of-two grid from origin that spans all of them.
+    */
+    void QuantizeAxis(const Box *children, int count, int a, simd::QuantizedBoxes &boxes)
+    {
+        float lo = children[0].lo[a], hi = children[0].hi[a];
+        for (int i = 1; i < count; i++)
+        {
+            lo = std::min(lo, children[i].lo[a]);
+            hi = std::max(hi, children[i].hi[a]);
+        }
+
+        int exponent = -128;
+        if (hi > lo)
+        {
+            std::frexp((double(hi) - lo) / 255, &exponent);
+            exponent = std::max(exponent - 1, -128);
+        }
+
+        // Rounding can leave the top plane just short of hi; coarsen the grid until it reaches.
+        while (Plane(lo, exponent, 255) < hi)
+            exponent++;
+
+        boxes.origin[a] = lo;
+        boxes.exponent[a] = static_cast<int8_t>(exponent);
+        for (int i = 0; i < count; i++)
+        {
+            double scale = std::ldexp(1.0, exponent);
+            int q_lo = std::clamp(int(std::floor((children[i].lo[a] - double(lo)) / scale)), 0, 255);
+            int q_hi = std::clamp(int(std::ceil((children[i].hi[a] - double(lo)) / scale)), 0, 255);
+            while (q_lo > 0 && Plane(lo, exponent, q_lo) > children[i].lo[a])
+                q_lo--;
+            while (q_hi < 255 && Plane(lo, exponent, q_hi) < children[i].hi[a])
+                q_hi++;
+            boxes.lo[a][i] = static_cast<uint8_t>(q_lo);
+            boxes.hi[a][i] = static_cast<uint8_t>(q_hi);
+        }
+    }
+}
+
+void WideBvh::Build(const LinearBvh &bvh)
+{
+    Clear();
+    if (bvh.nodes().empty())
+        return;
+
+    owned_nodes_.reserve(bvh.nodes().size() / 2 + 1);
+    owned_leaves_.reserve(bvh.nodes().size() / 2 + 1);
+    owned_nodes_.emplace_back();
+    Collapse(bvh, 0, 0);
+    owned_nodes_.shrink_to_fit();
+    owned_leaves_.shrink_to_fit();
+    nodes_ = owned_nodes_;
+    leaves_ = owned_leaves_;
+}
+
+void WideBvh::Clear()
+{
+    owned_nodes_.clear();
+    owned_leaves_.clear();
+    nodes_ = util::Span<WideBvhNode>();
+    leaves_ = util::Span<WideBvhLeaf>();
+}
+
+void WideBvh::Adopt(util::Span<WideBvhNode> nodes, util::Span<WideBvhLeaf> leaves)
+{
+    Clear();
+    nodes_ = nodes;
+    leaves_ = leaves;
+}
+
+size_t WideBvh::memory_usage() const
+{
+    return nodes_.size() * sizeof(WideBvhNode) + leaves_.size() * sizeof(WideBvhLeaf);
+}
+
+void WideBvh::Collapse(const LinearBvh &bvh, uint32_t binary_index, uint32_t index)
+{
+    util::Span<LinearBvhNode> binary = bvh.nodes();
+
+    // Open the largest interior child until there are eight, keeping the children in the
+    // binary tree's order. A leaf root becomes the only child of the root.
+    uint32_t children[simd::kWideBvhWidth];
+    int count = 0;
+    const LinearBvhNode &root = binary[binary_index];
+    if (root.is_leaf())
+    {
+        children[count++] = binary_index;
+    }
+    else
+    {
+        children[count++] = binary_index + 1;
+        children[count++] = root.offset;
+    }
+
+    while (count < simd::kWideBvhWidth)
+    {
+        int largest = -1;
+        float largest_area = -1;
+        for (int i = 0; i < count; i++)
+        {
+            const LinearBvhNode &child = binary[children[i]];
+            float area = BoxOf(child).SurfaceArea();
+            if (!child.is_leaf() && area > largest_area)
+            {
+                largest = i;
+                largest_area = area;
+            }
+        }
+        if (largest < 0)
+            break;
+
+        uint32_t opened = children[largest];
+        std::copy_backward(children + largest + 1, children + count, children + count + 1);
+        children[largest] = opened + 1;
+        children[largest + 1] = binary[opened].offset;
+        count++;
+    }
+
+    Box boxes[simd::kWideBvhWidth];
+    WideBvhNode node = {};
+    node.boxes.child_count = static_cast<uint8_t>(count);
+    node.child_base = static_cast<uint32_t>(owned_nodes_.size());
+    node.leaf_base = static_cast<uint32_t>(owned_leaves_.size());
+
+    uint8_t interior = 0, leaves = 0;
+    for (int i = 0; i < count; i++)
+    {
+        const LinearBvhNode &child = binary[children[i]];
+        boxes[i] = BoxOf(child);
+        if (child.is_leaf())
+        {
+            node.child_meta[i] = WideBvhNode::kLeafBit | leaves++;
+            owned_leaves_.push_back({child.offset, child.count});
+        }
+        else
+        {
+            node.child_meta[i] = interior++;
+        }
+    }
+    for (int a = 0; a < 3; a++)
+        QuantizeAxis(boxes, count, a, node.boxes);
+
+    owned_nodes_.resize(owned_nodes_.size() + interior);
+    owned_nodes_[index] = node;
+
+    for (int i = 0; i < count; i++)
+    {
+        if (!(node.child_meta[i] & WideBvhNode::kLeafBit))
+            Collapse(bvh, children[i], node.child_base + node.child_meta[i]);
+    }
+}
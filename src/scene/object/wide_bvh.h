@@ -0,0 +1,192 @@
+#ifndef WIDE_BVH_H
+#define WIDE_BVH_H
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "./ptmath/simd.h"
+#include "./util/span.h"
+
+#include "object.h"
+
+namespace scene
+{
+
+    class LinearBvh;
+
+    /**
+     * One node of a WideBvh: the quantized boxes of up to kWideBvhWidth children, followed by
+     * where to find them. A node's interior children are stored next to each other in the node
+     * array and its leaf children next to each other in the leaf array, so two base indices and
+     * a byte per child locate them all.
+    */
+    struct WideBvhNode
+    {
+        static const uint8_t kLeafBit = 0x80;
+
+        simd::QuantizedBoxes boxes;
+        uint32_t child_base; // Node index of the first interior child
+        uint32_t leaf_base;  // Leaf index of the first leaf child
+        uint8_t child_meta[simd::kWideBvhWidth]; // kLeafBit for leaves, plus the rank among children of that kind
+    };
+
+    static_assert(sizeof(WideBvhNode) == 80, "WideBvhNode should hold eight children in 80 bytes");
+
+    // A range of primitive positions, as in a LinearBvh leaf.
+    struct WideBvhLeaf
+    {
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    /**
+     * A LinearBvh collapsed into nodes of up to eight children, whose boxes are tested against a
+     * ray together with the ptmath::simd kernels. Each node keeps the largest of its children
+     * open until it has eight, and stores their boxes with 8 bits per plane relative to its own
+     * bounds, so a node takes 80 bytes where the binary nodes it replaces took 32 each.
+     *
+     * Leaves are the binary tree's leaves, so primitives stay in its leaf order.
+    */
+    class WideBvh
+    {
+    public:
+        // Every level leaves at most all but one of a node's children on the stack, and there
+        // are no more levels than a LinearBvh traversal stack holds (checked in wide_bvh.cpp).
+        static const int kStackSize = (simd::kWideBvhWidth - 1) * 64 + 1;
+
+        WideBvh() {}
+
+        // nodes() and leaves() may point into owned storage, so copies would dangle.
+        WideBvh(const WideBvh &) = delete;
+        WideBvh &operator=(const WideBvh &) = delete;
+
+        void Build(const LinearBvh &bvh);
+        void Clear();
+
+        // Uses nodes and leaves owned by someone else, e.g. a mapped cache file, instead of
+        // collapsing them from a LinearBvh.
+        void Adopt(util::Span<WideBvhNode> nodes, util::Span<WideBvhLeaf> leaves);
+
+        util::Span<WideBvhNode> nodes() const { return nodes_; }
+        util::Span<WideBvhLeaf> leaves() const { return leaves_; }
+
+        bool empty() const { return nodes_.empty(); }
+        size_t node_count() const { return nodes_.size(); }
+        size_t leaf_count() const { return leaves_.size(); }
+
+        // Bytes of the nodes and leaves.
+        size_t memory_usage() const;
+
+        /**
+         * Visits leaves roughly front to back along the ray, calling
+         * hit_leaf(first, count, r, ray_t, rec) as LinearBvh::TraverseLeaves does. Counts the
+         * nodes it reads in node_fetches, when given.
+        */
+        template <typename LeafHit>
+        bool TraverseLeaves(const ray &r, interval ray_t, HitRecord &rec, LeafHit &&hit_leaf,
+                            size_t *node_fetches = nullptr) const
+        {
+            if (nodes_.empty())
+                return false;
+
+            // Axis-parallel rays get a large finite inverse, so that the slab offsets stay finite.
+            Vec3 dir = r.direction();
+            Point3 orig = r.origin();
+            double inv_dir[3];
+            for (int a = 0; a < 3; a++)
+            {
+                inv_dir[a] = 1 / dir[a];
+                if (!(std::fabs(inv_dir[a]) < kMaxInverse))
+                    inv_dir[a] = std::copysign(kMaxInverse, inv_dir[a]);
+            }
+
+            struct Entry
+            {
+                uint32_t node;
+                float t;
+            };
+            Entry stack[kStackSize];
+            int stack_size = 0;
+            uint32_t current = 0;
+            bool hit_anything = false;
+
+            while (true)
+            {
+                const WideBvhNode &node = nodes_[current];
+                if (node_fetches)
+                    ++*node_fetches;
+
+                // Offsets are taken in double, so the ray origin is not rounded to float.
+                simd::WideRay wide_ray;
+                for (int a = 0; a < 3; a++)
+                {
+                    double scale = std::ldexp(1.0, node.boxes.exponent[a]);
+                    wide_ray.step[a] = static_cast<float>(scale * inv_dir[a]);
+                    wide_ray.offset[a] = static_cast<float>((node.boxes.origin[a] - orig[a]) * inv_dir[a]);
+                    wide_ray.negative[a] = inv_dir[a] < 0;
+                }
+
+                float t_near[simd::kWideBvhWidth];
+                int mask = simd::IntersectWide(node.boxes, wide_ray, static_cast<float>(ray_t.min),
+                                               static_cast<float>(ray_t.max), t_near);
+
+                // Order the children hit by entry distance.
+                int order[simd::kWideBvhWidth];
+                int hits = 0;
+                for (; mask != 0; mask &= mask - 1)
+                {
+                    int child = __builtin_ctz(mask);
+                    int k = hits++;
+                    for (; k > 0 && t_near[order[k - 1]] > t_near[child]; k--)
+                        order[k] = order[k - 1];
+                    order[k] = child;
+                }
+
+                // Leaves are tested right away, nearest first; interior children are pushed
+                // farthest first, so the nearest is visited next.
+                for (int k = 0; k < hits; k++)
+                {
+                    uint8_t meta = node.child_meta[order[k]];
+                    if (!(meta & WideBvhNode::kLeafBit))
+                        continue;
+                    const WideBvhLeaf &leaf = leaves_[node.leaf_base + (meta & ~WideBvhNode::kLeafBit)];
+                    if (t_near[order[k]] <= ray_t.max * simd::kWideBoxPad && hit_leaf(leaf.offset, leaf.count, r, ray_t, rec))
+                    {
+                        hit_anything = true;
+                        ray_t.max = rec.t;
+                    }
+                }
+                for (int k = hits - 1; k >= 0; k--)
+                {
+                    uint8_t meta = node.child_meta[order[k]];
+                    if (!(meta & WideBvhNode::kLeafBit))
+                        stack[stack_size++] = {node.child_base + meta, t_near[order[k]]};
+                }
+
+                // Skip children that a closer hit has since put out of reach.
+                do
+                {
+                    if (stack_size == 0)
+                        return hit_anything;
+                    --stack_size;
+                } while (stack[stack_size].t > ray_t.max * simd::kWideBoxPad);
+                current = stack[stack_size].node;
+            }
+        }
+
+    private:
+        static constexpr double kMaxInverse = 1e30;
+
+        std::vector<WideBvhNode> owned_nodes_;
+        std::vector<WideBvhLeaf> owned_leaves_;
+        util::Span<WideBvhNode> nodes_;
+        util::Span<WideBvhLeaf> leaves_;
+
+        // Fills in node index from the binary subtree rooted at binary_index.
+        void Collapse(const LinearBvh &bvh, uint32_t binary_index, uint32_t index);
+    };
+
+}
+
+#endif
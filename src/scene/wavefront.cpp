@@ -0,0 +1,368 @@
+#include "wavefront.h"
+
+#include "./util/util.h"
+#include "./util/parallel.h"
+#include "material.h"
+#include "material_table.h"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace scene;
+using namespace ptmath;
+
+namespace
+{
+    const char *kStageNames[4] = {"generate", "extend", "shade", "shadow"};
+
+    template <typename F>
+    double Seconds(F &&fn)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+void WavefrontCamera::Paths::Resize(size_t size)
+{
+    samplers.resize(size);
+    rays.resize(size);
+    throughput.resize(size);
+    radiance.resize(size);
+    hits.resize(size);
+    hit.resize(size);
+    kind.resize(size);
+    bsdf_pdf.resize(size);
+    alive.resize(size);
+    has_shadow_ray.resize(size);
+    shadow_rays.resize(size);
+    shadow_t_max.resize(size);
+    shadow_contribution.resize(size);
+}
+
+void WavefrontCamera::Render(const CompiledScene &world, const int num_threads)
+{
+    if (num_threads <= 0 || samples_per_pixel_ <= 0)
+    {
+        return;
+    }
+
+    util::TaskPool pool(num_threads);
+    image output(image_width_, image_height_, pixel_format_);
+    Render(world, pool, output);
+
+    std::clog << "\n";
+    for (int s = 0; s < 4; s++)
+        std::clog << kStageNames[s] << ": " << stage_seconds_[s] << " s\n";
+    pool.PrintStats(std::clog);
+
+    WriteOutput(output);
+}
+
+void WavefrontCamera::Render(const CompiledScene &world, util::TaskPool &pool, image &output)
+{
+    this->Initialize(world);
+    pool_ = &pool;
+    std::fill(std::begin(stage_seconds_), std::end(stage_seconds_), 0.0);
+
+    int total_pixels = image_width_ * image_height_;
+    int pixels_per_wave = std::max(1, max_wave_size_ / std::max(samples_per_pixel_, 1));
+    Paths paths;
+    paths.Resize(size_t(std::min(pixels_per_wave, total_pixels)) * samples_per_pixel_);
+
+    std::vector<uint32_t> queue, next;
+    for (int first = 0; first < total_pixels; first += pixels_per_wave)
+    {
+        int pixel_count = std::min(pixels_per_wave, total_pixels - first);
+        stage_seconds_[0] += Seconds([&]()
+                                     { Generate(paths, first, pixel_count, queue); });
+
+        for (int depth = 0; depth < max_depth_ && !queue.empty(); depth++)
+        {
+            stage_seconds_[1] += Seconds([&]()
+                                         { Extend(world, paths, queue, depth == 0); });
+            stage_seconds_[2] += Seconds([&]()
+                                         { Shade(world, paths, queue, depth); });
+            stage_seconds_[3] += Seconds([&]()
+                                         { Shadow(world, paths, queue); });
+
+            next.clear();
+            for (uint32_t slot : queue)
+                if (paths.alive[slot])
+                    next.push_back(slot);
+            queue.swap(next);
+        }
+
+        // Average the samples of each pixel; a pixel's samples occupy consecutive slots.
+        stage_seconds_[0] += Seconds([&]()
+                                     { util::ParallelFor(*pool_, pixel_count, [&](size_t begin, size_t end)
+                                                         {
+            for (size_t p = begin; p < end; p++)
+            {
+                color sum;
+                for (int s = 0; s < samples_per_pixel_; s++)
+                    sum += paths.radiance[p * samples_per_pixel_ + s];
+                output.setPixel(size_t(first + p), sum / samples_per_pixel_);
+            } }); });
+
+        util::PrintProgress(double(first + pixel_count) / total_pixels);
+    }
+
+    pool_ = nullptr;
+}
+
+void WavefrontCamera::Generate(Paths &paths, int first_pixel, int pixel_count, std::vector<uint32_t> &queue)
+{
+    size_t path_count = size_t(pixel_count) * samples_per_pixel_;
+    queue.resize(path_count);
+
+    util::ParallelFor(*pool_, path_count, [&](size_t begin, size_t end)
+                      {
+        for (size_t slot = begin; slot < end; slot++)
+        {
+            int pixel = first_pixel + int(slot / samples_per_pixel_);
+            int sample = int(slot % samples_per_pixel_);
+            int x = pixel % image_width_, y = pixel / image_width_;
+            paths.samplers[slot] = SamplePixel(x, y, sample);
+            paths.rays[slot] = GetRayForPixel(x, y, paths.samplers[slot]);
+            paths.throughput[slot] = color(1, 1, 1);
+            paths.radiance[slot] = color(0, 0, 0);
+            paths.bsdf_pdf[slot] = 0;
+            queue[slot] = uint32_t(slot);
+        } });
+}
+
+void WavefrontCamera::Extend(const CompiledScene &world, Paths &paths, const std::vector<uint32_t> &queue,
+                             bool coherent)
+{
+    if (!coherent)
+    {
+        util::ParallelFor(*pool_, queue.size(), [&](size_t begin, size_t end)
+                          {
+            for (size_t i = begin; i < end; i++)
+            {
+                uint32_t slot = queue[i];
+                paths.hit[slot] = world.hit(paths.rays[slot], interval(0.001, INFINITY), paths.hits[slot]);
+            } });
+        return;
+    }
+
+    // Camera rays of neighbouring pixels sit next to each other in the queue, so consecutive
+    // runs of them make good packets.
+    size_t packet_count = (queue.size() + RayPacket::kMaxSize - 1) / RayPacket::kMaxSize;
+    util::ParallelFor(*pool_, packet_count, [&](size_t begin, size_t end)
+                      {
+        RayPacket packet;
+        for (size_t p = begin; p < end; p++)
+        {
+            size_t first = p * RayPacket::kMaxSize;
+            size_t last = std::min(first + RayPacket::kMaxSize, queue.size());
+
+            packet.size = 0;
+            for (size_t i = first; i < last; i++)
+                packet.add(paths.rays[queue[i]]);
+
+            world.hit_packet(packet);
+
+            for (size_t i = first; i < last; i++)
+            {
+                uint32_t slot = queue[i];
+                paths.hit[slot] = packet.hit[i - first];
+                if (packet.hit[i - first])
+                    paths.hits[slot] = packet.rec[i - first];
+            }
+        } });
+}
+
+void WavefrontCamera::Shade(const CompiledScene &world, Paths &paths, const std::vector<uint32_t> &queue,
+                            int depth)
+{
+    std::vector<uint32_t> batches[kShadeKindCount];
+    Classify(world.materials(), paths, queue, batches);
+    if (world.dispatch() == Dispatch::kVirtual)
+        ShadeBatches<Material>(world.materials(), paths, batches, depth);
+    else
+        ShadeBatches<MaterialRecord>(world.materials(), paths, batches, depth);
+}
+
+void WavefrontCamera::Classify(const MaterialTable &materials, Paths &paths, const std::vector<uint32_t> &queue,
+                               std::vector<uint32_t> *batches)
+{
+    // Each slice of the queue counts its paths of every kind, then writes them after those of
+    // the slices before it, as a counting sort does.
+    size_t n = queue.size();
+    size_t slices = std::max<size_t>(1, std::min<size_t>(n, size_t(pool_->size()) * 4));
+    std::vector<size_t> offsets(slices * kShadeKindCount, 0);
+
+    pool_->Run(slices, [&](size_t s, int)
+               {
+        size_t *count = &offsets[s * kShadeKindCount];
+        for (size_t i = n * s / slices; i < n * (s + 1) / slices; i++)
+        {
+            uint32_t slot = queue[i];
+            paths.alive[slot] = false;
+            paths.has_shadow_ray[slot] = false;
+
+            ShadeKind kind = kOther;
+            if (!paths.hit[slot])
+            {
+                kind = kMiss;
+            }
+            else
+            {
+                switch (materials.Record(paths.hits[slot].mat).kind)
+                {
+                case MaterialRecord::kLambertian:
+                case MaterialRecord::kCheckered:
+                    kind = kDiffuse;
+                    break;
+                case MaterialRecord::kLight:
+                    kind = kEmitter;
+                    break;
+                default:
+                    break;
+                }
+            }
+            paths.kind[slot] = kind;
+            count[kind]++;
+        } });
+
+    for (int k = 0; k < kShadeKindCount; k++)
+    {
+        size_t sum = 0;
+        for (size_t s = 0; s < slices; s++)
+        {
+            size_t count = offsets[s * kShadeKindCount + k];
+            offsets[s * kShadeKindCount + k] = sum;
+            sum += count;
+        }
+        batches[k].resize(sum);
+    }
+
+    pool_->Run(slices, [&](size_t s, int)
+               {
+        size_t *offset = &offsets[s * kShadeKindCount];
+        for (size_t i = n * s / slices; i < n * (s + 1) / slices; i++)
+        {
+            uint32_t slot = queue[i];
+            batches[paths.kind[slot]][offset[paths.kind[slot]]++] = slot;
+        } });
+}
+
+template <typename M>
+void WavefrontCamera::ShadeBatches(const MaterialTable &materials, Paths &paths, const std::vector<uint32_t> *batches,
+                                   int depth)
+{
+    const auto &misses = batches[kMiss];
+    util::ParallelFor(*pool_, misses.size(), [&](size_t begin, size_t end)
+                      {
+        for (size_t i = begin; i < end; i++)
+        {
+            uint32_t slot = misses[i];
+            paths.radiance[slot] += paths.throughput[slot] * Background(paths.rays[slot]);
+        } });
+
+    const auto &emitters = batches[kEmitter];
+    util::ParallelFor(*pool_, emitters.size(), [&](size_t begin, size_t end)
+                      {
+        for (size_t i = begin; i < end; i++)
+            ShadeEmitter<M>(materials, paths, emitters[i]); });
+
+    // Diffuse surfaces and the rest run the same code, but batched apart each batch takes the
+    // same branches of it.
+    for (ShadeKind kind : {kDiffuse, kOther})
+    {
+        const auto &surfaces = batches[kind];
+        util::ParallelFor(*pool_, surfaces.size(), [&](size_t begin, size_t end)
+                          {
+            for (size_t i = begin; i < end; i++)
+                ShadeSurface<M>(materials, paths, surfaces[i], depth); });
+    }
+}
+
+template <typename M>
+void WavefrontCamera::ShadeEmitter(const MaterialTable &materials, Paths &paths, uint32_t slot)
+{
+    const HitRecord &rec = paths.hits[slot];
+    const ray &r = paths.rays[slot];
+
+    // Emitters take no bounce, so their sampler draws nothing, as in Camera::TracePath.
+    color emitted = MaterialAs<M>(materials, rec.mat).Emit(r, rec);
+    if (paths.bsdf_pdf[slot] > 0 && lights_.Contains(rec.mat))
+        emitted = emitted * PowerHeuristic(paths.bsdf_pdf[slot], lights_.Pdf(r.origin(), r.direction()));
+    paths.radiance[slot] += paths.throughput[slot] * emitted;
+}
+
+template <typename M>
+void WavefrontCamera::ShadeSurface(const MaterialTable &materials, Paths &paths, uint32_t slot, int depth)
+{
+    const HitRecord &rec = paths.hits[slot];
+    const ray &r = paths.rays[slot];
+    const M &mat = MaterialAs<M>(materials, rec.mat);
+
+    // One bounce of Camera::TracePath, with the occlusion test of the light sample left to the
+    // shadow stage.
+    BsdfSample bsdf;
+    if (!mat.Sample(r, rec, paths.samplers[slot], bsdf))
+    {
+        color emitted = mat.Emit(r, rec);
+        if (paths.bsdf_pdf[slot] > 0 && lights_.Contains(rec.mat))
+            emitted = emitted * PowerHeuristic(paths.bsdf_pdf[slot], lights_.Pdf(r.origin(), r.direction()));
+        paths.radiance[slot] += paths.throughput[slot] * emitted;
+        return;
+    }
+
+    if (depth + 1 >= max_depth_)
+        return;
+
+    paths.bsdf_pdf[slot] = 0;
+    if (!lights_.empty() && !bsdf.is_specular)
+    {
+        SampleLight(paths, slot, mat);
+        paths.bsdf_pdf[slot] = bsdf.pdf;
+    }
+
+    paths.throughput[slot] = paths.throughput[slot] * (bsdf.value / bsdf.pdf);
+    if (!SurvivesRoulette(paths.throughput[slot], depth, paths.samplers[slot]))
+        return;
+    paths.rays[slot] = ray(rec.p, bsdf.direction);
+    paths.alive[slot] = true;
+}
+
+template <typename M>
+void WavefrontCamera::SampleLight(Paths &paths, uint32_t slot, const M &mat)
+{
+    const HitRecord &rec = paths.hits[slot];
+    const ray &r = paths.rays[slot];
+    LightSample light;
+    if (!lights_.Sample(rec.p, paths.samplers[slot], light))
+        return;
+
+    double bsdf_pdf = mat.Pdf(r, rec, light.direction);
+    if (bsdf_pdf <= 0)
+        return;
+
+    // As in Camera::SampleDirect, grouped the same way so the sums match bit for bit.
+    double weight = PowerHeuristic(light.pdf, bsdf_pdf);
+    paths.shadow_contribution[slot] =
+        paths.throughput[slot] * (mat.Eval(r, rec, light.direction) * light.emission * (weight / light.pdf));
+    paths.shadow_rays[slot] = ray(rec.p, light.direction);
+    paths.shadow_t_max[slot] = light.distance - 0.001;
+    paths.has_shadow_ray[slot] = true;
+}
+
+void WavefrontCamera::Shadow(const CompiledScene &world, Paths &paths, const std::vector<uint32_t> &queue)
+{
+    util::ParallelFor(*pool_, queue.size(), [&](size_t begin, size_t end)
+                      {
+        HitRecord rec;
+        for (size_t i = begin; i < end; i++)
+        {
+            uint32_t slot = queue[i];
+            if (!paths.has_shadow_ray[slot])
+                continue;
+            if (!world.hit(paths.shadow_rays[slot], interval(0.001, paths.shadow_t_max[slot]), rec))
+                paths.radiance[slot] += paths.shadow_contribution[slot];
+        } });
+}
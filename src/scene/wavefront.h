@@ -0,0 +1,103 @@
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include <cstdint>
+#include <vector>
+
+#include "./ptmath/vec3.h"
+#include "./graphics/color.h"
+#include "./graphics/image.h"
+#include "./util/parallel.h"
+#include "./util/sampler.h"
+#include "object/object.h"
+#include "camera.h"
+
+namespace scene
+{
+
+    /**
+     * Breadth-first path tracer. Instead of following one path at a time down the call stack,
+     * it keeps a wave of paths in structure-of-arrays state and advances all of them one bounce
+     * per iteration, in stages that each run as a batch across threads:
+     *
+     *   generate  camera rays for every sample of a block of pixels
+     *   extend    closest hit of every active path (camera rays as packets)
+     *   shade     per material kind: misses, emitters, diffuse surfaces, everything else
+     *   shadow    occlusion tests for the light samples taken while shading
+     *
+     * Every path draws the same random numbers and does the same arithmetic as in
+     * Camera::RenderRay, so both render the same image; the wavefront benchmark checks it.
+    */
+    class WavefrontCamera : public Camera
+    {
+    public:
+        // Upper bound on the number of paths in flight, which bounds the state memory.
+        int max_wave_size_ = 1 << 18;
+
+        void Render(const CompiledScene &world, const int num_threads);
+
+        // Renders into output on the threads of pool, without writing it out.
+        void Render(const CompiledScene &world, util::TaskPool &pool, image &output);
+
+    private:
+        enum ShadeKind
+        {
+            kMiss,
+            kEmitter,
+            kDiffuse,
+            kOther,
+            kShadeKindCount
+        };
+
+        // Per-path state, indexed by the path's slot in the wave.
+        struct Paths
+        {
+            std::vector<util::PixelSampler> samplers;
+            std::vector<ray> rays;
+            std::vector<color> throughput;
+            std::vector<color> radiance;
+            std::vector<HitRecord> hits;
+            std::vector<uint8_t> hit;
+            std::vector<uint8_t> kind; // ShadeKind of the current vertex
+            std::vector<double> bsdf_pdf; // Density of the last bounce if it also sampled the lights, else 0
+            std::vector<uint8_t> alive;
+
+            // Light sample taken at the current vertex, added to radiance if unoccluded.
+            std::vector<uint8_t> has_shadow_ray;
+            std::vector<ray> shadow_rays;
+            std::vector<double> shadow_t_max;
+            std::vector<color> shadow_contribution;
+
+            void Resize(size_t size);
+        };
+
+        util::TaskPool *pool_ = nullptr;
+        double stage_seconds_[4] = {};
+
+        void Generate(Paths &paths, int first_pixel, int pixel_count, std::vector<uint32_t> &queue);
+        void Extend(const CompiledScene &world, Paths &paths, const std::vector<uint32_t> &queue, bool coherent);
+        void Shade(const CompiledScene &world, Paths &paths, const std::vector<uint32_t> &queue, int depth);
+        void Shadow(const CompiledScene &world, Paths &paths, const std::vector<uint32_t> &queue);
+
+        // Sorts the paths of queue into batches by ShadeKind, keeping their order within each.
+        void Classify(const MaterialTable &materials, Paths &paths, const std::vector<uint32_t> &queue,
+                      std::vector<uint32_t> *batches);
+
+        // Shades the batches Classify made, with the materials reached as M like Camera::TracePath.
+        template <typename M>
+        void ShadeBatches(const MaterialTable &materials, Paths &paths, const std::vector<uint32_t> *batches,
+                          int depth);
+
+        template <typename M>
+        void ShadeEmitter(const MaterialTable &materials, Paths &paths, uint32_t slot);
+
+        template <typename M>
+        void ShadeSurface(const MaterialTable &materials, Paths &paths, uint32_t slot, int depth);
+
+        template <typename M>
+        void SampleLight(Paths &paths, uint32_t slot, const M &mat);
+    };
+
+}
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef HALF_H
+#define HALF_H
+
+#include <cstdint>
+#include <cstring>
+
+namespace util
+{
+
+    // IEEE 754 binary16, rounded to nearest even. Values too large for half become infinite.
+    inline uint16_t FloatToHalf(float value)
+    {
+        uint32_t x;
+        memcpy(&x, &value, sizeof(x));
+        uint32_t sign = (x >> 16) & 0x8000;
+        uint32_t exponent = (x >> 23) & 0xff;
+        uint32_t mantissa = x & 0x7fffff;
+
+        if (exponent == 0xff) // Infinity or NaN
+            return uint16_t(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+        int e = int(exponent) - 127 + 15;
+        if (e >= 31)
+            return uint16_t(sign | 0x7c00);
+
+        if (e <= 0) // Subnormal half, or zero
+        {
+            if (e < -10)
+                return uint16_t(sign);
+            mantissa |= 0x800000;
+            int shift = 14 - e;
+            uint32_t half = mantissa >> shift;
+            uint32_t rest = mantissa & ((1u << shift) - 1);
+            uint32_t halfway = 1u << (shift - 1);
+            if (rest > halfway || (rest == halfway && (half & 1)))
+                half++;
+            return uint16_t(sign | half);
+        }
+
+        // Rounding up may carry into the exponent, which is still the right result.
+        uint32_t half = (uint32_t(e) << 10) | (mantissa >> 13);
+        uint32_t rest = mantissa & 0x1fff;
+        if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+            half++;
+        return uint16_t(sign | half);
+    }
+
+    inline float HalfToFloat(uint16_t half)
+    {
+        uint32_t sign = uint32_t(half & 0x8000) << 16;
+        uint32_t exponent = (half >> 10) & 0x1f;
+        uint32_t mantissa = half & 0x3ff;
+
+        uint32_t x;
+        if (exponent == 0 && mantissa == 0)
+        {
+            x = sign;
+        }
+        else if (exponent == 0) // Subnormal: normalize for float
+        {
+            int shift = 0;
+            while (!(mantissa & 0x400))
+            {
+                mantissa <<= 1;
+                shift++;
+            }
+            x = sign | (uint32_t(127 - 15 + 1 - shift) << 23) | ((mantissa & 0x3ff) << 13);
+        }
+        else if (exponent == 31)
+        {
+            x = sign | 0x7f800000 | (mantissa << 13);
+        }
+        else
+        {
+            x = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+        }
+
+        float value;
+        memcpy(&value, &x, sizeof(value));
+        return value;
+    }
+
+}
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace util
+{
+
+    /**
+     * 64-bit FNV-1a hash of a stream of bytes, for telling whether two scenes hold the same data.
+     * It is not meant to resist deliberate collisions.
+    */
+    class Hash
+    {
+    public:
+        void Add(const void *data, size_t size)
+        {
+            const unsigned char *bytes = static_cast<const unsigned char *>(data);
+            for (size_t i = 0; i < size; i++)
+                value_ = (value_ ^ bytes[i]) * 1099511628211ULL;
+        }
+
+        // Adds the bytes of a plain value. Padding would hash whatever it happens to hold, so
+        // structs with any should be added field by field.
+        template <typename T>
+        void Add(const T &value)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "only plain values can be hashed as bytes");
+            Add(&value, sizeof(value));
+        }
+
+        void Add(const char *text) { Add(text, strlen(text)); }
+
+        uint64_t value() const { return value_; }
+
+    private:
+        uint64_t value_ = 14695981039346656037ULL;
+    };
+
+}
+
+#endif
@@ -0,0 +1,46 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace util;
+
+std::shared_ptr<MappedFile> MappedFile::Open(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return nullptr;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping stays valid after the descriptor is closed
+    if (data == MAP_FAILED)
+        return nullptr;
+
+    return std::shared_ptr<MappedFile>(new MappedFile(static_cast<const char *>(data), size));
+}
+
+MappedFile::~MappedFile()
+{
+    munmap(const_cast<char *>(data_), size_);
+}
+
+bool util::GetFileStamp(const std::string &path, FileStamp &stamp)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+
+    stamp.size = static_cast<unsigned long long>(st.st_size);
+    stamp.mtime_ns = static_cast<long long>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+    return true;
+}
@@ -0,0 +1,53 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace util
+{
+
+    /**
+     * Read-only memory mapping of a whole file, unmapped when the last reference goes away.
+    */
+    class MappedFile
+    {
+    public:
+        // Returns nullptr if the file cannot be opened or mapped.
+        static std::shared_ptr<MappedFile> Open(const std::string &path);
+
+        ~MappedFile();
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        const char *data() const { return data_; }
+        size_t size() const { return size_; }
+
+    private:
+        MappedFile(const char *data, size_t size) : data_(data), size_(size) {}
+
+        const char *data_;
+        size_t size_;
+    };
+
+    /**
+     * Size and modification time of a file, used to tell whether files derived from it are stale.
+    */
+    struct FileStamp
+    {
+        unsigned long long size = 0;
+        long long mtime_ns = 0;
+
+        bool operator==(const FileStamp &other) const
+        {
+            return size == other.size && mtime_ns == other.mtime_ns;
+        }
+    };
+
+    bool GetFileStamp(const std::string &path, FileStamp &stamp);
+
+}
+
+#endif
@@ -0,0 +1,163 @@
+#include "parallel.h"
+
+#include <time.h>
+
+using namespace util;
+
+namespace
+{
+    // CPU time of the calling thread, which unlike wall time does not count time spent
+    // preempted when there are more threads than cores.
+    double ThreadSeconds()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+    }
+}
+
+TaskPool::TaskPool(int num_threads)
+    : num_threads_(std::max(num_threads, 1)), deques_(new Deque[num_threads_]), stats_(num_threads_)
+{
+    for (int t = 1; t < num_threads_; t++)
+        workers_.emplace_back(&TaskPool::WorkerLoop, this, t);
+}
+
+TaskPool::~TaskPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        stop_ = true;
+    }
+    start_cv_.notify_all();
+    for (std::thread &worker : workers_)
+        worker.join();
+}
+
+void TaskPool::Run(size_t task_count, const std::function<void(size_t, int)> &fn, bool steal)
+{
+    if (task_count == 0)
+        return;
+
+    for (int t = 0; t < num_threads_; t++)
+    {
+        deques_[t].begin = task_count * t / num_threads_;
+        deques_[t].end = task_count * (t + 1) / num_threads_;
+    }
+    completed_ = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        fn_ = &fn;
+        steal_ = steal;
+        running_ = num_threads_ - 1;
+        batch_++;
+    }
+    start_cv_.notify_all();
+
+    Work(0);
+
+    std::unique_lock<std::mutex> lock(mu_);
+    done_cv_.wait(lock, [this]()
+                  { return running_ == 0; });
+    fn_ = nullptr;
+}
+
+void TaskPool::WorkerLoop(int thread)
+{
+    unsigned seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mu_);
+            start_cv_.wait(lock, [&]()
+                           { return stop_ || batch_ != seen; });
+            if (stop_)
+                return;
+            seen = batch_;
+        }
+
+        Work(thread);
+
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            running_--;
+        }
+        done_cv_.notify_one();
+    }
+}
+
+void TaskPool::Work(int thread)
+{
+    ThreadStats &stats = stats_[thread];
+    double start = ThreadSeconds();
+
+    size_t task;
+    while (Pop(thread, task) || (steal_ && Steal(thread) && Pop(thread, task)))
+    {
+        (*fn_)(task, thread);
+        stats.tasks++;
+        completed_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    stats.busy_seconds += ThreadSeconds() - start;
+}
+
+bool TaskPool::Pop(int thread, size_t &task)
+{
+    Deque &deque = deques_[thread];
+    std::lock_guard<std::mutex> lock(deque.mu);
+    if (deque.begin == deque.end)
+        return false;
+    task = deque.begin++;
+    return true;
+}
+
+bool TaskPool::Steal(int thread)
+{
+    // Tasks only move between deques, so a thread that finds every deque empty is done: the
+    // tasks it did not see are already owned by a thread that will run them.
+    for (int i = 1; i < num_threads_; i++)
+    {
+        Deque &victim = deques_[(thread + i) % num_threads_];
+        size_t begin, end;
+        {
+            std::lock_guard<std::mutex> lock(victim.mu);
+            size_t left = victim.end - victim.begin;
+            if (left == 0)
+                continue;
+            end = victim.end;
+            victim.end -= (left + 1) / 2;
+            begin = victim.end;
+        }
+
+        Deque &own = deques_[thread];
+        std::lock_guard<std::mutex> lock(own.mu);
+        own.begin = begin;
+        own.end = end;
+        stats_[thread].steals++;
+        return true;
+    }
+    return false;
+}
+
+void TaskPool::ResetStats()
+{
+    std::fill(stats_.begin(), stats_.end(), ThreadStats());
+}
+
+void TaskPool::PrintStats(std::ostream &out) const
+{
+    double total = 0, longest = 0;
+    for (const ThreadStats &s : stats_)
+    {
+        total += s.busy_seconds;
+        longest = std::max(longest, s.busy_seconds);
+    }
+
+    for (int t = 0; t < num_threads_; t++)
+        out << "thread " << t << ": busy " << stats_[t].busy_seconds << " s, " << stats_[t].tasks << " tasks, "
+            << stats_[t].steals << " steals\n";
+    if (total > 0)
+        out << "load imbalance (longest / mean busy time): " << longest * num_threads_ / total << "\n";
+}
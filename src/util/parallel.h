@@ -0,0 +1,110 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace util
+{
+
+    /**
+     * A fixed set of threads that run batches of indexed tasks. Every thread starts with its own
+     * contiguous share of a batch in a per-thread deque, pops from its front, and once it runs dry
+     * steals the back half of another thread's deque, so threads that drew cheap tasks help out
+     * the ones that drew expensive ones.
+    */
+    class TaskPool
+    {
+    public:
+        struct ThreadStats
+        {
+            double busy_seconds = 0; // CPU time spent inside tasks
+            size_t tasks = 0;
+            size_t steals = 0;
+        };
+
+        // num_threads counts the calling thread, which takes part in every batch as thread 0.
+        explicit TaskPool(int num_threads);
+        ~TaskPool();
+
+        TaskPool(const TaskPool &) = delete;
+        TaskPool &operator=(const TaskPool &) = delete;
+
+        int size() const { return num_threads_; }
+
+        /**
+         * Calls fn(task, thread) once for every task in [0, task_count) and returns when all calls
+         * are done. Without stealing every thread runs exactly its own share.
+        */
+        void Run(size_t task_count, const std::function<void(size_t, int)> &fn, bool steal = true);
+
+        // Tasks finished so far in the current batch; may be read from inside fn.
+        size_t completed() const { return completed_.load(std::memory_order_relaxed); }
+
+        // Per-thread totals over every batch since construction or the last ResetStats.
+        const std::vector<ThreadStats> &stats() const { return stats_; }
+        void ResetStats();
+        void PrintStats(std::ostream &out) const;
+
+    private:
+        // Tasks [begin, end) not yet taken from a thread's deque.
+        struct alignas(64) Deque
+        {
+            std::mutex mu;
+            size_t begin = 0;
+            size_t end = 0;
+        };
+
+        int num_threads_;
+        std::unique_ptr<Deque[]> deques_;
+        std::vector<std::thread> workers_;
+        std::vector<ThreadStats> stats_;
+
+        std::mutex mu_;
+        std::condition_variable start_cv_;
+        std::condition_variable done_cv_;
+        unsigned batch_ = 0;
+        int running_ = 0;
+        bool stop_ = false;
+
+        const std::function<void(size_t, int)> *fn_ = nullptr;
+        bool steal_ = true;
+        std::atomic<size_t> completed_{0};
+
+        void WorkerLoop(int thread);
+        void Work(int thread);
+        bool Pop(int thread, size_t &task);
+        bool Steal(int thread);
+    };
+
+    /**
+     * Calls fn(begin, end) on slices of [0, count) spread over the pool's threads, and returns
+     * once all of them are done.
+    */
+    template <typename F>
+    void ParallelFor(TaskPool &pool, size_t count, F &&fn)
+    {
+        if (count == 0)
+            return;
+        if (pool.size() <= 1)
+        {
+            fn(size_t(0), count);
+            return;
+        }
+
+        // A few slices per thread leave something to steal when slices take uneven time.
+        size_t slices = std::min<size_t>(count, size_t(pool.size()) * 4);
+        pool.Run(slices, [&](size_t s, int)
+                 { fn(count * s / slices, count * (s + 1) / slices); });
+    }
+
+}
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+
+namespace util
+{
+
+    /**
+     * PCG32 random number generator (O'Neill, pcg-random.org): 64 bits of state, 32-bit outputs.
+     * Each stream is an independent sequence, so a generator seeded with the same seed and
+     * stream always produces the same numbers, whichever thread uses it.
+    */
+    class Rng
+    {
+    public:
+        Rng() : Rng(0, 0) {}
+
+        Rng(uint64_t seed, uint64_t stream)
+        {
+            inc_ = (stream << 1u) | 1u;
+            state_ = 0;
+            NextUint();
+            state_ += Mix(seed);
+            NextUint();
+        }
+
+        uint32_t NextUint()
+        {
+            uint64_t old = state_;
+            state_ = old * 6364136223846793005ULL + inc_;
+            uint32_t xorshifted = uint32_t(((old >> 18u) ^ old) >> 27u);
+            uint32_t rot = uint32_t(old >> 59u);
+            return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+        }
+
+        // Returns a random real in [0,1).
+        double NextDouble() { return NextUint() * 0x1p-32; }
+
+        // Returns a random real in [min,max).
+        double NextDouble(double min, double max) { return min + (max - min) * NextDouble(); }
+
+        // Returns a random integer in [0,n).
+        uint32_t NextBounded(uint32_t n) { return uint32_t((uint64_t(NextUint()) * n) >> 32); }
+
+        // SplitMix64 finalizer, which spreads nearby seeds over the whole state space.
+        static uint64_t Mix(uint64_t x)
+        {
+            x += 0x9e3779b97f4a7c15ULL;
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+            return x ^ (x >> 31);
+        }
+
+    private:
+        uint64_t state_;
+        uint64_t inc_; // Stream selector, always odd
+    };
+
+}
+
+#endif
@@ -0,0 +1,217 @@
+#include "sampler.h"
+#include "rng.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace util;
+
+namespace
+{
+    double ToUnit(uint32_t x)
+    {
+        return x * 0x1p-32;
+    }
+
+    double Fract(double x)
+    {
+        return x - std::floor(x);
+    }
+
+    uint32_t ReverseBits(uint32_t x)
+    {
+        x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+        x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+        x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+        x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+        return (x >> 16) | (x << 16);
+    }
+
+    // Random permutation of [0, n) chosen by seed, evaluated one element at a time (Kensler,
+    // "Correlated Multi-Jittered Sampling", 2013).
+    uint32_t Permute(uint32_t i, uint32_t n, uint32_t seed)
+    {
+        uint32_t w = n - 1;
+        w |= w >> 1;
+        w |= w >> 2;
+        w |= w >> 4;
+        w |= w >> 8;
+        w |= w >> 16;
+        do
+        {
+            i ^= seed;
+            i *= 0xe170893d;
+            i ^= seed >> 16;
+            i ^= (i & w) >> 4;
+            i ^= seed >> 8;
+            i *= 0x0929eb3f;
+            i ^= seed >> 23;
+            i ^= (i & w) >> 1;
+            i *= 1 | seed >> 27;
+            i *= 0x6935fa69;
+            i ^= (i & w) >> 11;
+            i *= 0x74dcb303;
+            i ^= (i & w) >> 2;
+            i *= 0x9e501cc3;
+            i ^= (i & w) >> 2;
+            i *= 0xc860a3df;
+            i &= w;
+            i ^= i >> 5;
+        } while (i >= n);
+        return (i + seed) % n;
+    }
+
+    uint32_t HashCombine(uint32_t seed, uint32_t v)
+    {
+        return uint32_t(Rng::Mix((uint64_t(seed) << 32) | v) >> 32);
+    }
+
+    // Owen scrambling of the bits of x, from the most significant down.
+    uint32_t NestedUniformScramble(uint32_t x, uint32_t seed)
+    {
+        x = ReverseBits(x);
+        x += seed;
+        x ^= x * 0x6c50b47cu;
+        x ^= x * 0xb82f1e52u;
+        x ^= x * 0xc7afe638u;
+        x ^= x * 0x8d22f6e6u;
+        return ReverseBits(x);
+    }
+
+    // The first two dimensions of the Sobol sequence, as 32-bit fractions.
+    uint32_t Sobol0(uint32_t index)
+    {
+        return ReverseBits(index);
+    }
+
+    uint32_t Sobol1(uint32_t index)
+    {
+        uint32_t result = 0;
+        for (uint32_t v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1)
+            if (index & 1)
+                result ^= v;
+        return result;
+    }
+
+    Sample2 ScrambledSobol2D(uint32_t index, uint32_t seed)
+    {
+        index = NestedUniformScramble(index, seed);
+        return {ToUnit(NestedUniformScramble(Sobol0(index), HashCombine(seed, 0))),
+                ToUnit(NestedUniformScramble(Sobol1(index), HashCombine(seed, 1)))};
+    }
+
+    // R2 dither mask (Roberts, "The Unreasonable Effectiveness of Quasirandom Sequences", 2018):
+    // neighbouring pixels get values about half the range apart.
+    double DitherMask(int x, int y)
+    {
+        return Fract(0.7548776662466927 * x + 0.5698402909980532 * y);
+    }
+}
+
+uint32_t Sampler::Hash(int x, int y, int dimension) const
+{
+    uint64_t pixel = (uint64_t(uint32_t(y)) << 32) | uint32_t(x);
+    return uint32_t(Rng::Mix(seed_ ^ Rng::Mix(pixel ^ Rng::Mix(uint64_t(dimension)))) >> 32);
+}
+
+// Independent
+
+double IndependentSampler::Get1D(int x, int y, int index, int dimension) const
+{
+    return ToUnit(HashCombine(Hash(x, y, dimension), uint32_t(index)));
+}
+
+Sample2 IndependentSampler::Get2D(int x, int y, int index, int dimension) const
+{
+    return {Get1D(x, y, index, dimension), Get1D(x, y, index, dimension + 1)};
+}
+
+// Stratified
+
+double StratifiedSampler::Get1D(int x, int y, int index, int dimension) const
+{
+    uint32_t n = std::max(samples_per_pixel_, 1);
+    uint32_t seed = HashCombine(Hash(x, y, dimension), uint32_t(index) / n); // New strata past n samples
+    uint32_t stratum = Permute(uint32_t(index) % n, n, seed);
+    double jitter = ToUnit(HashCombine(seed, uint32_t(index)));
+    return (stratum + jitter) / n;
+}
+
+Sample2 StratifiedSampler::Get2D(int x, int y, int index, int dimension) const
+{
+    // The largest grid of nx x ny cells with at most one sample per cell.
+    uint32_t nx = std::max(1, int(std::sqrt(double(std::max(samples_per_pixel_, 1)))));
+    uint32_t ny = std::max(samples_per_pixel_, 1) / nx;
+    uint32_t cells = nx * ny;
+
+    uint32_t seed = HashCombine(Hash(x, y, dimension), uint32_t(index) / cells);
+    uint32_t cell = Permute(uint32_t(index) % cells, cells, seed);
+    return {(cell % nx + ToUnit(HashCombine(seed, 2 * uint32_t(index)))) / nx,
+            (cell / nx + ToUnit(HashCombine(seed, 2 * uint32_t(index) + 1))) / ny};
+}
+
+// Sobol
+
+double SobolSampler::Get1D(int x, int y, int index, int dimension) const
+{
+    uint32_t seed = Hash(x, y, dimension);
+    uint32_t i = NestedUniformScramble(uint32_t(index), seed);
+    return ToUnit(NestedUniformScramble(Sobol0(i), HashCombine(seed, 0)));
+}
+
+Sample2 SobolSampler::Get2D(int x, int y, int index, int dimension) const
+{
+    return ScrambledSobol2D(uint32_t(index), Hash(x, y, dimension));
+}
+
+// Blue noise
+
+double BlueNoiseSampler::Get1D(int x, int y, int index, int dimension) const
+{
+    // The same scrambled points in every pixel, rotated by the pixel's mask value; the mask is
+    // shifted per dimension so that dimensions do not share it.
+    uint32_t seed = Hash(0, 0, dimension);
+    double point = ToUnit(NestedUniformScramble(Sobol0(uint32_t(index)), seed));
+    return Fract(point + DitherMask(x + (seed & 63), y + (seed >> 6 & 63)));
+}
+
+Sample2 BlueNoiseSampler::Get2D(int x, int y, int index, int dimension) const
+{
+    uint32_t seed = Hash(0, 0, dimension);
+    Sample2 point = ScrambledSobol2D(uint32_t(index), seed);
+    double shift_u = DitherMask(x + (seed & 63), y + (seed >> 6 & 63));
+    double shift_v = DitherMask(x + (seed >> 12 & 63), y + (seed >> 18 & 63));
+    return {Fract(point.u + shift_u), Fract(point.v + shift_v)};
+}
+
+// Factory
+
+std::shared_ptr<Sampler> util::MakeSampler(SamplerType type, int samples_per_pixel, uint64_t seed)
+{
+    switch (type)
+    {
+    case SamplerType::kStratified:
+        return std::make_shared<StratifiedSampler>(samples_per_pixel, seed);
+    case SamplerType::kSobol:
+        return std::make_shared<SobolSampler>(samples_per_pixel, seed);
+    case SamplerType::kBlueNoise:
+        return std::make_shared<BlueNoiseSampler>(samples_per_pixel, seed);
+    default:
+        return std::make_shared<IndependentSampler>(samples_per_pixel, seed);
+    }
+}
+
+const char *util::SamplerName(SamplerType type)
+{
+    switch (type)
+    {
+    case SamplerType::kStratified:
+        return "stratified";
+    case SamplerType::kSobol:
+        return "sobol";
+    case SamplerType::kBlueNoise:
+        return "blue noise";
+    default:
+        return "independent";
+    }
+}
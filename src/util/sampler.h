@@ -0,0 +1,120 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <cstdint>
+#include <memory>
+
+namespace util
+{
+
+    struct Sample2
+    {
+        double u, v;
+    };
+
+    /**
+     * Source of the random numbers of every pixel sample. A sample's numbers are split into
+     * dimensions (pixel jitter, then two or three per bounce), and the value of each dimension is
+     * a pure function of the pixel, the sample index and the dimension, so a sample can be
+     * resumed anywhere and renders are reproducible whatever the thread that draws them.
+     * Implementations differ in how the samples of one pixel cover each dimension.
+    */
+    class Sampler
+    {
+    public:
+        Sampler(int samples_per_pixel, uint64_t seed) : samples_per_pixel_(samples_per_pixel), seed_(seed) {}
+        virtual ~Sampler() = default;
+
+        virtual double Get1D(int x, int y, int index, int dimension) const = 0;
+
+        // Two dimensions, distributed well as a pair.
+        virtual Sample2 Get2D(int x, int y, int index, int dimension) const = 0;
+
+    protected:
+        int samples_per_pixel_;
+        uint64_t seed_;
+
+        // Seed that is different for every pixel and dimension.
+        uint32_t Hash(int x, int y, int dimension) const;
+    };
+
+    // Independent uniform numbers: the baseline every other sampler should beat.
+    class IndependentSampler : public Sampler
+    {
+    public:
+        using Sampler::Sampler;
+        double Get1D(int x, int y, int index, int dimension) const override;
+        Sample2 Get2D(int x, int y, int index, int dimension) const override;
+    };
+
+    // Jittered strata: the samples of a pixel fall one per stratum of each dimension (or of each
+    // square grid cell, for pairs), in an order shuffled per pixel and dimension.
+    class StratifiedSampler : public Sampler
+    {
+    public:
+        using Sampler::Sampler;
+        double Get1D(int x, int y, int index, int dimension) const override;
+        Sample2 Get2D(int x, int y, int index, int dimension) const override;
+    };
+
+    // The first two Sobol dimensions, Owen-scrambled and shuffled independently for every pixel
+    // and pair of dimensions (Burley, "Practical Hash-based Owen Scrambling", 2020). Works best
+    // with a power of two samples per pixel.
+    class SobolSampler : public Sampler
+    {
+    public:
+        using Sampler::Sampler;
+        double Get1D(int x, int y, int index, int dimension) const override;
+        Sample2 Get2D(int x, int y, int index, int dimension) const override;
+    };
+
+    // Sobol points shifted per pixel by a dither mask whose neighbouring values differ as much as
+    // possible, which spreads the remaining error over the screen as high-frequency noise.
+    class BlueNoiseSampler : public Sampler
+    {
+    public:
+        using Sampler::Sampler;
+        double Get1D(int x, int y, int index, int dimension) const override;
+        Sample2 Get2D(int x, int y, int index, int dimension) const override;
+    };
+
+    enum class SamplerType
+    {
+        kIndependent,
+        kStratified,
+        kSobol,
+        kBlueNoise
+    };
+
+    std::shared_ptr<Sampler> MakeSampler(SamplerType type, int samples_per_pixel, uint64_t seed);
+    const char *SamplerName(SamplerType type);
+
+    /**
+     * One sample of one pixel, handing out the sampler's dimensions in order.
+    */
+    class PixelSampler
+    {
+    public:
+        PixelSampler() = default;
+        PixelSampler(const Sampler *sampler, int x, int y, int index)
+            : sampler_(sampler), x_(x), y_(y), index_(index) {}
+
+        double Get1D() { return sampler_->Get1D(x_, y_, index_, dimension_++); }
+
+        Sample2 Get2D()
+        {
+            Sample2 s = sampler_->Get2D(x_, y_, index_, dimension_);
+            dimension_ += 2;
+            return s;
+        }
+
+    private:
+        const Sampler *sampler_ = nullptr;
+        int x_ = 0, y_ = 0;
+        int index_ = 0;
+        int dimension_ = 0;
+    };
+
+}
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef SPAN_H
+#define SPAN_H
+
+#include <cstddef>
+#include <vector>
+
+namespace util
+{
+
+    /**
+     * Read-only view of a contiguous array that someone else owns, such as a std::vector or a
+     * memory-mapped file.
+    */
+    template <typename T>
+    class Span
+    {
+    public:
+        Span() : data_(nullptr), size_(0) {}
+        Span(const T *data, size_t size) : data_(data), size_(size) {}
+        Span(const std::vector<T> &v) : data_(v.data()), size_(v.size()) {}
+
+        const T *data() const { return data_; }
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+
+        const T &operator[](size_t i) const { return data_[i]; }
+
+        const T *begin() const { return data_; }
+        const T *end() const { return data_ + size_; }
+
+    private:
+        const T *data_;
+        size_t size_;
+    };
+
+}
+
+#endif
@@ -4,15 +4,23 @@
 #define kPi 3.14159
 #define kEpsilon .0001
 
-#include <random>
+#include "rng.h"
 
 namespace util
 {
 
+    // Generator of the calling thread, for code without a generator of its own (such as scene
+    // setup). Rendering draws from per-pixel generators instead, see Camera.
+    inline Rng &ThreadRng()
+    {
+        thread_local Rng rng;
+        return rng;
+    }
+
     inline double RandomDouble()
     {
         // Returns a random real in [0,1).
-        return rand() / (RAND_MAX + 1.0);
+        return ThreadRng().NextDouble();
     }
 
     inline double RandomDouble(double min, double max)